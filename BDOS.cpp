@@ -1,12 +1,24 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 
 #include "BDOS.h"
 #include "bus.h"
+#include "savestate.h"
+
+namespace fs = std::filesystem;
 
 BDOS::BDOS() {};
-BDOS::~BDOS() {};
+
+BDOS::~BDOS()
+{
+    flush_files();
+};
 
 void BDOS::connect_bus(Bus * new_bus) 
 {
@@ -14,13 +26,247 @@ void BDOS::connect_bus(Bus * new_bus)
 }
 
 
+void BDOS::set_console_input(const uint8_t * data, size_t size)
+{
+    input.set_data(data, size);
+}
+
 void BDOS::bdos_request(uint8_t C, uint8_t D, uint8_t E)
 {
-    if(C==9)
+    uint16_t DE = (D<<8) | E;
+
+    bool file_function = (C >= OPEN_FILE && C <= RENAME_FILE)
+                      || (C >= READ_RANDOM && C <= SET_RANDOM_RECORD) || C == WRITE_RANDOM_ZERO;
+    if(file_function && !files_enabled)
     {
-        write_string((D<<8) | E);
+        set_result(0xFF);
+        return;
     }
-    else if (C==2)
+
+    switch(C)
+    {
+        case SYSTEM_RESET:
+            // The program has finished
+            flush_files();
+            console.flush();
+            bus->cpu.stop();
+            break;
+
+        case CONSOLE_INPUT:         read_byte(); break;
+        case CONSOLE_OUTPUT:        write_byte(E); break;
+        case READER_INPUT:          set_result(0x1A); break; // No reader, always EOF
+        case PUNCH_OUTPUT:          break;
+        case LIST_OUTPUT:           break;
+        case DIRECT_CONSOLE_IO:     direct_console_io(E); break;
+        case GET_IOBYTE:            set_result(iobyte); break;
+        case SET_IOBYTE:            iobyte = E; break;
+        case PRINT_STRING:          write_string(DE); break;
+        case READ_CONSOLE_BUFFER:   read_buffer(DE); break;
+        case CONSOLE_STATUS:        console_status(); break;
+        case VERSION:               set_result(0x0022); break; // CP/M 2.2
+
+        case RESET_DISK_SYSTEM:
+            dma_addr = 0x0080;
+            current_drive = 0;
+            set_result(0);
+            break;
+
+        case SELECT_DISK:
+            current_drive = E & 0x0F;
+            set_result(0);
+            break;
+
+        case OPEN_FILE:             set_result(open_file(DE)); break;
+        case CLOSE_FILE:            set_result(close_file(DE)); break;
+        case SEARCH_FIRST:          set_result(search(DE, 1)); break;
+        case SEARCH_NEXT:           set_result(search(DE, 0)); break;
+        case DELETE_FILE:           set_result(delete_file(DE)); break;
+        case READ_SEQUENTIAL:       set_result(read_sequential(DE)); break;
+        case WRITE_SEQUENTIAL:      set_result(write_sequential(DE)); break;
+        case MAKE_FILE:             set_result(make_file(DE)); break;
+        case RENAME_FILE:           set_result(rename_file(DE)); break;
+
+        case LOGIN_VECTOR:
+        {
+            // A drive is logged in if its host directory exists
+            uint16_t vector = 0;
+            for(uint8_t d=0; d!=16 && files_enabled; ++d)
+            {
+                if(fs::is_directory(drive_dir(d))) vector |= (1 << d);
+            }
+            set_result(vector);
+            break;
+        }
+
+        case CURRENT_DISK:          set_result(current_drive); break;
+        case SET_DMA:               dma_addr = DE; break;
+        case ALLOC_ADDRESS:         set_result(BIOS_BASE + 0x80); break;
+        case WRITE_PROTECT:         break;
+        case READ_ONLY_VECTOR:      set_result(0); break;
+        case SET_ATTRIBUTES:        set_result(0); break;
+        case DPB_ADDRESS:           set_result(BIOS_BASE + 0x40); break;
+
+        case USER_CODE:
+            if(E==0xFF) set_result(user_code);
+            else        user_code = E & 0x0F;
+            break;
+
+        case READ_RANDOM:           set_result(random_access(DE, 0)); break;
+        case WRITE_RANDOM:          set_result(random_access(DE, 1)); break;
+        case WRITE_RANDOM_ZERO:     set_result(random_access(DE, 1)); break;
+        case FILE_SIZE:             file_size(DE); break;
+        case SET_RANDOM_RECORD:     set_random_record(DE); break;
+        case RESET_DRIVE:           set_result(0); break;
+
+        default:
+            set_result(0);
+            break;
+    }
+}
+
+void BDOS::set_result(uint16_t hl)
+{
+    bus->cpu.L = bus->cpu.A = hl & 0xFF;
+    bus->cpu.H = bus->cpu.B = hl >> 8;
+}
+
+void BDOS::setup_page_zero(const std::vector<std::string> & args)
+{
+    // Warm boot vector, reaching 0000h ends the program
+    bus->write_to_ram(0x0000, 0xC3);
+    bus->write_to_ram(0x0001, (BIOS_BASE+3) & 0xFF);
+    bus->write_to_ram(0x0002, (BIOS_BASE+3) >> 8);
+    bus->write_to_ram(0x0003, iobyte);
+    bus->write_to_ram(0x0004, current_drive);
+
+    // BDOS vector, the word at 0006h is also the top of the TPA
+    bus->write_to_ram(0x0005, 0xC3);
+    bus->write_to_ram(0x0006, BDOS_ENTRY & 0xFF);
+    bus->write_to_ram(0x0007, BDOS_ENTRY >> 8);
+    bus->write_to_ram(BDOS_ENTRY, 0xC9); // RET
+
+    // Disk parameter block for an 8" single sided, single density disk
+    const uint8_t dpb[] = {26, 0, 3, 7, 0, 242, 0, 63, 0, 0xC0, 0x00, 16, 0, 2, 0};
+    for(size_t i=0; i!=sizeof(dpb); ++i) bus->write_to_ram(BIOS_BASE + 0x40 + i, dpb[i]);
+
+    // Default FCBs at 005Ch and 006Ch from the first two arguments
+    for(uint16_t fcb: {0x005C, 0x006C})
+    {
+        bus->write_to_ram(fcb, 0);
+        for(int i=1; i!=12; ++i) bus->write_to_ram(fcb + i, ' ');
+        for(int i=12; i!=16; ++i) bus->write_to_ram(fcb + i, 0);
+    }
+    for(size_t a=0; a!=std::min<size_t>(args.size(), 2); ++a)
+    {
+        uint16_t fcb = (a==0) ? 0x005C : 0x006C;
+        std::string arg = args[a];
+        std::transform(arg.begin(), arg.end(), arg.begin(), ::toupper);
+
+        if(arg.size() > 1 && arg[1]==':')
+        {
+            bus->write_to_ram(fcb, arg[0] - 'A' + 1);
+            arg = arg.substr(2);
+        }
+
+        size_t dot = arg.find('.');
+        std::string name = arg.substr(0, dot);
+        std::string ext = (dot==std::string::npos) ? "" : arg.substr(dot+1);
+        for(int i=0; i!=8 && i<(int)name.size(); ++i)
+        {
+            if(name[i]=='*') { for(int j=i; j!=8; ++j) bus->write_to_ram(fcb+1+j, '?'); break; }
+            bus->write_to_ram(fcb + 1 + i, name[i]);
+        }
+        for(int i=0; i!=3 && i<(int)ext.size(); ++i)
+        {
+            if(ext[i]=='*') { for(int j=i; j!=3; ++j) bus->write_to_ram(fcb+9+j, '?'); break; }
+            bus->write_to_ram(fcb + 9 + i, ext[i]);
+        }
+    }
+
+    // Command tail at 0080h, a length byte then the upper cased arguments
+    std::string tail;
+    for(auto & arg: args) tail += " " + arg;
+    std::transform(tail.begin(), tail.end(), tail.begin(), ::toupper);
+    if(tail.size() > 126) tail.resize(126);
+
+    bus->write_to_ram(0x0080, tail.size());
+    for(size_t i=0; i!=tail.size(); ++i) bus->write_to_ram(0x0081 + i, tail[i]);
+    bus->write_to_ram(0x0081 + tail.size(), 0);
+
+    // CP/M strings are printed exactly as given
+    string_skip = 0;
+
+    // Programs start at 0100h with a return address of 0000h on the stack
+    dma_addr = 0x0080;
+    bus->cpu.SP = BDOS_ENTRY - 8;
+    bus->write_to_ram(bus->cpu.SP, 0x00);
+    bus->write_to_ram(bus->cpu.SP + 1, 0x00);
+    bus->cpu.PC = 0x0100;
+}
+
+// Returns the next input character in A
+void BDOS::read_byte()
+{
+    // Make sure any prompt is visible first
+    console.flush();
+
+    int c = input.wait_get();
+    if(c < 0)
+    {
+        // Nothing left to feed the program
+        bus->cpu.stop();
+        return;
+    }
+    bus->cpu.A = c;
+}
+
+// Buffer layout: [max length][count read][characters...]
+// Reads up to the max length or a carriage return
+void BDOS::read_buffer(uint16_t addr)
+{
+    console.flush();
+
+    int c = input.wait_get();
+    if(c < 0)
+    {
+        bus->cpu.stop();
+        return;
+    }
+
+    uint8_t max_len = bus->read_from_ram(addr);
+    uint8_t count = 0;
+    for(; c >= 0 && count < max_len; c = input.wait_get())
+    {
+        if(c=='\r' || c=='\n') break;
+
+        bus->write_to_ram(addr + 2 + count, c);
+        count++;
+        if(count == max_len) break;
+    }
+    bus->write_to_ram(addr + 1, count);
+}
+
+// A is 0xFF if a character is waiting, otherwise 0. Answered
+// from the input buffer without waiting.
+void BDOS::console_status()
+{
+    set_result(input.ready() ? 0xFF : 0x00);
+}
+
+// E==0xFF reads a character without waiting (0 if none),
+// E==0xFE returns the console status, anything else is output
+void BDOS::direct_console_io(uint8_t E)
+{
+    if(E==0xFF)
+    {
+        int c = input.get();
+        set_result((c < 0) ? 0x00 : c);
+    }
+    else if(E==0xFE)
+    {
+        console_status();
+    }
+    else
     {
         write_byte(E);
     }
@@ -28,26 +274,499 @@ void BDOS::bdos_request(uint8_t C, uint8_t D, uint8_t E)
 
 void BDOS::write_byte(uint8_t val)
 {
-    //error_msg << std::hex << std::setfill('0') << std::setw(2) << (int)val;
-    error_msg << std::hex << (int)val;
-    std::cout << error_msg.str() << std::endl;
+    if(!output_enabled) return;
+
+    console.put((char)val);
 }
 
 // BDOS operation is C==9. Will print characters
-// at the error_addr until it hits a '$'
-void BDOS::write_string(uint16_t error_addr)
+// at the addr until it hits a '$'
+void BDOS::write_string(uint16_t addr)
+{
+    if(!output_enabled) return;
+
+    addr += string_skip;
+
+    // A string without a '$' would otherwise wrap memory forever
+    for(uint32_t limit=0; limit!=0x10000; ++limit)
+    {
+        char c = (char)bus->read_from_ram(addr++);
+        if(c=='$') break;
+        console.put(c);
+    }
+
+    if(string_skip) console.put('\n');
+}
+
+// FILE SYSTEM ===============================
+
+// FCB layout: dr, f1-f8, t1-t3, ex, s1, s2, rc, d0-d15, cr, r0-r2
+
+uint8_t BDOS::fcb_drive(uint16_t fcb)
+{
+    uint8_t dr = bus->read_from_ram(fcb);
+    if(dr==0 || dr=='?') return current_drive;
+    return (dr - 1) & 0x0F;
+}
+
+// The 11 character, space padded name with attribute bits removed
+std::string BDOS::fcb_name(uint16_t fcb, uint16_t offset)
+{
+    std::string name(11, ' ');
+    for(int i=0; i!=11; ++i)
+    {
+        name[i] = toupper(bus->read_from_ram(fcb + offset + i) & 0x7F);
+    }
+    return name;
+}
+
+std::string BDOS::drive_dir(uint8_t drive)
+{
+    if(drive==0) return host_dir;
+    return host_dir + "/" + (char)('A' + drive);
+}
+
+std::string BDOS::file_key(uint8_t drive, const std::string & name)
+{
+    return std::string(1, 'A' + drive) + ":" + name;
+}
+
+// Converts a host file name to the padded 11 character form,
+// returns an empty string if it can't be represented
+static std::string host_to_cpm(const std::string & host)
+{
+    size_t dot = host.rfind('.');
+    std::string name = host.substr(0, dot);
+    std::string ext = (dot==std::string::npos) ? "" : host.substr(dot+1);
+    if(name.empty() || name.size() > 8 || ext.size() > 3) return "";
+    if(name.find('.') != std::string::npos) return "";
+
+    std::string cpm(11, ' ');
+    for(size_t i=0; i!=name.size(); ++i) cpm[i] = toupper(name[i]);
+    for(size_t i=0; i!=ext.size(); ++i) cpm[8+i] = toupper(ext[i]);
+    return cpm;
+}
+
+// Converts the padded 11 character form to NAME.EXT
+static std::string cpm_to_host(const std::string & cpm)
+{
+    std::string name = cpm.substr(0, 8);
+    std::string ext = cpm.substr(8, 3);
+    name.erase(name.find_last_not_of(' ') + 1);
+    ext.erase(ext.find_last_not_of(' ') + 1);
+    return ext.empty() ? name : name + "." + ext;
+}
+
+// Whether a padded 11 character name is one CP/M allows, and so safe to
+// build a host path from. Spaces only pad the end of the name and type.
+static bool valid_cpm_name(const std::string & cpm)
+{
+    static const char * const reserved = "<>.,;:=?*[]|/\\\"";
+    for(int field=0; field!=2; ++field)
+    {
+        size_t start = field ? 8 : 0;
+        size_t end = field ? 11 : 8;
+        bool padding = 0;
+        for(size_t i=start; i!=end; ++i)
+        {
+            char c = cpm[i];
+            if(c==' ')
+            {
+                padding = 1;
+                continue;
+            }
+            if(padding || c < 0x21 || c > 0x7E || std::strchr(reserved, c)) return 0;
+        }
+    }
+    return cpm[0] != ' ';
+}
+
+// Host files on the drive whose names match the pattern, '?' matches anything
+std::vector<std::string> BDOS::match_files(uint8_t drive, const std::string & pattern)
+{
+    std::vector<std::string> found;
+    std::error_code ec;
+    for(auto & entry: fs::directory_iterator(drive_dir(drive), ec))
+    {
+        if(!entry.is_regular_file()) continue;
+
+        std::string host = entry.path().filename().string();
+        std::string cpm = host_to_cpm(host);
+        if(cpm.empty()) continue;
+
+        bool match = 1;
+        for(int i=0; i!=11 && match; ++i)
+        {
+            match = pattern[i]=='?' || pattern[i]==cpm[i];
+        }
+        if(match) found.push_back(host);
+    }
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+// Records are counted from the start of the file, across extents
+uint32_t BDOS::fcb_record(uint16_t fcb)
+{
+    uint32_t ex = bus->read_from_ram(fcb + 12) & 0x1F;
+    uint32_t s2 = bus->read_from_ram(fcb + 14) & 0x3F;
+    uint32_t cr = bus->read_from_ram(fcb + 32) & 0x7F;
+    return (s2 << 12) | (ex << 7) | cr;
+}
+
+void BDOS::set_fcb_record(uint16_t fcb, uint32_t record, size_t file_size)
+{
+    bus->write_to_ram(fcb + 32, record & 0x7F);
+    bus->write_to_ram(fcb + 12, (record >> 7) & 0x1F);
+    bus->write_to_ram(fcb + 14, (record >> 12) & 0x3F);
+
+    // Record count of the current extent
+    int64_t records = (file_size + 127) / 128;
+    int64_t in_extent = records - (int64_t)(record & ~0x7Fu);
+    bus->write_to_ram(fcb + 15, std::clamp<int64_t>(in_extent, 0, 128));
+}
+
+// Finds the open file for an FCB, opening it if the program
+// copied an FCB rather than opening it itself
+BDOS::HostFile * BDOS::find_open(uint16_t fcb)
 {
-    error_addr += 4; // Skips unnecessary leading characters
-    error_char = (char)bus->read_from_ram(error_addr);
+    uint8_t drive = fcb_drive(fcb);
+    std::string name = fcb_name(fcb);
+    std::string key = file_key(drive, name);
+
+    auto it = open_files.find(key);
+    if(it != open_files.end()) return &it->second;
+
+    std::vector<std::string> found = match_files(drive, name);
+    if(found.empty()) return nullptr;
 
-    while(error_char != '$')
+    // The whole file is read in one go
+    HostFile file;
+    file.path = drive_dir(drive) + "/" + found[0];
+    std::ifstream in(file.path, std::ios::binary | std::ios::ate);
+    if(!in) return nullptr;
+    file.data.resize(in.tellg());
+    in.seekg(0);
+    in.read((char *)file.data.data(), file.data.size());
+
+    return &(open_files[key] = std::move(file));
+}
+
+void BDOS::flush_files()
+{
+    for(auto & entry: open_files)
     {
-        error_msg << error_char;
-        //std::cout << error_char; 
-        error_addr++;
-        error_char = (char)bus->read_from_ram(error_addr);
+        HostFile & file = entry.second;
+        if(!file.dirty) continue;
 
+        std::ofstream out(file.path, std::ios::binary | std::ios::trunc);
+        out.write((const char *)file.data.data(), file.data.size());
+        file.dirty = 0;
     }
-    std::cout << error_msg.str() << std::endl;
 }
 
+void BDOS::reset()
+{
+    dma_addr = 0x0080;
+    current_drive = 0;
+    user_code = 0;
+    iobyte = 0;
+    open_files.clear();
+    search_results.clear();
+    search_pos = 0;
+    search_drive = 0;
+}
+
+void BDOS::save_state(StateWriter & out)
+{
+    out.put(dma_addr);
+    out.put(current_drive);
+    out.put(user_code);
+    out.put(iobyte);
+    out.put(string_skip);
+    out.put((uint8_t)output_enabled);
+    out.put_string(host_dir);
+
+    // Open files go with their data, written back or not
+    out.put((uint32_t)open_files.size());
+    for(auto & entry: open_files)
+    {
+        const HostFile & file = entry.second;
+        out.put_string(entry.first);
+        out.put_string(file.path);
+        out.put((uint8_t)file.dirty);
+        out.put((uint32_t)file.data.size());
+        out.put(file.data.data(), file.data.size());
+    }
+
+    out.put((uint32_t)search_results.size());
+    for(auto & name: search_results) out.put_string(name);
+    out.put((uint32_t)search_pos);
+    out.put(search_drive);
+}
+
+bool BDOS::load_state(StateReader & in)
+{
+    flush_files();
+    open_files.clear();
+    search_results.clear();
+
+    uint8_t enabled;
+    in.get(dma_addr);
+    in.get(current_drive);
+    in.get(user_code);
+    in.get(iobyte);
+    in.get(string_skip);
+    in.get(enabled);
+    host_dir = in.get_string();
+    output_enabled = enabled;
+
+    uint32_t count = 0;
+    in.get(count);
+    for(uint32_t i=0; i!=count && in.ok; ++i)
+    {
+        std::string key = in.get_string();
+        HostFile & file = open_files[key];
+        file.path = in.get_string();
+
+        uint8_t dirty;
+        uint32_t size = 0;
+        in.get(dirty);
+        in.get(size);
+        file.dirty = dirty;
+
+        const uint8_t * data = in.view(size);
+        if(data) file.data.assign(data, data + size);
+    }
+
+    in.get(count);
+    for(uint32_t i=0; i!=count && in.ok; ++i) search_results.push_back(in.get_string());
+
+    uint32_t pos = 0;
+    in.get(pos);
+    in.get(search_drive);
+    search_pos = pos;
+    return in.ok;
+}
+
+// Writes a directory entry for the file to the DMA buffer
+void BDOS::write_dir_entry(uint8_t drive, const std::string & name)
+{
+    std::error_code ec;
+    uintmax_t size = fs::file_size(drive_dir(drive) + "/" + name, ec);
+    if(ec) size = 0;
+
+    // A file that's open may not have been written back yet
+    std::string cpm = host_to_cpm(name);
+    auto it = open_files.find(file_key(drive, cpm));
+    if(it != open_files.end()) size = it->second.data.size();
+
+    uint32_t records = (size + 127) / 128;
+    uint32_t last = records ? records - 1 : 0;
+
+    bus->write_to_ram(dma_addr, user_code);
+    for(int i=0; i!=11; ++i) bus->write_to_ram(dma_addr + 1 + i, cpm[i]);
+    bus->write_to_ram(dma_addr + 12, (last >> 7) & 0x1F);
+    bus->write_to_ram(dma_addr + 13, 0);
+    bus->write_to_ram(dma_addr + 14, (last >> 12) & 0x3F);
+    bus->write_to_ram(dma_addr + 15, records ? (last & 0x7F) + 1 : 0);
+    for(int i=16; i!=32; ++i) bus->write_to_ram(dma_addr + i, 0);
+
+    // The rest of the directory sector is unused entries
+    for(int i=32; i!=128; ++i) bus->write_to_ram(dma_addr + i, 0xE5);
+}
+
+uint8_t BDOS::open_file(uint16_t fcb)
+{
+    HostFile * file = find_open(fcb);
+    if(!file) return 0xFF;
+
+    set_fcb_record(fcb, fcb_record(fcb), file->data.size());
+    return 0;
+}
+
+uint8_t BDOS::close_file(uint16_t fcb)
+{
+    std::string key = file_key(fcb_drive(fcb), fcb_name(fcb));
+    auto it = open_files.find(key);
+    if(it == open_files.end())
+    {
+        return match_files(fcb_drive(fcb), fcb_name(fcb)).empty() ? 0xFF : 0;
+    }
+
+    HostFile & file = it->second;
+    if(file.dirty)
+    {
+        std::ofstream out(file.path, std::ios::binary | std::ios::trunc);
+        out.write((const char *)file.data.data(), file.data.size());
+    }
+    open_files.erase(it);
+    return 0;
+}
+
+uint8_t BDOS::search(uint16_t fcb, bool first)
+{
+    if(first)
+    {
+        search_drive = fcb_drive(fcb);
+        std::string pattern = fcb_name(fcb);
+        if(bus->read_from_ram(fcb)=='?') pattern = std::string(11, '?');
+
+        search_results = match_files(search_drive, pattern);
+        search_pos = 0;
+    }
+
+    if(search_pos >= search_results.size()) return 0xFF;
+
+    write_dir_entry(search_drive, search_results[search_pos++]);
+    return 0;
+}
+
+uint8_t BDOS::delete_file(uint16_t fcb)
+{
+    uint8_t drive = fcb_drive(fcb);
+    std::vector<std::string> found = match_files(drive, fcb_name(fcb));
+    if(found.empty()) return 0xFF;
+
+    for(auto & name: found)
+    {
+        open_files.erase(file_key(drive, host_to_cpm(name)));
+
+        std::error_code ec;
+        fs::remove(drive_dir(drive) + "/" + name, ec);
+    }
+    return 0;
+}
+
+uint8_t BDOS::make_file(uint16_t fcb)
+{
+    uint8_t drive = fcb_drive(fcb);
+    std::string name = fcb_name(fcb);
+    if(!valid_cpm_name(name)) return 0xFF;
+
+    HostFile file;
+    file.path = drive_dir(drive) + "/" + cpm_to_host(name);
+    file.dirty = 1;
+    {
+        std::ofstream out(file.path, std::ios::binary | std::ios::trunc);
+        if(!out) return 0xFF;
+    }
+    open_files[file_key(drive, name)] = std::move(file);
+
+    set_fcb_record(fcb, fcb_record(fcb), 0);
+    return 0;
+}
+
+// The new name is held in the second half of the FCB
+uint8_t BDOS::rename_file(uint16_t fcb)
+{
+    uint8_t drive = fcb_drive(fcb);
+    std::string old_name = fcb_name(fcb);
+    std::string new_name = fcb_name(fcb, 17);
+    if(!valid_cpm_name(new_name)) return 0xFF;
+
+    std::vector<std::string> found = match_files(drive, old_name);
+    if(found.empty()) return 0xFF;
+
+    // Write back any pending data under the old name first
+    auto it = open_files.find(file_key(drive, old_name));
+    if(it != open_files.end())
+    {
+        close_file(fcb);
+    }
+
+    std::error_code ec;
+    fs::rename(drive_dir(drive) + "/" + found[0], drive_dir(drive) + "/" + cpm_to_host(new_name), ec);
+    return ec ? 0xFF : 0;
+}
+
+// Copies one record to the DMA buffer, short records are padded with ^Z.
+// Returns 1 past the end of the file.
+uint8_t BDOS::read_record(uint16_t fcb, uint32_t record)
+{
+    HostFile * file = find_open(fcb);
+    if(!file) return 9; // Invalid FCB
+
+    size_t offset = (size_t)record * 128;
+    if(offset >= file->data.size()) return 1;
+
+    size_t len = std::min<size_t>(128, file->data.size() - offset);
+    for(size_t i=0; i!=128; ++i)
+    {
+        bus->write_to_ram(dma_addr + i, i < len ? file->data[offset + i] : 0x1A);
+    }
+    return 0;
+}
+
+uint8_t BDOS::write_record(uint16_t fcb, uint32_t record)
+{
+    HostFile * file = find_open(fcb);
+    if(!file) return 9;
+
+    size_t offset = (size_t)record * 128;
+    if(file->data.size() < offset + 128) file->data.resize(offset + 128, 0x00);
+
+    for(size_t i=0; i!=128; ++i)
+    {
+        file->data[offset + i] = bus->read_from_ram(dma_addr + i);
+    }
+    file->dirty = 1;
+    return 0;
+}
+
+uint8_t BDOS::read_sequential(uint16_t fcb)
+{
+    uint32_t record = fcb_record(fcb);
+    uint8_t result = read_record(fcb, record);
+    if(result==0)
+    {
+        set_fcb_record(fcb, record + 1, find_open(fcb)->data.size());
+    }
+    return result;
+}
+
+uint8_t BDOS::write_sequential(uint16_t fcb)
+{
+    uint32_t record = fcb_record(fcb);
+    uint8_t result = write_record(fcb, record);
+    if(result==0)
+    {
+        set_fcb_record(fcb, record + 1, find_open(fcb)->data.size());
+    }
+    return result;
+}
+
+// Random access uses r0-r2, and leaves the sequential position on that record
+uint8_t BDOS::random_access(uint16_t fcb, bool write)
+{
+    uint32_t record = bus->read_from_ram(fcb + 33) | (bus->read_from_ram(fcb + 34) << 8);
+    if(bus->read_from_ram(fcb + 35) != 0) return 6; // Beyond the end of the disk
+
+    HostFile * file = find_open(fcb);
+    if(!file) return write ? 5 : 4;
+
+    uint8_t result = write ? write_record(fcb, record) : read_record(fcb, record);
+    set_fcb_record(fcb, record, file->data.size());
+    return result;
+}
+
+// Sets r0-r2 to the number of records in the file
+void BDOS::file_size(uint16_t fcb)
+{
+    size_t size = 0;
+    if(HostFile * file = find_open(fcb)) size = file->data.size();
+
+    uint32_t records = (size + 127) / 128;
+    bus->write_to_ram(fcb + 33, records & 0xFF);
+    bus->write_to_ram(fcb + 34, (records >> 8) & 0xFF);
+    bus->write_to_ram(fcb + 35, (records >> 16) & 0xFF);
+}
+
+// Sets r0-r2 from the sequential position
+void BDOS::set_random_record(uint16_t fcb)
+{
+    uint32_t record = fcb_record(fcb);
+    bus->write_to_ram(fcb + 33, record & 0xFF);
+    bus->write_to_ram(fcb + 34, (record >> 8) & 0xFF);
+    bus->write_to_ram(fcb + 35, (record >> 16) & 0xFF);
+}
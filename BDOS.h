@@ -3,16 +3,29 @@ http://www.shaels.net/index.php/cpm80-22-documents/cpm-bdos/31-bdos-overview
 BDOS was an OS that provided functionality to the 8080 chip.
 The CPU DIAG program uses BDOS to print output states, this implementation
 is designed to mimic the behaviour of the BDOS unit.
+
+Files are served from a host directory. Drive A: is host_dir itself and
+drives B: onwards are subdirectories named after the drive letter. An
+open file is held in memory, loaded with a single read and written back
+with a single write on close, so guest record I/O never becomes a host
+syscall per 128 byte record.
 */
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <map>
 #include <string>
-#include <sstream>
+#include <vector>
+
+#include "console.h"
 
 // Forward declaration
 class Bus;
+class StateWriter;
+class StateReader;
 
 class BDOS
 {
@@ -23,19 +36,171 @@ class BDOS
 
         // BDOS variables
         Bus * bus;
-        char error_char;
-        std::stringstream error_msg;
+
+        // Buffered console output, the sink and flush policy are pluggable
+        ConsoleOutput console;
+
+        // Console output can be switched off for batch runs (e.g. fuzzing)
+        bool output_enabled = 1;
+
+        // Leading characters PRINT_STRING skips. CPUDIAG messages start
+        // with a form feed, CR, LF and a space, so this defaults to 4 and
+        // each message is given its own line. CP/M programs use 0.
+        uint8_t string_skip = 4;
+
+        // Host directory backing drive A:
+        std::string host_dir = ".";
+
+        // File functions can be switched off for runs that mustn't touch
+        // the host (e.g. fuzzing), they then fail with FFh
+        bool files_enabled = 1;
 
         // Called by Bus on creation to link to BDOS
         void connect_bus(Bus * new_bus);
 
+        // Console input, fed from memory, a script, a file or stdin
+        ConsoleInput input;
+
+        // Supplies the bytes returned by the console input functions.
+        // The data is not copied and must outlive the run.
+        void set_console_input(const uint8_t * data, size_t size);
+
         // Processes a request based on register values
         void bdos_request(uint8_t C, uint8_t D, uint8_t E);
 
+        // Prepares page zero for a CP/M program: the warm boot and BDOS
+        // jumps, the default FCBs and the command tail built from args
+        void setup_page_zero(const std::vector<std::string> & args);
+
+        // Writes every modified file back to the host
+        void flush_files();
+
+        // Returns the disk state to that of a new BDOS, open files are
+        // dropped without being written back
+        void reset();
+
+        // Disk state, open files and searches, for save states. Loading
+        // writes back the files open before.
+        void save_state(StateWriter & out);
+        bool load_state(StateReader & in);
+
+    public:
+        // Top of the TPA, stored at 0006h for programs to size memory
+        static const uint16_t BDOS_ENTRY = 0xFE06;
+        static const uint16_t BIOS_BASE = 0xFF00;
+
+        // CP/M 2.2 function numbers (C register)
+        enum FUNCTIONS
+        {
+            SYSTEM_RESET = 0,
+            CONSOLE_INPUT = 1,
+            CONSOLE_OUTPUT = 2,
+            READER_INPUT = 3,
+            PUNCH_OUTPUT = 4,
+            LIST_OUTPUT = 5,
+            DIRECT_CONSOLE_IO = 6,
+            GET_IOBYTE = 7,
+            SET_IOBYTE = 8,
+            PRINT_STRING = 9,
+            READ_CONSOLE_BUFFER = 10,
+            CONSOLE_STATUS = 11,
+            VERSION = 12,
+            RESET_DISK_SYSTEM = 13,
+            SELECT_DISK = 14,
+            OPEN_FILE = 15,
+            CLOSE_FILE = 16,
+            SEARCH_FIRST = 17,
+            SEARCH_NEXT = 18,
+            DELETE_FILE = 19,
+            READ_SEQUENTIAL = 20,
+            WRITE_SEQUENTIAL = 21,
+            MAKE_FILE = 22,
+            RENAME_FILE = 23,
+            LOGIN_VECTOR = 24,
+            CURRENT_DISK = 25,
+            SET_DMA = 26,
+            ALLOC_ADDRESS = 27,
+            WRITE_PROTECT = 28,
+            READ_ONLY_VECTOR = 29,
+            SET_ATTRIBUTES = 30,
+            DPB_ADDRESS = 31,
+            USER_CODE = 32,
+            READ_RANDOM = 33,
+            WRITE_RANDOM = 34,
+            FILE_SIZE = 35,
+            SET_RANDOM_RECORD = 36,
+            RESET_DRIVE = 37,
+            WRITE_RANDOM_ZERO = 40
+        };
+
     private:
+        // Disk state
+        uint16_t dma_addr = 0x0080;
+        uint8_t current_drive = 0;
+        uint8_t user_code = 0;
+        uint8_t iobyte = 0;
+
+        // An open file, held in memory until it is closed
+        struct HostFile
+        {
+            std::string path;
+            std::vector<uint8_t> data;
+            bool dirty = 0;
+        };
+
+        // Open files keyed by drive and CP/M name, e.g. "A:FOO.COM"
+        std::map<std::string, HostFile> open_files;
+
+        // Matches from SEARCH_FIRST, returned one by one by SEARCH_NEXT
+        std::vector<std::string> search_results;
+        size_t search_pos = 0;
+        uint8_t search_drive = 0;
+
+        // Sets the return value in HL, mirrored into A and B
+        void set_result(uint16_t hl);
+
+        // BDOS read byte (C==1), parks until input arrives and stops
+        // the CPU once input runs out
+        void read_byte();
+
+        // BDOS read console buffer (C==10) into the buffer at addr
+        void read_buffer(uint16_t addr);
+
+        // BDOS console status (C==11)
+        void console_status();
+
+        // BDOS direct console I/O (C==6)
+        void direct_console_io(uint8_t E);
+
         // BDOS write byte
         void write_byte(uint8_t val);
 
         // BDOS write $ terminated string
-        void write_string(uint16_t error_addr);
+        void write_string(uint16_t addr);
+
+        // FCB helpers
+        uint8_t fcb_drive(uint16_t fcb);
+        std::string fcb_name(uint16_t fcb, uint16_t offset = 1);
+        std::string drive_dir(uint8_t drive);
+        std::string file_key(uint8_t drive, const std::string & name);
+        uint32_t fcb_record(uint16_t fcb);
+        void set_fcb_record(uint16_t fcb, uint32_t record, size_t file_size);
+        HostFile * find_open(uint16_t fcb);
+        std::vector<std::string> match_files(uint8_t drive, const std::string & pattern);
+        void write_dir_entry(uint8_t drive, const std::string & name);
+
+        // File functions, return the value for A
+        uint8_t open_file(uint16_t fcb);
+        uint8_t close_file(uint16_t fcb);
+        uint8_t search(uint16_t fcb, bool first);
+        uint8_t delete_file(uint16_t fcb);
+        uint8_t read_record(uint16_t fcb, uint32_t record);
+        uint8_t write_record(uint16_t fcb, uint32_t record);
+        uint8_t make_file(uint16_t fcb);
+        uint8_t rename_file(uint16_t fcb);
+        uint8_t read_sequential(uint16_t fcb);
+        uint8_t write_sequential(uint16_t fcb);
+        uint8_t random_access(uint16_t fcb, bool write);
+        void file_size(uint16_t fcb);
+        void set_random_record(uint16_t fcb);
 };
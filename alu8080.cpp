@@ -0,0 +1,318 @@
+/*
+Exhaustive ALU checker. Every ADD ADC SUB SBB ANA XRA ORA CMP (register,
+memory and immediate forms) is run through the real i8080 handlers for all
+256x256 operand pairs and both carry-in values, along with INR, DCR, DAA,
+RLC, RRC, RAL and RAR for every input. Results and flags are checked
+against the bit-exact specification in Ref8080.
+
+Build:
+    g++ -O2 -pthread alu8080.cpp ref8080.cpp i8080.cpp opcodes.cpp profile.cpp trace.cpp mapfile.cpp bus.cpp BDOS.cpp bios.cpp console.cpp disk.cpp -o alu8080
+
+Usage: alu8080 [-t threads] [-m flagmask] [-v]
+    -t  worker threads (default: all cores)
+    -m  flag bits to compare (default d5, all of S Z AC P CY)
+    -v  list every opcode, not only the failing ones
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bus.h"
+#include "ref8080.h"
+
+using namespace std;
+
+// Addresses used while running a case
+static const uint16_t CODE_ADDR = 0x0100;
+static const uint16_t M_ADDR = 0x4000;
+
+// Register index order used by the opcode encoding: B C D E H L M A
+static uint8_t * reg_ptr(i8080 & cpu, uint8_t r)
+{
+    switch(r)
+    {
+        case 0: return &cpu.B;
+        case 1: return &cpu.C;
+        case 2: return &cpu.D;
+        case 3: return &cpu.E;
+        case 4: return &cpu.H;
+        case 5: return &cpu.L;
+        case 7: return &cpu.A;
+        default: return nullptr;
+    }
+}
+
+// Per opcode results, merged across workers
+struct OpResult
+{
+    uint64_t cases = 0;
+    uint64_t failures = 0;
+    string first_failure;
+};
+
+class AluChecker
+{
+    public:
+        AluChecker(uint8_t flag_mask) : flag_mask(flag_mask), bus(new Bus)
+        {
+            bus->cpu.trace = 0;
+            bus->bdos.output_enabled = 0;
+        }
+
+        // Binary ALU op with A in [a_lo, a_hi), all operands and carries
+        void check_binary(uint8_t op, unsigned a_lo, unsigned a_hi, OpResult & res)
+        {
+            bool immediate = op >= 0xC0;
+            uint8_t src = immediate ? 0xFF : (op & 7);
+            uint8_t alu_op = (op >> 3) & 7;
+
+            for(unsigned a=a_lo; a!=a_hi; ++a)
+            for(unsigned b=0; b!=256; ++b)
+            for(unsigned cy=0; cy!=2; ++cy)
+            {
+                // ADD A and friends can only see b == a
+                if(src==7 && b!=a) continue;
+
+                uint8_t f_in = input_flags(a, b, cy);
+                uint8_t f_exp = f_in;
+                uint8_t a_exp = Ref8080::alu(alu_op, a, b, f_exp);
+
+                i8080 & cpu = reset(op, immediate ? b : 0x00);
+                cpu.A = a;
+                cpu.status = f_in;
+                if(src==6)              bus->ram[M_ADDR] = b;
+                else if(!immediate)     *reg_ptr(cpu, src) = b;
+
+                cpu.step();
+                if(record(res, cpu.A, a_exp, cpu.status, f_exp, immediate ? 2 : 1))
+                {
+                    describe(res, "A=" + hex2(a) + " operand=" + hex2(b) + " CY=" + to_string(cy),
+                             cpu.A, cpu.status, a_exp, f_exp);
+                }
+            }
+        }
+
+        // INR and DCR on every value of the target register or memory
+        void check_incdec(uint8_t op, OpResult & res)
+        {
+            uint8_t dst = (op >> 3) & 7;
+            bool inc = (op & 7) == 4;
+
+            for(unsigned v=0; v!=256; ++v)
+            for(unsigned cy=0; cy!=2; ++cy)
+            {
+                uint8_t f_in = input_flags(v, v, cy);
+                uint8_t f_exp = f_in;
+                uint8_t v_exp = inc ? Ref8080::inr(v, f_exp) : Ref8080::dcr(v, f_exp);
+
+                i8080 & cpu = reset(op, 0x00);
+                cpu.status = f_in;
+                if(dst==6)  bus->ram[M_ADDR] = v;
+                else        *reg_ptr(cpu, dst) = v;
+
+                cpu.step();
+                uint8_t got = (dst==6) ? bus->ram[M_ADDR] : *reg_ptr(cpu, dst);
+                if(record(res, got, v_exp, cpu.status, f_exp, 1))
+                {
+                    describe(res, "value=" + hex2(v) + " CY=" + to_string(cy),
+                             got, cpu.status, v_exp, f_exp);
+                }
+            }
+        }
+
+        // DAA and the rotates on every A, carry and auxiliary carry
+        void check_accumulator(uint8_t op, OpResult & res)
+        {
+            for(unsigned a=0; a!=256; ++a)
+            for(unsigned cy=0; cy!=2; ++cy)
+            for(unsigned ac=0; ac!=2; ++ac)
+            {
+                uint8_t f_in = input_flags(a, a, cy);
+                f_in = ac ? (f_in | Ref8080::AC) : (f_in & ~Ref8080::AC);
+                uint8_t f_exp = f_in;
+                uint8_t a_exp = 0;
+                switch(op)
+                {
+                    case 0x07: a_exp = Ref8080::rlc(a, f_exp); break;
+                    case 0x0F: a_exp = Ref8080::rrc(a, f_exp); break;
+                    case 0x17: a_exp = Ref8080::ral(a, f_exp); break;
+                    case 0x1F: a_exp = Ref8080::rar(a, f_exp); break;
+                    default:   a_exp = Ref8080::daa(a, f_exp); break;
+                }
+
+                i8080 & cpu = reset(op, 0x00);
+                cpu.A = a;
+                cpu.status = f_in;
+
+                cpu.step();
+                if(record(res, cpu.A, a_exp, cpu.status, f_exp, 1))
+                {
+                    describe(res, "A=" + hex2(a) + " CY=" + to_string(cy) + " AC=" + to_string(ac),
+                             cpu.A, cpu.status, a_exp, f_exp);
+                }
+            }
+        }
+
+    private:
+        uint8_t flag_mask;
+        unique_ptr<Bus> bus;
+
+        static string hex2(unsigned v)
+        {
+            ostringstream out;
+            out << hex << setfill('0') << setw(2) << v;
+            return out.str();
+        }
+
+        // Vary the flags that shouldn't matter so stale flags get caught
+        static uint8_t input_flags(uint8_t a, uint8_t b, bool cy)
+        {
+            uint8_t others = ((a ^ b) & 1) ? (Ref8080::S | Ref8080::Z | Ref8080::AC | Ref8080::P) : 0;
+            return others | 0x02 | (cy ? Ref8080::CY : 0);
+        }
+
+        i8080 & reset(uint8_t op, uint8_t byte2)
+        {
+            i8080 & cpu = bus->cpu;
+            cpu.B = cpu.C = cpu.D = cpu.E = 0;
+            cpu.H = M_ADDR >> 8;
+            cpu.L = M_ADDR & 0xFF;
+            cpu.PC = CODE_ADDR;
+            bus->ram[CODE_ADDR] = op;
+            bus->ram[CODE_ADDR+1] = byte2;
+            return cpu;
+        }
+
+        // Counts a case, returns true if it is the first failure
+        bool record(OpResult & res, uint8_t got, uint8_t expected, uint8_t f_got, uint8_t f_exp,
+                    unsigned length)
+        {
+            res.cases++;
+            bool ok = got==expected
+                   && ((f_got ^ f_exp) & flag_mask)==0
+                   && bus->cpu.PC==CODE_ADDR+length;
+            if(ok) return 0;
+
+            return res.failures++ == 0;
+        }
+
+        // Only built for the first failure, formatting every case is slow
+        void describe(OpResult & res, const string & inputs, uint8_t got, uint8_t f_got,
+                      uint8_t expected, uint8_t f_exp)
+        {
+            res.first_failure = inputs + " -> result " + hex2(got) + " flags " + hex2(f_got & flag_mask)
+                              + ", expected " + hex2(expected) + " flags " + hex2(f_exp & flag_mask);
+        }
+};
+
+int main(int argc, char *argv[])
+{
+    unsigned threads = max(1u, thread::hardware_concurrency());
+    uint8_t flag_mask = Ref8080::FLAG_MASK;
+    bool verbose = 0;
+
+    for(int i=1; i<argc; ++i)
+    {
+        string arg = argv[i];
+        if(arg=="-t" && i+1<argc)       threads = max(1, stoi(argv[++i]));
+        else if(arg=="-m" && i+1<argc)  flag_mask = stoi(argv[++i], nullptr, 16);
+        else if(arg=="-v")              verbose = 1;
+        else
+        {
+            cerr << "Unknown option " << arg << endl;
+            return 1;
+        }
+    }
+
+    // Work items: binary ops are split into 16 slices of A each
+    struct Task
+    {
+        uint8_t op;
+        uint8_t slice;
+    };
+    vector<Task> tasks;
+    vector<uint8_t> ops;
+    for(int op=0x80; op!=0xC0; ++op) ops.push_back(op);
+    for(int op=0xC6; op<=0xFE; op+=8) ops.push_back(op);
+    for(int op=0x04; op<=0x3D; op+=8)
+    {
+        ops.push_back(op);      // INR
+        ops.push_back(op+1);    // DCR
+    }
+    for(uint8_t op: {0x07, 0x0F, 0x17, 0x1F, 0x27}) ops.push_back(op);
+
+    for(auto op: ops)
+    {
+        bool binary = op >= 0x80;
+        for(int slice=0; slice!=(binary ? 16 : 1); ++slice) tasks.push_back({op, (uint8_t)slice});
+    }
+
+    // Opcodes the core doesn't implement can't be checked
+    {
+        Bus probe;
+        tasks.erase(remove_if(tasks.begin(), tasks.end(),
+                              [&](const Task & t) { return !probe.cpu.implemented(t.op); }),
+                    tasks.end());
+    }
+
+    vector<OpResult> results(256);
+    mutex result_lock;
+    atomic<size_t> next_task(0);
+
+    auto worker = [&]()
+    {
+        AluChecker checker(flag_mask);
+        for(size_t t = next_task++; t < tasks.size(); t = next_task++)
+        {
+            OpResult res;
+            uint8_t op = tasks[t].op;
+            if(op >= 0x80)          checker.check_binary(op, tasks[t].slice*16, tasks[t].slice*16 + 16, res);
+            else if((op & 6)==4)    checker.check_incdec(op, res);
+            else                    checker.check_accumulator(op, res);
+
+            lock_guard<mutex> lock(result_lock);
+            OpResult & total = results[op];
+            total.cases += res.cases;
+            if(res.failures && total.failures==0) total.first_failure = res.first_failure;
+            total.failures += res.failures;
+        }
+    };
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> pool;
+    for(unsigned t=0; t!=threads; ++t) pool.emplace_back(worker);
+    for(auto & t: pool) t.join();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    uint64_t cases = 0;
+    unsigned failing_ops = 0;
+    for(int op=0; op!=256; ++op)
+    {
+        const OpResult & res = results[op];
+        if(res.cases==0) continue;
+        cases += res.cases;
+        if(res.failures) failing_ops++;
+
+        if(res.failures || verbose)
+        {
+            cout << "0x" << hex << setfill('0') << setw(2) << op << dec
+                 << "\t" << res.failures << "/" << res.cases << " failed";
+            if(res.failures) cout << "\t" << res.first_failure;
+            cout << endl;
+        }
+    }
+
+    cout << cases << " cases in " << elapsed.count() << "s on " << threads << " threads, "
+         << failing_ops << " opcodes failing" << endl;
+
+    return failing_ops ? 1 : 0;
+}
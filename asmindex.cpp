@@ -0,0 +1,215 @@
+#include <cstring>
+
+#include "asmindex.h"
+
+static const char INDEX_MAGIC[8] = "I8080IX";
+
+// BUILDING ===================================
+
+void index_linear(const uint8_t * code, size_t size, uint32_t base, std::vector<IndexedOp> & out)
+{
+    size_t first = out.size();
+
+    std::vector<uint8_t> is_start(size, 0);
+    std::vector<uint8_t> leader(size, 0);
+
+    size_t offset = 0;
+    bool new_block = 1;
+    while(offset < size)
+    {
+        DecodedOp op = decode_op(code, size, offset, base);
+        is_start[offset] = 1;
+        if(new_block) leader[offset] = 1;
+        new_block = op.flow != FLOW_NONE;
+
+        out.push_back({op, 0});
+        offset += op.length;
+    }
+
+    // Targets only split blocks where they land on an instruction
+    for(size_t i=first; i!=out.size(); ++i)
+    {
+        uint32_t target;
+        if(!flow_target(out[i].op, target) || target < base || target - base >= size) continue;
+        if(is_start[target - base]) leader[target - base] = 1;
+    }
+
+    uint32_t block = 0;
+    for(size_t i=first; i!=out.size(); ++i)
+    {
+        if(leader[out[i].op.addr - base] && i != first) block++;
+        out[i].block = block;
+    }
+}
+
+void index_graph(ControlFlowGraph & cfg, const uint8_t * code, size_t size, uint32_t base,
+                 std::vector<IndexedOp> & out)
+{
+    uint32_t block = 0;
+    for(const auto & entry: cfg.get_blocks())
+    {
+        const BasicBlock & b = entry.second;
+        for(size_t offset = b.start - base; offset < b.end - base; )
+        {
+            DecodedOp op = decode_op(code, size, offset, base);
+            out.push_back({op, block});
+            offset += op.length;
+        }
+        block++;
+    }
+}
+
+// JSON LINES =================================
+
+static const char hex_digits[] = "0123456789abcdef";
+
+size_t write_json_lines(const std::vector<IndexedOp> & ops, const uint8_t * code, uint32_t base, FILE * out)
+{
+    static const size_t FLUSH_AT = 1 << 20;
+    std::string text;
+    size_t written = 0;
+
+    // Names are plain ASCII with no quotes, they need no escaping
+    char line[192];
+    char operands[24];
+    char bytes[8];
+
+    for(const IndexedOp & entry: ops)
+    {
+        const DecodedOp & op = entry.op;
+        const uint8_t * b = code + (op.addr - base);
+
+        for(uint8_t i=0; i!=op.length; ++i)
+        {
+            bytes[2*i] = hex_digits[b[i] >> 4];
+            bytes[2*i + 1] = hex_digits[b[i] & 0x0F];
+        }
+        bytes[2*op.length] = 0;
+        operands[format_operands(op, operands)] = 0;
+
+        char target[16] = "null";
+        uint32_t to;
+        if(flow_target(op, to)) snprintf(target, sizeof(target), "%u", to);
+
+        int n = snprintf(line, sizeof(line),
+                         "{\"addr\":%u,\"bytes\":\"%s\",\"mnemonic\":\"%s\",\"operands\":\"%s\",\"target\":%s,\"block\":%u}\n",
+                         op.addr, bytes, mnemonic_names[op.mnemonic], operands, target, entry.block);
+        text.append(line, n);
+
+        if(text.size() >= FLUSH_AT)
+        {
+            fwrite(text.data(), 1, text.size(), out);
+            written += text.size();
+            text.clear();
+        }
+    }
+
+    fwrite(text.data(), 1, text.size(), out);
+    return written + text.size();
+}
+
+// BINARY INDEX ===============================
+
+bool write_index(const std::vector<IndexedOp> & ops, size_t size, uint32_t base, const std::string & path)
+{
+    FILE * f = fopen(path.c_str(), "wb");
+    if(!f) return 0;
+
+    IndexHeader header = {};
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = INDEX_VERSION;
+    header.base = base;
+    header.size = size;
+    header.record_count = ops.size();
+    header.records_offset = sizeof(IndexHeader);
+    header.lookup_offset = header.records_offset + ops.size() * sizeof(IndexRecord);
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+    std::vector<IndexRecord> records(ops.size());
+    std::vector<uint32_t> lookup(size, INDEX_NONE);
+    for(size_t i=0; i!=ops.size(); ++i)
+    {
+        const DecodedOp & op = ops[i].op;
+        IndexRecord & r = records[i];
+
+        r = {};
+        r.addr = op.addr;
+        r.block = ops[i].block;
+        r.target = INDEX_NONE;
+        flow_target(op, r.target);
+        r.operand = op.operand;
+        r.opcode = op.opcode;
+        r.length = op.length;
+        r.mnemonic = op.mnemonic;
+        r.flow = op.flow;
+
+        for(uint8_t j=0; j!=op.length; ++j) lookup[op.addr - base + j] = i;
+    }
+
+    if(ok && !records.empty()) ok = fwrite(records.data(), sizeof(IndexRecord), records.size(), f) == records.size();
+    if(ok && !lookup.empty()) ok = fwrite(lookup.data(), sizeof(uint32_t), lookup.size(), f) == lookup.size();
+
+    ok = (fclose(f) == 0) && ok;
+    return ok;
+}
+
+bool InstructionIndex::open(const std::string & path)
+{
+    close();
+
+    // Lookups jump around, so the file isn't read ahead
+    if(!file.open(path, 0) || file.size() < sizeof(IndexHeader)) return 0;
+
+    const IndexHeader * h = (const IndexHeader *)file.data();
+    bool valid = std::memcmp(h->magic, INDEX_MAGIC, sizeof(h->magic)) == 0
+              && h->version == INDEX_VERSION
+              && h->records_offset + h->record_count * sizeof(IndexRecord) <= h->lookup_offset
+              && h->lookup_offset + h->size * sizeof(uint32_t) <= file.size();
+    if(!valid)
+    {
+        file.close();
+        return 0;
+    }
+
+    header = h;
+    records = (const IndexRecord *)(file.data() + h->records_offset);
+    table = (const uint32_t *)(file.data() + h->lookup_offset);
+    return 1;
+}
+
+void InstructionIndex::close()
+{
+    file.close();
+    header = nullptr;
+    records = nullptr;
+    table = nullptr;
+}
+
+uint32_t InstructionIndex::get_base()
+{
+    return header ? header->base : 0;
+}
+
+uint64_t InstructionIndex::get_size()
+{
+    return header ? header->size : 0;
+}
+
+uint64_t InstructionIndex::record_count()
+{
+    return header ? header->record_count : 0;
+}
+
+const IndexRecord & InstructionIndex::record(uint64_t i)
+{
+    return records[i];
+}
+
+const IndexRecord * InstructionIndex::lookup(uint32_t addr)
+{
+    if(!header || addr < header->base || addr - header->base >= header->size) return nullptr;
+
+    uint32_t i = table[addr - header->base];
+    return (i == INDEX_NONE) ? nullptr : &records[i];
+}
@@ -0,0 +1,102 @@
+/*
+Machine readable disassembly for other tools: JSON lines and a binary
+instruction index.
+
+Both are written from a list of IndexedOp, built either by a linear sweep
+or from a control flow graph. Data bytes left out by a recursive
+traversal have no entry.
+
+The binary index is laid out to be mapped and used in place:
+
+    IndexHeader
+    IndexRecord records[record_count]       one per instruction, in address order
+    uint32_t lookup[size]                   record of each byte, or INDEX_NONE
+
+so finding the instruction covering an address is one table read, however
+large the image. Fields are little endian, as written by the host.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "cfg.h"
+#include "disasm.h"
+#include "mapfile.h"
+
+static const uint32_t INDEX_NONE = 0xFFFFFFFF;
+static const uint32_t INDEX_VERSION = 1;
+
+// An instruction and the basic block it belongs to
+struct IndexedOp
+{
+    DecodedOp op;
+    uint32_t block;
+};
+
+struct IndexHeader
+{
+    char magic[8];              // "I8080IX" and a terminator
+    uint32_t version;
+    uint32_t base;              // Address of the first byte
+    uint64_t size;              // Bytes of code covered
+    uint64_t record_count;
+    uint64_t records_offset;    // From the start of the file
+    uint64_t lookup_offset;
+};
+
+struct IndexRecord
+{
+    uint32_t addr;
+    uint32_t block;
+    uint32_t target;            // Jump, call or RST target, or INDEX_NONE
+    uint16_t operand;
+    uint8_t opcode;
+    uint8_t length;
+    uint8_t mnemonic;           // Mnemonic, indexes mnemonic_names
+    uint8_t flow;               // FlowKind
+    uint8_t reserved[2];
+};
+
+// A linear sweep of the whole code. Blocks start at the first instruction,
+// after every flow instruction and at every target the sweep lands on.
+void index_linear(const uint8_t * code, size_t size, uint32_t base, std::vector<IndexedOp> & out);
+
+// The instructions a built graph found, numbered by block in address order
+void index_graph(ControlFlowGraph & cfg, const uint8_t * code, size_t size, uint32_t base,
+                 std::vector<IndexedOp> & out);
+
+// One JSON object per line, e.g.
+//   {"addr":256,"bytes":"0612","mnemonic":"MVI","operands":"B,#$12","target":null,"block":0}
+// code and base are those the ops were decoded from. Returns the characters written.
+size_t write_json_lines(const std::vector<IndexedOp> & ops, const uint8_t * code, uint32_t base, FILE * out);
+
+// Writes the binary index for code of the given size. False on a write error.
+bool write_index(const std::vector<IndexedOp> & ops, size_t size, uint32_t base, const std::string & path);
+
+// Read side of the binary index, mapped rather than loaded
+class InstructionIndex
+{
+    public:
+        // False if the file can't be mapped or isn't a valid index
+        bool open(const std::string & path);
+        void close();
+
+        uint32_t get_base();
+        uint64_t get_size();
+        uint64_t record_count();
+        const IndexRecord & record(uint64_t i);
+
+        // The instruction covering addr, or null for data and addresses outside the code
+        const IndexRecord * lookup(uint32_t addr);
+
+    private:
+        MappedFile file;
+        const IndexHeader * header = nullptr;
+        const IndexRecord * records = nullptr;
+        const uint32_t * table = nullptr;
+};
@@ -0,0 +1,528 @@
+/*
+Benchmarks for the i8080 core and the parts of the machine around it:
+    g++ -O2 -pthread bench8080.cpp i8080.cpp opcodes.cpp profile.cpp trace.cpp mapfile.cpp bus.cpp BDOS.cpp bios.cpp console.cpp disk.cpp -o bench8080
+
+Usage: bench8080 [-n count] [-r repeat] [-j] [-f filter] [-p program]... [-c cap] [-s period] [-g] [-t timing]
+    -n  instructions per kernel, bytes or characters per host benchmark (default 10000000)
+    -r  timed runs of each benchmark, the median is reported (default 5)
+    -j  JSON lines instead of the table
+    -f  only run benchmarks whose group/name contains filter
+    -p  CP/M program to run to completion at 0100, may be repeated.
+        test/cpudiag.bin is run when present and no program is given.
+    -c  instruction cap for a program that never ends (default 1000000000)
+    -s  run with the sampling profiler attached, sampling every period
+        cycles, to measure its overhead. The kernels and synthetic
+        programs nest at most one call, a deeper shadow stack at the end
+        of a run is an error.
+    -g  run with the call graph profiler attached, to measure its
+        overhead, checked the same way as -s
+    -t  core timing, exact or fast (default exact)
+
+Groups:
+    core     unrolled kernels per opcode class, an endless loop of 64
+             instructions stepped exactly count times
+    program  whole programs, the synthetic ones loop forever and are
+             stepped count times, CP/M programs run until they end
+    bus      Bus::read_from_ram and write_to_ram
+    bdos     console output through the BDOS, from guest CALL 5 loops
+             and from the host side, into a discarding sink
+
+The JSON lines form is stable for tracking results between versions. The
+first line describes the run, each further line is one benchmark:
+    {"schema":"bench8080/1","count":...,"repeat":...,"sample_period":...,"call_graph":...,"timing":"...","compiler":"..."}
+    {"schema":"bench8080/1","group":"core","name":"mov_reg","unit":"instr",
+     "ops":...,"cycles":...,"seconds":...,"best_seconds":...,
+     "mops":...,"ns_per_op":...,"emulated_mhz":...}
+seconds is the median run and best_seconds the fastest. cycles and
+emulated_mhz are 0 where no guest code runs.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bus.h"
+#include "profile.h"
+
+using namespace std;
+
+// Built up at 0100 with a RET and an RNZ subroutine at 0103 and 0104, for
+// the call kernels, then a preamble and an endless loop round the body
+struct Program
+{
+    static const uint16_t ORG = 0x0100;
+    static const uint16_t SUB_RET = 0x0103;
+    static const uint16_t SUB_RNZ = 0x0104;
+
+    vector<uint8_t> bytes;
+
+    uint16_t here()
+    {
+        return ORG + bytes.size();
+    }
+
+    void emit(initializer_list<uint8_t> list)
+    {
+        bytes.insert(bytes.end(), list);
+    }
+
+    void emit_addr(uint8_t op, uint16_t addr)
+    {
+        emit({op, uint8_t(addr & 0xFF), uint8_t(addr >> 8)});
+    }
+};
+
+struct Result
+{
+    string group;
+    string name;
+    const char * unit;
+    uint64_t ops = 0;
+    uint64_t cycles = 0;
+    double seconds = 0;
+    double best_seconds = 0;
+};
+
+struct Options
+{
+    uint64_t count = 10000000;
+    int repeat = 5;
+    bool json = 0;
+    string filter;
+    vector<string> programs;
+    uint64_t cap = 1000000000;
+    uint32_t sample_period = 0;
+    bool call_graph = 0;
+    i8080::Timing timing = i8080::CYCLE_EXACT;
+};
+
+using Clock = chrono::steady_clock;
+
+static double since(Clock::time_point start)
+{
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+// A fresh machine with quiet tracing and console output thrown away
+static unique_ptr<Bus> make_bus(const Options & options, NullSink & sink)
+{
+    unique_ptr<Bus> bus(new Bus(options.timing));
+    bus->cpu.trace = 0;
+    bus->bdos.console.set_sink(&sink);
+    return bus;
+}
+
+// Runs one warm up and then repeat timed runs. Each run gets a fresh
+// machine from setup, which isn't timed, and returns the guest cycles.
+// max_depth is the deepest the guest nests calls, the profiler's shadow
+// stack must be no deeper when the run ends. -1 if it isn't known.
+static Result measure(const Options & options, const string & group, const string & name,
+                      const char * unit, uint64_t ops,
+                      function<void(Bus &)> setup, function<uint64_t(Bus &)> run, int max_depth = -1)
+{
+    Result result;
+    result.group = group;
+    result.name = name;
+    result.unit = unit;
+    result.ops = ops;
+
+    NullSink sink;
+    vector<double> times;
+    for(int r=-1; r!=options.repeat; ++r)
+    {
+        unique_ptr<Bus> bus = make_bus(options, sink);
+        setup(*bus);
+
+        unique_ptr<SamplingProfiler> sampler;
+        if(options.sample_period)
+        {
+            sampler.reset(new SamplingProfiler(options.sample_period));
+            bus->cpu.sampler = sampler.get();
+        }
+        unique_ptr<CallGraphProfiler> call_graph;
+        if(options.call_graph)
+        {
+            call_graph.reset(new CallGraphProfiler());
+            call_graph->reset(bus->cpu.PC);
+            bus->cpu.call_graph = call_graph.get();
+        }
+
+        Clock::time_point start = Clock::now();
+        uint64_t cycles = run(*bus);
+        double seconds = since(start);
+
+        if(sampler && max_depth >= 0 && sampler->get_depth() > (uint32_t)max_depth)
+        {
+            fprintf(stderr, "error: %s/%s left the sampler %u frames deep, the guest nests %d\n",
+                    group.c_str(), name.c_str(), sampler->get_depth(), max_depth);
+            exit(1);
+        }
+        if(call_graph && max_depth >= 0 && call_graph->get_depth() > (uint32_t)max_depth)
+        {
+            fprintf(stderr, "error: %s/%s left the call graph %u frames deep, the guest nests %d\n",
+                    group.c_str(), name.c_str(), call_graph->get_depth(), max_depth);
+            exit(1);
+        }
+
+        if(r < 0) continue;
+        times.push_back(seconds);
+        result.cycles = cycles;
+    }
+
+    sort(times.begin(), times.end());
+    result.seconds = times[times.size() / 2];
+    result.best_seconds = times.front();
+    return result;
+}
+
+static uint64_t step_count(Bus & bus, uint64_t count)
+{
+    uint64_t cycles = 0;
+    for(uint64_t i=0; i!=count; ++i) cycles += bus.cpu.step();
+    return cycles;
+}
+
+static void load_program(Bus & bus, const Program & program)
+{
+    copy(program.bytes.begin(), program.bytes.end(), bus.ram.begin() + Program::ORG);
+    bus.cpu.PC = Program::ORG;
+}
+
+// CORE KERNELS ===============================
+
+// Emits instruction i of a 64 instruction body
+using BodyEmitter = function<void(Program & p, int i)>;
+
+static Program make_kernel(BodyEmitter body, uint16_t stack)
+{
+    Program p;
+    p.emit_addr(0xC3, 0x0105);      // JMP start
+    p.emit({0xC9});                 // RET
+    p.emit({0xC0});                 // RNZ, taken as Z is clear
+
+    // SP and HL set, A=1 so Z is clear for the conditional kernels
+    p.emit_addr(0x31, stack);       // LXI SP
+    p.emit_addr(0x21, 0x2000);      // LXI H
+    p.emit_addr(0x11, 0x0000);      // LXI D
+    p.emit({0xF6, 0x01});           // ORI 1
+
+    uint16_t loop = p.here();
+    for(int i=0; i!=64; ++i) body(p, i);
+    p.emit_addr(0xC3, loop);        // JMP loop
+    return p;
+}
+
+// Cycles through a list of single byte opcodes
+static BodyEmitter cycle_ops(vector<uint8_t> ops)
+{
+    return [ops](Program & p, int i) { p.emit({ops[i % ops.size()]}); };
+}
+
+struct Kernel
+{
+    const char * name;
+    BodyEmitter body;
+    uint16_t stack = 0xF000;        // Initial SP
+};
+
+static vector<Kernel> core_kernels()
+{
+    return {
+        {"nop",             cycle_ops({0x00})},
+        {"mov_reg",         cycle_ops({0x7A, 0x5F, 0x6B, 0x54})},     // MOV A,D  E,A  L,E  D,H
+        {"mov_mem",         cycle_ops({0x77, 0x7E, 0x56, 0x73})},     // MOV M,A  A,M  D,M  M,E
+        {"mvi",             [](Program & p, int i) { p.emit({0x16, uint8_t(i)}); }},    // MVI D
+        {"alu_reg",         cycle_ops({0x82, 0x8B, 0x92, 0x9B, 0xA2, 0xAB, 0xB2, 0xBB})},
+        {"alu_mem",         cycle_ops({0x86, 0x8E, 0x96, 0x9E, 0xA6, 0xAE, 0xB6, 0xBE})},
+        {"alu_imm",         [](Program & p, int i) { p.emit({uint8_t(0xC6 + 8*(i % 8)), uint8_t(i)}); }},
+        {"inr_dcr",         cycle_ops({0x14, 0x1C, 0x15, 0x1D})},     // INR D  E, DCR D  E
+        {"inx_dcx_dad",     cycle_ops({0x13, 0x1B, 0x19, 0x29})},     // INX D, DCX D, DAD D, DAD H
+        {"rotate",          cycle_ops({0x07, 0x0F, 0x17, 0x1F})},
+        {"jmp",             [](Program & p, int) { p.emit_addr(0xC3, p.here() + 3); }},
+        {"jcc_taken",       [](Program & p, int) { p.emit_addr(0xC2, p.here() + 3); }},   // JNZ
+        {"jcc_not_taken",   [](Program & p, int) { p.emit_addr(0xCA, p.here() + 3); }},   // JZ
+        {"call_ret",        [](Program & p, int) { p.emit_addr(0xCD, Program::SUB_RET); }},
+        {"call_ret_stack_top", [](Program & p, int) { p.emit_addr(0xCD, Program::SUB_RET); }, 0x0000},
+        {"ccc_rcc_taken",   [](Program & p, int) { p.emit_addr(0xC4, Program::SUB_RNZ); }},   // CNZ to RNZ
+        {"ccc_not_taken",   [](Program & p, int) { p.emit_addr(0xCC, Program::SUB_RET); }},   // CZ
+        {"push_pop",        cycle_ops({0xD5, 0xE1, 0xE5, 0xD1})},     // PUSH D, POP H, PUSH H, POP D
+        {"push_pop_psw",    cycle_ops({0xF5, 0xF1})},
+    };
+}
+
+// PROGRAMS ===================================
+
+// Copies 256 bytes from 2000 to 3000 summing them into C, forever
+static Program synthetic_copy()
+{
+    Program p;
+    p.emit_addr(0x31, 0xF000);      // LXI SP
+    uint16_t outer = p.here();
+    p.emit_addr(0x21, 0x2000);      // LXI H
+    p.emit_addr(0x11, 0x3000);      // LXI D
+    p.emit({0x06, 0x00});           // MVI B,0
+    uint16_t inner = p.here();
+    p.emit({0x7E, 0x12, 0x81, 0x4F, 0x23, 0x13, 0x05}); // MOV A,M  STAX D  ADD C  MOV C,A  INX H  INX D  DCR B
+    p.emit_addr(0xC2, inner);       // JNZ inner
+    p.emit_addr(0xC3, outer);       // JMP outer
+    return p;
+}
+
+// 16 bit multiply by shift and add of DE and BC, with a call per product
+static Program synthetic_multiply()
+{
+    Program p;
+    p.emit_addr(0x31, 0xF000);      // LXI SP
+    uint16_t loop = p.here();
+    p.emit_addr(0x01, 0x1234);      // LXI B
+    p.emit_addr(0x11, 0x0567);      // LXI D
+    uint16_t call = p.here();
+    p.emit_addr(0xCD, 0);           // CALL mul, patched below
+    p.emit_addr(0xC3, loop);        // JMP loop
+
+    // HL = BC * DE, 16 rounds of DAD H, then DE shifted left into CY
+    uint16_t mul = p.here();
+    p.bytes[call - Program::ORG + 1] = mul & 0xFF;
+    p.bytes[call - Program::ORG + 2] = mul >> 8;
+    p.emit_addr(0x21, 0x0000);      // LXI H,0
+    p.emit({0x3E, 16});             // MVI A,16
+    uint16_t round = p.here();
+    p.emit({0x29});                 // DAD H
+    p.emit({0xEB, 0x29, 0xEB});     // XCHG  DAD H  XCHG, CY is the old top bit of DE
+    uint16_t skip = p.here() + 3 + 1;
+    p.emit_addr(0xD2, skip);        // JNC skip
+    p.emit({0x09});                 // DAD B
+    p.emit({0x3D});                 // DCR A
+    p.emit_addr(0xC2, round);       // JNZ round
+    p.emit({0xC9});                 // RET
+    return p;
+}
+
+static bool file_exists(const string & path)
+{
+    return ifstream(path).good();
+}
+
+// HOST BENCHMARKS ============================
+
+static uint64_t bus_reads(Bus & bus, uint64_t count)
+{
+    uint8_t sum = 0;
+    for(uint64_t i=0; i!=count; ++i) sum += bus.read_from_ram(i & 0xFFFF);
+
+    // Keeps the loop from being optimised away
+    bus.ram[0] = sum;
+    return 0;
+}
+
+static uint64_t bus_writes(Bus & bus, uint64_t count)
+{
+    for(uint64_t i=0; i!=count; ++i) bus.write_to_ram(i & 0xFFFF, i);
+    return 0;
+}
+
+// Guest loop printing one character per pass through CALL 5
+static Program bdos_char_loop()
+{
+    Program p;
+    p.emit_addr(0x31, 0xF000);      // LXI SP
+    uint16_t loop = p.here();
+    p.emit({0x0E, 0x02});           // MVI C,2
+    p.emit({0x1E, 'x'});            // MVI E,'x'
+    p.emit_addr(0xCD, 0x0005);      // CALL 5
+    p.emit_addr(0xC3, loop);        // JMP loop
+    return p;
+}
+
+// Guest loop printing a 64 character string per pass through CALL 5
+static const uint16_t BDOS_STRING = 0x2000;
+static const size_t BDOS_STRING_LENGTH = 64;
+
+static Program bdos_string_loop()
+{
+    Program p;
+    p.emit_addr(0x31, 0xF000);      // LXI SP
+    uint16_t loop = p.here();
+    p.emit({0x0E, 0x09});           // MVI C,9
+    p.emit_addr(0x11, BDOS_STRING); // LXI D
+    p.emit_addr(0xCD, 0x0005);      // CALL 5
+    p.emit_addr(0xC3, loop);        // JMP loop
+    return p;
+}
+
+// RUNNING ====================================
+
+static void print_header(const Options & options)
+{
+    if(options.json)
+    {
+        printf("{\"schema\":\"bench8080/1\",\"count\":%llu,\"repeat\":%d,\"sample_period\":%u,\"call_graph\":%d,\"timing\":\"%s\",\"compiler\":\"%s\"}\n",
+               (unsigned long long)options.count, options.repeat, options.sample_period, (int)options.call_graph,
+               options.timing == i8080::FAST ? "fast" : "exact", __VERSION__);
+        return;
+    }
+
+    printf("%-8s %-22s %-6s %12s %10s %10s %10s %10s\n",
+           "group", "name", "unit", "ops", "seconds", "Mops/s", "ns/op", "emu MHz");
+}
+
+static void print_result(const Options & options, const Result & r)
+{
+    double mops = r.seconds > 0 ? r.ops / r.seconds / 1e6 : 0;
+    double ns = r.ops ? r.seconds * 1e9 / r.ops : 0;
+    double mhz = r.seconds > 0 ? r.cycles / r.seconds / 1e6 : 0;
+
+    if(options.json)
+    {
+        printf("{\"schema\":\"bench8080/1\",\"group\":\"%s\",\"name\":\"%s\",\"unit\":\"%s\","
+               "\"ops\":%llu,\"cycles\":%llu,\"seconds\":%.6f,\"best_seconds\":%.6f,"
+               "\"mops\":%.3f,\"ns_per_op\":%.3f,\"emulated_mhz\":%.3f}\n",
+               r.group.c_str(), r.name.c_str(), r.unit,
+               (unsigned long long)r.ops, (unsigned long long)r.cycles, r.seconds, r.best_seconds,
+               mops, ns, mhz);
+    }
+    else
+    {
+        printf("%-8s %-22s %-6s %12llu %10.4f %10.2f %10.2f %10.2f\n",
+               r.group.c_str(), r.name.c_str(), r.unit, (unsigned long long)r.ops,
+               r.seconds, mops, ns, mhz);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for(int i=1; i<argc; ++i)
+    {
+        string arg = argv[i];
+        if(arg=="-n" && i+1<argc)       options.count = stoull(argv[++i]);
+        else if(arg=="-r" && i+1<argc)  options.repeat = max(1, stoi(argv[++i]));
+        else if(arg=="-j")              options.json = 1;
+        else if(arg=="-f" && i+1<argc)  options.filter = argv[++i];
+        else if(arg=="-p" && i+1<argc)  options.programs.push_back(argv[++i]);
+        else if(arg=="-c" && i+1<argc)  options.cap = stoull(argv[++i]);
+        else if(arg=="-s" && i+1<argc)  options.sample_period = stoul(argv[++i]);
+        else if(arg=="-g")              options.call_graph = 1;
+        else if(arg=="-t" && i+1<argc && (string(argv[i+1])=="exact" || string(argv[i+1])=="fast"))
+        {
+            options.timing = string(argv[++i])=="fast" ? i8080::FAST : i8080::CYCLE_EXACT;
+        }
+        else
+        {
+            printf("usage: %s [-n count] [-r repeat] [-j] [-f filter] [-p program]... [-c cap] [-s period] [-g] [-t timing]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if(options.programs.empty() && file_exists("test/cpudiag.bin"))
+    {
+        options.programs.push_back("test/cpudiag.bin");
+    }
+
+    uint64_t n = options.count;
+    auto wanted = [&](const string & group, const string & name)
+    {
+        return options.filter.empty() || (group + "/" + name).find(options.filter) != string::npos;
+    };
+    auto run_stepped = [&](const string & group, const string & name, const Program & program,
+                           function<void(Bus &)> extra_setup, uint64_t steps, uint64_t ops, const char * unit)
+    {
+        if(!wanted(group, name)) return;
+
+        Result r = measure(options, group, name, unit, ops,
+            [&](Bus & bus) { load_program(bus, program); if(extra_setup) extra_setup(bus); },
+            [&](Bus & bus) { return step_count(bus, steps); }, 1);
+        print_result(options, r);
+    };
+
+    print_header(options);
+
+    for(const Kernel & kernel: core_kernels())
+    {
+        run_stepped("core", kernel.name, make_kernel(kernel.body, kernel.stack), nullptr, n, n, "instr");
+    }
+
+    run_stepped("program", "synthetic_copy", synthetic_copy(), nullptr, n, n, "instr");
+    run_stepped("program", "synthetic_multiply", synthetic_multiply(), nullptr, n, n, "instr");
+
+    // CP/M programs run until they end, so the instruction count comes
+    // from the run itself
+    for(const string & path: options.programs)
+    {
+        string name = path.substr(path.find_last_of('/') + 1);
+        if(!wanted("program", name)) continue;
+
+        if(!file_exists(path))
+        {
+            fprintf(stderr, "error: Couldn't open %s\n", path.c_str());
+            exit(1);
+        }
+
+        uint64_t executed = 0;
+        Result r = measure(options, "program", name, "instr", 0,
+            [&](Bus & bus)
+            {
+                bus.bdos.setup_page_zero({});
+                bus.bios.install(BDOS::BIOS_BASE);
+                bus.load_rom(path.c_str(), Program::ORG);
+                bus.cpu.PC = Program::ORG;
+            },
+            [&](Bus & bus)
+            {
+                uint64_t cycles = 0;
+                executed = 0;
+                while(!bus.cpu.is_stopped() && executed != options.cap)
+                {
+                    cycles += bus.cpu.step();
+                    executed++;
+                }
+                return cycles;
+            });
+        r.ops = executed;
+        print_result(options, r);
+    }
+
+    if(wanted("bus", "read"))
+    {
+        print_result(options, measure(options, "bus", "read", "byte", n,
+            [](Bus &) {}, [&](Bus & bus) { return bus_reads(bus, n); }));
+    }
+    if(wanted("bus", "write"))
+    {
+        print_result(options, measure(options, "bus", "write", "byte", n,
+            [](Bus &) {}, [&](Bus & bus) { return bus_writes(bus, n); }));
+    }
+
+    // Each guest character pass steps MVI, MVI, CALL, the trap and JMP
+    uint64_t chars = n / 5;
+    run_stepped("bdos", "guest_char", bdos_char_loop(), nullptr, chars * 5, chars, "char");
+
+    uint64_t strings = n / BDOS_STRING_LENGTH;
+    run_stepped("bdos", "guest_string", bdos_string_loop(),
+        [](Bus & bus)
+        {
+            bus.bdos.string_skip = 0;
+            for(size_t i=0; i!=BDOS_STRING_LENGTH; ++i) bus.ram[BDOS_STRING + i] = 'a' + i % 26;
+            bus.ram[BDOS_STRING + BDOS_STRING_LENGTH] = '$';
+        },
+        strings * 5, strings * BDOS_STRING_LENGTH, "char");
+
+    if(wanted("bdos", "host_char"))
+    {
+        print_result(options, measure(options, "bdos", "host_char", "char", n,
+            [](Bus &) {},
+            [&](Bus & bus)
+            {
+                for(uint64_t i=0; i!=n; ++i) bus.bdos_request(BDOS::CONSOLE_OUTPUT, 0, 'x');
+                return uint64_t(0);
+            }));
+    }
+
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include "bios.h"
+#include "bus.h"
+#include "savestate.h"
+
+BIOS::BIOS() {}
+
+BIOS::~BIOS() {}
+
+void BIOS::connect_bus(Bus * new_bus)
+{
+    bus = new_bus;
+}
+
+void BIOS::install(uint16_t new_base)
+{
+    // Remove the traps of a previous install
+    if(base)
+    {
+        for(uint8_t f=0; f!=FUNCTION_COUNT; ++f) bus->cpu.clear_trap(base + 3*f);
+    }
+    base = new_base;
+
+    // Each slot holds a RET so the table stays valid code without traps
+    for(uint8_t f=0; f!=FUNCTION_COUNT; ++f)
+    {
+        uint16_t slot = base + 3*f;
+        bus->write_to_ram(slot, 0xC9);
+        bus->write_to_ram(slot + 1, 0x00);
+        bus->write_to_ram(slot + 2, 0x00);
+
+        bus->cpu.set_trap(slot, [this, f](i8080 &) { return call(f); });
+    }
+}
+
+bool BIOS::cold_boot(uint16_t new_ccp_base, uint16_t new_system_sectors)
+{
+    ccp_base = new_ccp_base;
+    system_sectors = new_system_sectors;
+
+    install(ccp_base + 0x1600);
+    bus->disks.set_table_base(base + 0x80);
+    bus->cpu.clear_trap(0x0005);
+
+    bus->write_to_ram(0x0003, 0x00);    // IOBYTE
+    bus->write_to_ram(0x0004, 0x00);    // Drive A:, user 0
+
+    if(!bus->disks.load_system(0, ccp_base, system_sectors)) return 0;
+
+    // The CCP takes the current drive in C
+    setup_vectors();
+    bus->disks.set_dma(0x0080);
+    bus->cpu.C = 0;
+    bus->cpu.SP = 0x0100;
+    bus->cpu.PC = ccp_base;
+    return 1;
+}
+
+void BIOS::save_state(StateWriter & out)
+{
+    out.put(base);
+    out.put(ccp_base);
+    out.put(system_sectors);
+    out.put((uint8_t)bus->cpu.has_trap(0x0005));
+}
+
+bool BIOS::load_state(StateReader & in)
+{
+    uint16_t new_base;
+    uint8_t host_bdos;
+    in.get(new_base);
+    in.get(ccp_base);
+    in.get(system_sectors);
+    in.get(host_bdos);
+    if(!in.ok) return 0;
+
+    if(new_base)
+    {
+        install(new_base);
+    }
+    else if(base)
+    {
+        for(uint8_t f=0; f!=FUNCTION_COUNT; ++f) bus->cpu.clear_trap(base + 3*f);
+        base = 0;
+    }
+
+    if(host_bdos) bus->install_bdos_trap();
+    else bus->cpu.clear_trap(0x0005);
+    return 1;
+}
+
+bool BIOS::call(uint8_t function)
+{
+    i8080 & cpu = bus->cpu;
+    uint16_t BC = (cpu.B<<8) | cpu.C;
+    uint16_t DE = (cpu.D<<8) | cpu.E;
+    uint16_t HL = 0;
+
+    switch(function)
+    {
+        case BOOT:
+        case WBOOT:
+            if(ccp_base) return warm_boot();
+
+            // Without a guest CCP a warm boot ends the program
+            bus->bdos.flush_files();
+            bus->bdos.console.flush();
+            bus->disks.flush();
+            cpu.stop();
+            return 0;
+
+        // Console functions go through the BDOS console
+        case CONST:     bus->bdos_request(BDOS::CONSOLE_STATUS, 0, 0); break;
+        case CONIN:     bus->bdos_request(BDOS::CONSOLE_INPUT, 0, 0); break;
+        case CONOUT:    bus->bdos_request(BDOS::CONSOLE_OUTPUT, 0, cpu.C); break;
+        case LIST:      break;
+        case PUNCH:     break;
+        case READER:    cpu.A = 0x1A; break;
+        case LISTST:    cpu.A = 0xFF; break;
+
+        case HOME:      bus->disks.home(); break;
+        case SETTRK:    bus->disks.set_track(BC); break;
+        case SETSEC:    bus->disks.set_sector(BC); break;
+        case SETDMA:    bus->disks.set_dma(BC); break;
+        case READ:      cpu.A = bus->disks.read(); break;
+        case WRITE:     cpu.A = bus->disks.write(cpu.C); break;
+
+        case SELDSK:
+            HL = bus->disks.select_disk(cpu.C);
+            cpu.H = HL >> 8;
+            cpu.L = HL & 0xFF;
+            break;
+
+        case SECTRAN:
+            HL = bus->disks.sector_translate(BC, DE);
+            cpu.H = HL >> 8;
+            cpu.L = HL & 0xFF;
+            break;
+    }
+    return 1;
+}
+
+bool BIOS::warm_boot()
+{
+    i8080 & cpu = bus->cpu;
+
+    bus->disks.flush();
+    if(!bus->disks.load_system(0, ccp_base, system_sectors))
+    {
+        cpu.stop();
+        return 0;
+    }
+
+    setup_vectors();
+    bus->disks.set_dma(0x0080);
+    cpu.C = bus->read_from_ram(0x0004);
+    cpu.SP = 0x0100;
+    cpu.PC = ccp_base + 3;
+    return 0;
+}
+
+void BIOS::setup_vectors()
+{
+    uint16_t wboot = base + 3;
+    uint16_t bdos = ccp_base + 0x0806;
+
+    bus->write_to_ram(0x0000, 0xC3);
+    bus->write_to_ram(0x0001, wboot & 0xFF);
+    bus->write_to_ram(0x0002, wboot >> 8);
+    bus->write_to_ram(0x0005, 0xC3);
+    bus->write_to_ram(0x0006, bdos & 0xFF);
+    bus->write_to_ram(0x0007, bdos >> 8);
+}
@@ -0,0 +1,69 @@
+/*
+CP/M 2.2 BIOS served by host traps. Every jump table slot is trapped, so
+a guest call into the BIOS runs the native routine and returns straight
+to the caller. Console functions share the BDOS console and disk
+functions go to the disk image subsystem.
+
+With a .COM program and the host BDOS, warm boot ends the run. After
+cold_boot() the guest's own CCP and BDOS are loaded from the system
+tracks of drive A: and warm boot reloads them.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+// Forward declaration
+class Bus;
+class StateWriter;
+class StateReader;
+
+class BIOS
+{
+    public:
+        BIOS();
+        ~BIOS();
+
+        // Called by Bus on creation to link to the BIOS
+        void connect_bus(Bus * new_bus);
+
+        // Writes the jump table at base and traps each of its slots
+        void install(uint16_t base);
+
+        // Boots CP/M from drive A:. The BIOS sits above the BDOS as
+        // in a standard system (ccp_base + 1600h) and the host BDOS
+        // trap is removed so the guest BDOS handles calls to 0005.
+        bool cold_boot(uint16_t ccp_base, uint16_t system_sectors = 44);
+
+        // The jump table and guest system, and whether calls to 0005
+        // reach the host BDOS, for save states. Loading reinstalls the
+        // traps.
+        void save_state(StateWriter & out);
+        bool load_state(StateReader & in);
+
+    public:
+        // Jump table order
+        enum FUNCTIONS
+        {
+            BOOT, WBOOT, CONST, CONIN, CONOUT, LIST, PUNCH, READER,
+            HOME, SELDSK, SETTRK, SETSEC, SETDMA, READ, WRITE, LISTST,
+            SECTRAN, FUNCTION_COUNT
+        };
+
+    private:
+        Bus * bus = nullptr;
+        uint16_t base = 0;
+
+        // Set by cold_boot, warm boot reloads the system when non zero
+        uint16_t ccp_base = 0;
+        uint16_t system_sectors = 0;
+
+        // Runs a BIOS function, returns 1 to return to the caller
+        bool call(uint8_t function);
+
+        // Reloads the CCP and BDOS and enters the CCP
+        bool warm_boot();
+
+        // Page zero jumps to the BIOS warm boot and the guest BDOS
+        void setup_vectors();
+};
@@ -1,27 +1,55 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <functional>
+#include <random>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "bus.h"
+#include "mapfile.h"
+#include "savestate.h"
+
+static const char STATE_MAGIC[8] = "I8080SS";
 
-Bus::Bus() 
+Bus::Bus(i8080::Timing timing) : cpu(timing)
 {
     cpu.connect_bus(this);
     bdos.connect_bus(this);
+    bios.connect_bus(this);
+    disks.connect_bus(this);
 
     // Clear RAM
     for(auto& addr: ram)
     {
         addr=0;
     }
+    page_flags.fill(0);
+    dirty_pages.fill(0);
+
+    install_bdos_trap();
 }
 
 Bus::~Bus() {}
 
-// Passes on the CPU's request to the BDOS unit
+// Passes on the CPU's request to the BDOS unit, from the trap at 0005
 void Bus::bdos_request(uint8_t C, uint8_t D, uint8_t E) 
 {
     bdos.bdos_request(C, D, E);
 }
 
+// Calls to 0005 reach the host BDOS
+void Bus::install_bdos_trap()
+{
+    cpu.set_trap(0x0005, [this](i8080 & cpu)
+    {
+        bdos_request(cpu.C, cpu.D, cpu.E);
+        return 1;
+    });
+}
+
 void Bus::load_rom(const char* filename, uint16_t start_addr=0)
 {
     std::ifstream rom_file(filename, std::ios::binary);
@@ -30,23 +58,406 @@ void Bus::load_rom(const char* filename, uint16_t start_addr=0)
     int fsize = rom_file.tellg();
     rom_file.seekg(0, std::ios::beg);
 
+    // Never load past the top of memory
+    if(fsize > (int)ram.size() - start_addr) fsize = ram.size() - start_addr;
+
     rom_file.read((char*)&ram[start_addr], fsize);
+    if(fsize > 0) mark_dirty(start_addr, fsize);
 }
 
+// RAM spans all 64K, so every address is valid
 uint8_t Bus::read_from_ram(uint16_t addr)
 {
-    if(addr >= 0x0000 && addr <= 0x4000)
+    if(page_flags[addr >> PAGE_SHIFT] & WATCH_READ) check_watch(addr, WATCH_READ);
+    return ram[addr];
+}
+
+uint8_t Bus::fetch_from_ram(uint16_t addr)
+{
+    return ram[addr];
+}
+
+void Bus::write_to_ram(uint16_t addr, uint8_t data)
+{
+    if(page_flags[addr >> PAGE_SHIFT] & (WATCH_WRITE | KEEP_PAGE)) before_write(addr);
+    dirty_pages[addr >> PAGE_SHIFT] = 1;
+    ram[addr] = data;
+}
+
+// DIRTY PAGES ================================
+
+void Bus::mark_dirty(uint16_t addr, uint32_t length)
+{
+    if(!length) return;
+    uint32_t last = std::min<uint32_t>(addr + length - 1, ram.size() - 1);
+    for(uint32_t p = addr >> PAGE_SHIFT; p <= last >> PAGE_SHIFT; ++p) dirty_pages[p] = 1;
+}
+
+int Bus::count_dirty_pages()
+{
+    int count = 0;
+    for(uint8_t dirty: dirty_pages) count += dirty;
+    return count;
+}
+
+void Bus::clear_dirty_pages()
+{
+    dirty_pages.fill(0);
+}
+
+void Bus::revert_dirty_pages(const uint8_t * image)
+{
+    for(int p=0; p!=PAGE_COUNT; ++p)
     {
-        return ram[addr];
+        if(dirty_pages[p]) std::memcpy(&ram[p << PAGE_SHIFT], image + (p << PAGE_SHIFT), PAGE_SIZE);
     }
+    dirty_pages.fill(0);
+
+    // The image needn't be the last checkpoint
+    checkpoint = 0;
 }
 
-void Bus::write_to_ram(uint16_t addr, uint8_t data)
+// WATCHPOINTS ================================
+
+void Bus::add_watchpoint(uint16_t addr, uint16_t length, WatchKind kind)
+{
+    watchpoints.push_back({addr, length, kind});
+    update_page_flags();
+}
+
+bool Bus::remove_watchpoint(uint16_t addr, uint16_t length, WatchKind kind)
 {
-    if(addr >= 0x0000 && addr <= 0x4000)
+    for(auto w = watchpoints.begin(); w != watchpoints.end(); ++w)
     {
-        ram[addr] = data;
+        if(w->addr == addr && w->length == length && w->kind == kind)
+        {
+            watchpoints.erase(w);
+            update_page_flags();
+            return 1;
+        }
     }
+    return 0;
 }
 
+void Bus::clear_watchpoints()
+{
+    watchpoints.clear();
+    update_page_flags();
+}
 
+Bus::WatchHit Bus::get_watch_hit()
+{
+    return watch_hit;
+}
+
+// Ranges may wrap round the top of memory
+void Bus::update_page_flags()
+{
+    page_flags.fill(0);
+    for(const Watchpoint & w: watchpoints)
+    {
+        for(uint32_t i=0; i<w.length; i += 1 << PAGE_SHIFT)
+        {
+            page_flags[uint16_t(w.addr + i) >> PAGE_SHIFT] |= w.kind;
+        }
+        if(w.length) page_flags[uint16_t(w.addr + w.length - 1) >> PAGE_SHIFT] |= w.kind;
+    }
+}
+
+// Kept pages are stored as in a delta state, a page number and its bytes
+void Bus::before_write(uint16_t addr)
+{
+    uint8_t & flags = page_flags[addr >> PAGE_SHIFT];
+    if(flags & KEEP_PAGE)
+    {
+        const uint8_t * page = &ram[addr & ~(PAGE_SIZE - 1)];
+        kept_pages.push_back(addr >> PAGE_SHIFT);
+        kept_pages.insert(kept_pages.end(), page, page + PAGE_SIZE);
+        flags &= ~KEEP_PAGE;
+    }
+    if(flags & WATCH_WRITE) check_watch(addr, WATCH_WRITE);
+}
+
+void Bus::check_watch(uint16_t addr, WatchKind access)
+{
+    for(const Watchpoint & w: watchpoints)
+    {
+        if((w.kind & access) && uint16_t(addr - w.addr) < w.length)
+        {
+            watch_hit = {addr, w.kind};
+            cpu.debug_break(i8080::DEBUG_WATCHPOINT);
+            return;
+        }
+    }
+}
+
+// SAVE STATES ================================
+
+// Checkpoints are told apart by a random id
+static uint64_t new_checkpoint_id()
+{
+    std::random_device random;
+    uint64_t id = 0;
+    while(!id) id = (uint64_t)random() << 32 | random();
+    return id;
+}
+
+bool Bus::save_state(std::vector<uint8_t> & state, bool delta, std::string & error)
+{
+    if(delta && !checkpoint)
+    {
+        error = "There is no checkpoint to save a delta against";
+        return 0;
+    }
+
+    StateWriter out;
+    out.data.swap(state);
+    out.data.clear();
+    out.data.reserve(sizeof(StateHeader) + (delta ? 0 : ram.size()) + 4096);
+    out.put(StateHeader{});
+
+    out.begin_section(state_tag("CPU "));
+    cpu.save_state(out);
+    out.end_section();
+
+    // A delta holds the pages written since its parent, each as its
+    // number and its bytes
+    if(delta)
+    {
+        out.begin_section(state_tag("PAGE"));
+        out.put((uint32_t)count_dirty_pages());
+        for(int p=0; p!=PAGE_COUNT; ++p)
+        {
+            if(!dirty_pages[p]) continue;
+            out.put((uint8_t)p);
+            out.put(&ram[p << PAGE_SHIFT], PAGE_SIZE);
+        }
+        out.end_section();
+    }
+    else
+    {
+        out.begin_section(state_tag("RAM "));
+        out.put(ram.data(), ram.size());
+        out.end_section();
+    }
+
+    out.begin_section(state_tag("BDOS"));
+    bdos.save_state(out);
+    out.end_section();
+
+    out.begin_section(state_tag("BIOS"));
+    bios.save_state(out);
+    out.end_section();
+
+    out.begin_section(state_tag("DISK"));
+    disks.save_state(out);
+    out.end_section();
+
+    uint64_t id = new_checkpoint_id();
+    out.begin_section(state_tag("LINK"));
+    out.put(id);
+    out.put(delta ? checkpoint : (uint64_t)0);
+    out.end_section();
+
+    StateHeader header = {};
+    std::memcpy(header.magic, STATE_MAGIC, sizeof(header.magic));
+    header.version = STATE_VERSION;
+    header.section_count = out.get_section_count();
+    header.size = out.data.size();
+    std::memcpy(out.data.data(), &header, sizeof(header));
+
+    out.data.swap(state);
+    checkpoint = id;
+    dirty_pages.fill(0);
+    return 1;
+}
+
+bool Bus::save_state(const std::string & path, bool delta, std::string & error)
+{
+    std::vector<uint8_t> state;
+    if(!save_state(state, delta, error)) return 0;
+
+    // Written beside the old state and renamed over it, so a reader
+    // never sees half a file
+    std::string temp = path + ".tmp";
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+    {
+        error = "Couldn't create " + temp;
+        return 0;
+    }
+
+    size_t done = 0;
+    while(done < state.size())
+    {
+        ssize_t n = ::write(fd, state.data() + done, state.size() - done);
+        if(n <= 0) break;
+        done += n;
+    }
+    bool ok = ::close(fd) == 0 && done == state.size();
+    if(!ok || std::rename(temp.c_str(), path.c_str()) != 0)
+    {
+        ::unlink(temp.c_str());
+        error = "Couldn't write " + path;
+        return 0;
+    }
+    return 1;
+}
+
+bool Bus::load_state(const std::string & path, std::string & error)
+{
+    MappedFile file;
+    if(!file.open(path))
+    {
+        error = "Couldn't read " + path;
+        return 0;
+    }
+    return load_state(file.data(), file.size(), path, error);
+}
+
+bool Bus::load_state(const uint8_t * data, size_t size, std::string & error)
+{
+    return load_state(data, size, "The state", error);
+}
+
+bool Bus::load_state(const uint8_t * data, size_t size, const std::string & name, std::string & error)
+{
+    StateHeader header = {};
+    if(size >= sizeof(header)) std::memcpy(&header, data, sizeof(header));
+    if(size < sizeof(header) || std::memcmp(header.magic, STATE_MAGIC, sizeof(header.magic)) != 0)
+    {
+        error = name + " isn't a save state";
+        return 0;
+    }
+    if(header.version != STATE_VERSION)
+    {
+        error = name + " is a version " + std::to_string(header.version) + " save state, this reads version "
+              + std::to_string(STATE_VERSION);
+        return 0;
+    }
+    if(header.size != size)
+    {
+        error = name + " is truncated";
+        return 0;
+    }
+
+    // Find the sections first, they are applied in an order of their own
+    enum { CPU, RAM, PAGES, BDOS_STATE, BIOS_STATE, DISK, LINK, PART_COUNT };
+    static const uint32_t tags[PART_COUNT] =
+    {
+        state_tag("CPU "), state_tag("RAM "), state_tag("PAGE"), state_tag("BDOS"), state_tag("BIOS"),
+        state_tag("DISK"), state_tag("LINK")
+    };
+    const uint8_t * part[PART_COUNT] = {};
+    uint32_t part_size[PART_COUNT] = {};
+
+    size_t pos = sizeof(header);
+    for(uint32_t s=0; s!=header.section_count; ++s)
+    {
+        StateSection section;
+        if(size - pos < sizeof(section))
+        {
+            error = name + " is truncated";
+            return 0;
+        }
+        std::memcpy(&section, data + pos, sizeof(section));
+        pos += sizeof(section);
+        if(size - pos < section.size)
+        {
+            error = name + " is truncated";
+            return 0;
+        }
+
+        for(int p=0; p!=PART_COUNT; ++p)
+        {
+            if(section.tag != tags[p]) continue;
+            part[p] = data + pos;
+            part_size[p] = section.size;
+        }
+        pos += section.size;
+    }
+
+    bool delta = part[PAGES] && !part[RAM];
+    if(!part[CPU] || (!delta && part_size[RAM] != ram.size()))
+    {
+        error = name + " has no CPU or RAM";
+        return 0;
+    }
+
+    // States before checkpoints were linked have no id, and match none
+    uint64_t id = 0, parent = 0;
+    if(part[LINK])
+    {
+        StateReader in(part[LINK], part_size[LINK]);
+        in.get(id);
+        in.get(parent);
+    }
+
+    // A delta only makes sense over the RAM of its parent
+    uint32_t page_count = 0;
+    StateReader pages(part[PAGES], part_size[PAGES]);
+    if(delta)
+    {
+        if(!parent || parent != checkpoint || count_dirty_pages())
+        {
+            error = name + " is a delta, and only loads over the state it was saved after";
+            return 0;
+        }
+        pages.get(page_count);
+        if(!pages.ok || part_size[PAGES] - sizeof(page_count) != (size_t)page_count * (1 + PAGE_SIZE))
+        {
+            error = name + ": the RAM pages don't load";
+            return 0;
+        }
+    }
+
+    // The disks, BIOS and BDOS write their tables and traps into RAM as
+    // they load, the RAM goes in over them. A delta leaves most of RAM as
+    // it is, so the pages they write are kept and put back after.
+    kept_pages.clear();
+    if(delta)
+    {
+        for(uint8_t & flags: page_flags) flags |= KEEP_PAGE;
+    }
+
+    auto load = [&](int p, const char * part_name, std::function<bool(StateReader &)> apply)
+    {
+        if(!part[p]) return 1;
+        StateReader in(part[p], part_size[p]);
+        if(apply(in)) return 1;
+        error = name + ": the " + part_name + " state doesn't load";
+        return 0;
+    };
+    bool ok = load(DISK, "disk", [&](StateReader & in) { return disks.load_state(in); })
+           && load(BIOS_STATE, "BIOS", [&](StateReader & in) { return bios.load_state(in); })
+           && load(BDOS_STATE, "BDOS", [&](StateReader & in) { return bdos.load_state(in); })
+           && load(CPU, "CPU", [&](StateReader & in) { return cpu.load_state(in); });
+    for(uint8_t & flags: page_flags) flags &= ~KEEP_PAGE;
+    if(!ok)
+    {
+        checkpoint = 0;
+        return 0;
+    }
+
+    if(delta)
+    {
+        for(size_t i=0; i!=kept_pages.size(); i += 1 + PAGE_SIZE)
+        {
+            std::memcpy(&ram[kept_pages[i] << PAGE_SHIFT], &kept_pages[i + 1], PAGE_SIZE);
+        }
+        for(uint32_t i=0; i!=page_count; ++i)
+        {
+            uint8_t p;
+            pages.get(p);
+            pages.get(&ram[p << PAGE_SHIFT], PAGE_SIZE);
+        }
+    }
+    else
+    {
+        std::memcpy(ram.data(), part[RAM], ram.size());
+    }
+
+    checkpoint = id;
+    dirty_pages.fill(0);
+    return 1;
+}
@@ -1,27 +1,39 @@
+#pragma once
+
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <string>
 #include <vector>
 
 #include "BDOS.h"
+#include "bios.h"
+#include "disk.h"
 #include "i8080.h"
 
 class Bus
 {
     public:
-        Bus();
+        // The CPU's timing is fixed for the life of the machine
+        Bus(i8080::Timing timing = i8080::CYCLE_EXACT);
         ~Bus();
 
     public:
         // Add CPU to bus
         i8080 cpu;
         BDOS bdos;
+        BIOS bios;
+        DiskSystem disks;
 
-        // Initialise RAM
-        std::array<uint8_t, 16*1024> ram;
+        // Initialise RAM, covering the full 16-bit address space
+        std::array<uint8_t, 64*1024> ram;
 
     public:
         // Interfaces between the CPU and the BDOS output
         void bdos_request(uint8_t C, uint8_t D, uint8_t E);
+
+        // Traps calls to 0005 to the host BDOS, as a new Bus does
+        void install_bdos_trap();
         
         // Read data from designated address on bus (from RAM)
         // If specified, start loading from address start_addr
@@ -29,5 +41,81 @@ class Bus
 
         // RAM access functions
         uint8_t read_from_ram(uint16_t addr);
+        uint8_t fetch_from_ram(uint16_t addr);  // Instruction bytes, never watched
         void write_to_ram(uint16_t addr, uint8_t data);
+
+        // Watchpoints stop the CPU once the instruction that read or
+        // wrote the range has run. Memory is flagged a 256 byte page at a
+        // time, so accesses to unwatched pages cost one table load and
+        // only those to watched pages search the watchpoints.
+        enum WatchKind : uint8_t { WATCH_READ = 1, WATCH_WRITE = 2, WATCH_ACCESS = 3 };
+        void add_watchpoint(uint16_t addr, uint16_t length, WatchKind kind);
+        bool remove_watchpoint(uint16_t addr, uint16_t length, WatchKind kind);
+        void clear_watchpoints();
+
+        // The access that stopped the CPU at the last watchpoint
+        struct WatchHit
+        {
+            uint16_t addr;
+            WatchKind kind;     // Of the watchpoint, not the access
+        };
+        WatchHit get_watch_hit();
+
+        // Memory is tracked in 256 byte pages
+        static const int PAGE_SHIFT = 8;
+        static const int PAGE_SIZE = 1 << PAGE_SHIFT;
+        static const int PAGE_COUNT = (64*1024) >> PAGE_SHIFT;
+
+        // Dirty pages, a byte per page set by every write since the last
+        // clear, checkpoint or revert. Code that writes ram directly marks
+        // what it wrote.
+        void mark_dirty(uint16_t addr, uint32_t length);
+        bool is_page_dirty(int page) { return dirty_pages[page]; }
+        int count_dirty_pages();
+        void clear_dirty_pages();
+
+        // Copies the dirty pages back from image, 64K taken when the pages
+        // were last cleared, so a reset costs what the run wrote
+        void revert_dirty_pages(const uint8_t * image);
+
+        // Save states (savestate.h). Saving writes the whole machine with
+        // one write, loading maps the file and replaces the machine with
+        // it. Both return false and describe the problem in error if the
+        // file can't be written or read; a state that fails to load part
+        // way leaves the machine in between.
+        //
+        // Each save or load is a checkpoint. A delta state holds only the
+        // RAM pages written since the last one, and loads only over that
+        // checkpoint, so a base state and its deltas load in turn.
+        bool save_state(const std::string & path, bool delta, std::string & error);
+        bool load_state(const std::string & path, std::string & error);
+
+        // The same in memory, for checkpoints that don't go to a file
+        bool save_state(std::vector<uint8_t> & state, bool delta, std::string & error);
+        bool load_state(const uint8_t * data, size_t size, std::string & error);
+
+    private:
+        // Access kinds watched in each page, and KEEP_PAGE on pages whose
+        // contents go to kept_pages before their next write
+        static const uint8_t KEEP_PAGE = 4;
+        std::array<uint8_t, PAGE_COUNT> page_flags;
+        std::array<uint8_t, PAGE_COUNT> dirty_pages;
+        std::vector<uint8_t> kept_pages;
+
+        // Identifies the last checkpoint, 0 if RAM matches no saved state
+        uint64_t checkpoint = 0;
+
+        struct Watchpoint
+        {
+            uint16_t addr;
+            uint16_t length;
+            WatchKind kind;
+        };
+        std::vector<Watchpoint> watchpoints;
+        WatchHit watch_hit = {};
+
+        void update_page_flags();
+        void check_watch(uint16_t addr, WatchKind access);
+        void before_write(uint16_t addr);
+        bool load_state(const uint8_t * data, size_t size, const std::string & name, std::string & error);
 };
\ No newline at end of file
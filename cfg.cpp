@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "cfg.h"
+
+ControlFlowGraph::ControlFlowGraph(const uint8_t * code, size_t size, uint32_t base)
+    : code(code), size(size), base(base), flags(new std::atomic<uint8_t>[size])
+{
+    for(size_t i=0; i!=size; ++i) flags[i] = 0;
+}
+
+ControlFlowGraph::~ControlFlowGraph() {}
+
+bool ControlFlowGraph::contains(uint32_t addr)
+{
+    return addr >= base && addr - base < size;
+}
+
+void ControlFlowGraph::add_entry(uint32_t addr)
+{
+    if(!contains(addr)) return;
+
+    flags[addr - base] |= ENTRY | LEADER;
+    entries.push_back(addr);
+}
+
+void ControlFlowGraph::add_default_entries()
+{
+    add_entry(0x0000);
+    add_entry(0x0100);
+    for(uint32_t rst=0x08; rst!=0x40; rst+=0x08) add_entry(rst);
+}
+
+void ControlFlowGraph::build(unsigned threads)
+{
+    if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Work queue shared by the workers. The traversal is finished once
+    // the queue is empty and no worker can add to it.
+    std::mutex lock;
+    std::condition_variable more_work;
+    std::vector<uint32_t> queue(entries);
+    unsigned busy = 0;
+
+    auto worker = [&]()
+    {
+        std::vector<uint32_t> work;
+        std::vector<Xref> found;
+        std::vector<uint32_t> clashes;
+
+        std::unique_lock<std::mutex> guard(lock);
+        for(;;)
+        {
+            more_work.wait(guard, [&] { return !queue.empty() || busy == 0; });
+            if(queue.empty()) break;
+
+            uint32_t addr = queue.back();
+            queue.pop_back();
+            busy++;
+            guard.unlock();
+
+            work.clear();
+            trace_run(addr, work, found, clashes);
+
+            guard.lock();
+            busy--;
+            queue.insert(queue.end(), work.begin(), work.end());
+            more_work.notify_all();
+        }
+
+        xrefs.insert(xrefs.end(), found.begin(), found.end());
+        conflicts.insert(conflicts.end(), clashes.begin(), clashes.end());
+    };
+
+    std::vector<std::thread> pool;
+    for(unsigned i=1; i<threads; ++i) pool.emplace_back(worker);
+    worker();
+    for(auto & t: pool) t.join();
+
+    std::sort(xrefs.begin(), xrefs.end(), [](const Xref & a, const Xref & b)
+    {
+        return (a.to != b.to) ? a.to < b.to : a.from < b.from;
+    });
+    std::sort(conflicts.begin(), conflicts.end());
+
+    split_blocks();
+}
+
+void ControlFlowGraph::trace_run(uint32_t addr, std::vector<uint32_t> & work,
+                                 std::vector<Xref> & found, std::vector<uint32_t> & clashes)
+{
+    while(contains(addr))
+    {
+        size_t offset = addr - base;
+
+        // Claim the instruction, stop where another run has been
+        uint8_t prev = flags[offset].fetch_or(START);
+        if(prev & START) return;
+        if(prev & OPERAND) clashes.push_back(addr);
+
+        DecodedOp op = decode_op(code, size, offset, base);
+        for(uint8_t i=1; i<op.length; ++i)
+        {
+            if(flags[offset + i].fetch_or(OPERAND) & START) clashes.push_back(addr + i);
+        }
+
+        uint32_t target;
+        if(flow_target(op, target))
+        {
+            found.push_back({addr, target, op.flow});
+            if(contains(target))
+            {
+                uint8_t seen = flags[target - base].fetch_or(LEADER | TARGET);
+                if(!(seen & START)) work.push_back(target);
+            }
+        }
+
+        addr += op.length;
+        switch(op.flow)
+        {
+            case FLOW_NONE:
+                break;
+
+            case FLOW_JUMP:
+            case FLOW_JUMP_INDIRECT:
+            case FLOW_RETURN:
+            case FLOW_HALT:
+                return;
+
+            // Conditional flow, calls and RSTs carry on into a new block
+            default:
+                if(contains(addr)) flags[addr - base] |= LEADER;
+                break;
+        }
+    }
+}
+
+void ControlFlowGraph::split_blocks()
+{
+    blocks.clear();
+
+    size_t offset = 0;
+    while(offset < size)
+    {
+        if(!(flags[offset] & START))
+        {
+            offset++;
+            continue;
+        }
+
+        BasicBlock block;
+        block.start = base + offset;
+
+        // A block runs until a flow instruction, the next leader or data
+        DecodedOp op;
+        for(;;)
+        {
+            op = decode_op(code, size, offset, base);
+            offset += op.length;
+
+            if(op.flow != FLOW_NONE || offset >= size) break;
+            if(!(flags[offset] & START) || (flags[offset] & LEADER)) break;
+        }
+        block.end = base + offset;
+
+        uint32_t target;
+        if(flow_target(op, target) && contains(target)) block.successors.push_back(target);
+
+        bool falls_through = op.flow != FLOW_JUMP && op.flow != FLOW_JUMP_INDIRECT
+                          && op.flow != FLOW_RETURN && op.flow != FLOW_HALT;
+        if(falls_through && offset < size && (flags[offset] & START))
+        {
+            block.successors.push_back(base + offset);
+        }
+
+        blocks[block.start] = block;
+    }
+}
+
+const std::map<uint32_t, BasicBlock> & ControlFlowGraph::get_blocks()
+{
+    return blocks;
+}
+
+const std::vector<Xref> & ControlFlowGraph::get_xrefs()
+{
+    return xrefs;
+}
+
+const std::vector<uint32_t> & ControlFlowGraph::get_conflicts()
+{
+    return conflicts;
+}
+
+bool ControlFlowGraph::is_code(uint32_t addr)
+{
+    return contains(addr) && (flags[addr - base] & (START | OPERAND));
+}
+
+bool ControlFlowGraph::is_instruction(uint32_t addr)
+{
+    return contains(addr) && (flags[addr - base] & START);
+}
+
+std::string ControlFlowGraph::label(uint32_t addr)
+{
+    if(!contains(addr) || !(flags[addr - base] & (ENTRY | TARGET))) return "";
+
+    char text[16];
+    snprintf(text, sizeof(text), "L%04X", addr);
+    return text;
+}
+
+size_t ControlFlowGraph::write_listing(FILE * out)
+{
+    static const size_t FLUSH_AT = 1 << 20;
+    std::string text;
+    size_t written = 0;
+    char line[DISASM_LINE_MAX + 64];
+
+    auto emit = [&](const char * data, size_t length)
+    {
+        text.append(data, length);
+        if(text.size() >= FLUSH_AT)
+        {
+            fwrite(text.data(), 1, text.size(), out);
+            written += text.size();
+            text.clear();
+        }
+    };
+
+    int n = snprintf(line, sizeof(line), "; %zu blocks, %zu xrefs, %zu conflicts\n",
+                     blocks.size(), xrefs.size(), conflicts.size());
+    emit(line, n);
+    for(uint32_t addr: conflicts)
+    {
+        n = snprintf(line, sizeof(line), "; overlapping instruction at %04X\n", addr);
+        emit(line, n);
+    }
+
+    auto xref = xrefs.begin();
+    size_t offset = 0;
+    while(offset < size)
+    {
+        uint32_t addr = base + offset;
+        uint8_t f = flags[offset];
+
+        if(!(f & START))
+        {
+            // Data, up to 8 bytes a line
+            n = snprintf(line, sizeof(line), "%04X DB   ", addr);
+            size_t count = 0;
+            while(offset < size && count != 8 && !(flags[offset] & START))
+            {
+                n += snprintf(line + n, sizeof(line) - n, count ? ",$%02x" : "$%02x", code[offset]);
+                offset++;
+                count++;
+            }
+            line[n++] = '\n';
+            emit(line, n);
+            continue;
+        }
+
+        if(f & (ENTRY | TARGET))
+        {
+            n = snprintf(line, sizeof(line), "\nL%04X:", addr);
+            emit(line, n);
+
+            while(xref != xrefs.end() && xref->to < addr) ++xref;
+            for(int shown=0; xref != xrefs.end() && xref->to == addr; ++xref, ++shown)
+            {
+                if(shown > 8) continue;
+                if(shown == 8) n = snprintf(line, sizeof(line), " ...");
+                else n = snprintf(line, sizeof(line), shown ? ", %04X" : "\t; xref %04X", xref->from);
+                emit(line, n);
+            }
+            emit("\n", 1);
+        }
+
+        DecodedOp op = decode_op(code, size, offset, base);
+        n = format_op(op, code + offset, line);
+        emit(line, n);
+        offset += op.length;
+    }
+
+    fwrite(text.data(), 1, text.size(), out);
+    return written + text.size();
+}
@@ -0,0 +1,106 @@
+/*
+Recursive traversal disassembly. Starting from entry points, decoding
+follows jumps, calls and RSTs rather than sweeping linearly, so data
+mixed into a ROM never throws the instruction boundaries out. The result
+is a control flow graph of basic blocks with cross references, which the
+listing turns into labelled assembly with the data left as DB lines.
+
+The traversal runs on a shared work queue. Each worker claims bytes with
+atomic flags, so independent regions decode in parallel and a region
+reached from two places is only decoded once.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "disasm.h"
+
+// A flow of control from one instruction to an address
+struct Xref
+{
+    uint32_t from;
+    uint32_t to;
+    FlowKind kind;
+};
+
+struct BasicBlock
+{
+    uint32_t start;
+    uint32_t end;                       // One past the last instruction
+    std::vector<uint32_t> successors;   // Targets and fall through in the code
+};
+
+class ControlFlowGraph
+{
+    public:
+        // The code is read in place and must outlive the graph.
+        // base is the address of code[0].
+        ControlFlowGraph(const uint8_t * code, size_t size, uint32_t base = 0);
+        ~ControlFlowGraph();
+
+        // Entry points, addresses outside the code are ignored
+        void add_entry(uint32_t addr);
+
+        // 0000, 0100 and the RST vectors, where they lie in the code
+        void add_default_entries();
+
+        // Traverses from the entries and splits the code into blocks.
+        // threads==0 uses every hardware thread.
+        void build(unsigned threads = 0);
+
+        const std::map<uint32_t, BasicBlock> & get_blocks();
+
+        // Sorted by target address
+        const std::vector<Xref> & get_xrefs();
+
+        // Instructions decoded over the middle of another instruction
+        const std::vector<uint32_t> & get_conflicts();
+
+        bool is_code(uint32_t addr);
+        bool is_instruction(uint32_t addr);
+
+        // Label for an address, e.g. L0100, or "" if nothing refers to it
+        std::string label(uint32_t addr);
+
+        // Writes the listing: labels with their xrefs, code lines and
+        // data bytes. Returns the number of characters written.
+        size_t write_listing(FILE * out);
+
+    private:
+        const uint8_t * code;
+        size_t size;
+        uint32_t base;
+
+        // Per byte flags, set by the traversal workers
+        enum BYTE_FLAGS : uint8_t
+        {
+            START = 1 << 0,     // First byte of an instruction
+            OPERAND = 1 << 1,   // Later byte of an instruction
+            LEADER = 1 << 2,    // Starts a basic block
+            ENTRY = 1 << 3,     // Given entry point
+            TARGET = 1 << 4     // Referred to by a flow instruction
+        };
+        std::unique_ptr<std::atomic<uint8_t>[]> flags;
+
+        std::vector<uint32_t> entries;
+        std::map<uint32_t, BasicBlock> blocks;
+        std::vector<Xref> xrefs;
+        std::vector<uint32_t> conflicts;
+
+        bool contains(uint32_t addr);
+
+        // Decodes one straight line run from addr, pushing new work
+        // and collecting xrefs and conflicts
+        void trace_run(uint32_t addr, std::vector<uint32_t> & work,
+                       std::vector<Xref> & found, std::vector<uint32_t> & clashes);
+
+        void split_blocks();
+};
@@ -0,0 +1,454 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+
+#include "bus.h"
+#include "condition.h"
+
+// PARSING ====================================
+
+namespace
+{
+    // Expression tree, only kept while compiling
+    struct Node
+    {
+        Condition::OpCode op;
+        uint64_t arg;
+        int left;
+        int right;
+    };
+
+    struct Parser
+    {
+        const std::string & text;
+        size_t pos = 0;
+        std::vector<Node> nodes;
+        std::string error;
+
+        Parser(const std::string & text) : text(text) {}
+
+        int add(Condition::OpCode op, uint64_t arg = 0, int left = -1, int right = -1)
+        {
+            nodes.push_back({op, arg, left, right});
+            return nodes.size() - 1;
+        }
+
+        int fail(const std::string & message)
+        {
+            if(error.empty()) error = message + " at column " + std::to_string(pos + 1);
+            return -1;
+        }
+
+        void skip_space()
+        {
+            while(pos < text.size() && isspace((unsigned char)text[pos])) pos++;
+        }
+
+        // Consumes token if it comes next
+        bool accept(const char * token)
+        {
+            skip_space();
+            size_t n = strlen(token);
+            if(text.compare(pos, n, token) != 0) return 0;
+
+            // Keep '<' from matching the start of "<=", and so on
+            if(n == 1 && pos + 1 < text.size() && strchr("<>=!&|", token[0]) && text[pos + 1] == '=') return 0;
+            if(n == 1 && (token[0] == '&' || token[0] == '|') && pos + 1 < text.size() && text[pos + 1] == token[0]) return 0;
+
+            pos += n;
+            return 1;
+        }
+
+        std::string word()
+        {
+            skip_space();
+            size_t start = pos;
+            while(pos < text.size() && (isalnum((unsigned char)text[pos]) || text[pos] == '_')) pos++;
+            std::string w = text.substr(start, pos - start);
+            for(char & c: w) c = tolower((unsigned char)c);
+            return w;
+        }
+
+        int parse_or()
+        {
+            int left = parse_and();
+            while(left >= 0 && accept("||")) left = add(Condition::OP_OR, 0, left, parse_and());
+            return left;
+        }
+
+        int parse_and()
+        {
+            int left = parse_compare();
+            while(left >= 0 && accept("&&")) left = add(Condition::OP_AND, 0, left, parse_compare());
+            return left;
+        }
+
+        int parse_compare()
+        {
+            static const struct { const char * token; Condition::OpCode op; } ops[] =
+            {
+                {"==", Condition::OP_EQ}, {"!=", Condition::OP_NE},
+                {"<=", Condition::OP_LE}, {">=", Condition::OP_GE},
+                {"<",  Condition::OP_LT}, {">",  Condition::OP_GT},
+            };
+
+            int left = parse_bitand();
+            if(left < 0) return -1;
+            for(const auto & o: ops)
+            {
+                if(accept(o.token)) return add(o.op, 0, left, parse_bitand());
+            }
+            return left;
+        }
+
+        int parse_bitand()
+        {
+            int left = parse_unary();
+            while(left >= 0 && accept("&")) left = add(Condition::OP_BITAND, 0, left, parse_unary());
+            return left;
+        }
+
+        int parse_unary()
+        {
+            if(accept("!")) return add(Condition::OP_NOT, 0, parse_unary());
+            return parse_primary();
+        }
+
+        int parse_primary()
+        {
+            static const char * registers[] = {"a", "b", "c", "d", "e", "h", "l", "f", "bc", "de", "hl", "sp", "pc"};
+
+            if(accept("("))
+            {
+                int inner = parse_or();
+                if(inner >= 0 && !accept(")")) return fail("expected ')'");
+                return inner;
+            }
+
+            skip_space();
+            if(pos < text.size() && isdigit((unsigned char)text[pos]))
+            {
+                // 0x is hex, anything else decimal, so 0100 isn't octal
+                bool hex = text.compare(pos, 2, "0x") == 0 || text.compare(pos, 2, "0X") == 0;
+                size_t used = 0;
+                uint64_t value;
+                try
+                {
+                    value = std::stoull(text.substr(pos + (hex ? 2 : 0)), &used, hex ? 16 : 10);
+                    if(hex) used += 2;
+                }
+                catch(...)
+                {
+                    return fail("bad number");
+                }
+                pos += used;
+                return add(Condition::OP_CONST, value);
+            }
+
+            size_t start = pos;
+            std::string w = word();
+            if(w.empty()) return fail("expected a value");
+
+            for(size_t r=0; r!=sizeof(registers)/sizeof(registers[0]); ++r)
+            {
+                if(w == registers[r]) return add(Condition::OP_REG, r);
+            }
+            if(w == "cycles") return add(Condition::OP_CYCLES);
+
+            if(w == "mem" || w == "memory")
+            {
+                if(!accept("[")) return fail("expected '['");
+                int addr = parse_or();
+                if(addr < 0) return -1;
+                if(!accept("]")) return fail("expected ']'");
+
+                size_t after = pos;
+                if(word() == "changed")
+                {
+                    if(nodes[addr].op != Condition::OP_CONST) return fail("changed needs a constant address");
+                    return add(Condition::OP_CHANGED, nodes[addr].arg & 0xFFFF);
+                }
+                pos = after;
+                return add(Condition::OP_MEM, 0, addr);
+            }
+
+            pos = start;
+            return fail("unknown name '" + w + "'");
+        }
+    };
+
+    bool is_const(const std::vector<Node> & nodes, int n, uint64_t & value)
+    {
+        if(nodes[n].op != Condition::OP_CONST) return 0;
+        value = nodes[n].arg;
+        return 1;
+    }
+}
+
+// COMPILING ==================================
+
+bool Condition::compile(const std::string & text, std::string & error)
+{
+    code.clear();
+    watched.clear();
+    watch_anchors.clear();
+    pc_anchor = 0;
+    min_cycles = 0;
+
+    Parser parser(text);
+    int root = parser.parse_or();
+    parser.skip_space();
+    if(root >= 0 && parser.pos != text.size()) parser.fail("unexpected text");
+    if(!parser.error.empty())
+    {
+        error = parser.error;
+        return 0;
+    }
+    const std::vector<Node> & nodes = parser.nodes;
+
+    // The top level && terms say where the condition can become true
+    std::vector<int> terms = {root};
+    while(!terms.empty())
+    {
+        int n = terms.back();
+        terms.pop_back();
+        const Node & node = nodes[n];
+
+        uint64_t k;
+        if(node.op == OP_AND)
+        {
+            terms.push_back(node.left);
+            terms.push_back(node.right);
+        }
+        else if(node.op == OP_EQ && !pc_anchor)
+        {
+            const Node & l = nodes[node.left];
+            const Node & r = nodes[node.right];
+            if(l.op == OP_REG && l.arg == REG_PC && is_const(nodes, node.right, k)) pc_anchor = 1;
+            else if(r.op == OP_REG && r.arg == REG_PC && is_const(nodes, node.left, k)) pc_anchor = 1;
+            if(pc_anchor) pc_anchor_addr = k;
+        }
+        else if(node.op == OP_CHANGED)
+        {
+            if(std::find(watch_anchors.begin(), watch_anchors.end(), node.arg) == watch_anchors.end())
+            {
+                watch_anchors.push_back(node.arg);
+            }
+        }
+        else if((node.op == OP_GE || node.op == OP_GT) && nodes[node.left].op == OP_CYCLES
+                && is_const(nodes, node.right, k))
+        {
+            min_cycles = std::max(min_cycles, k + (node.op == OP_GT));
+        }
+    }
+
+    // Post order, so each operator finds its operands on the stack
+    size_t depth = 0;
+    stack_depth = 0;
+    std::vector<std::pair<int, bool>> pending = {{root, 0}};
+    while(!pending.empty())
+    {
+        auto item = pending.back();
+        pending.pop_back();
+        const Node & node = nodes[item.first];
+
+        if(!item.second)
+        {
+            pending.push_back({item.first, 1});
+            if(node.right >= 0) pending.push_back({node.right, 0});
+            if(node.left >= 0) pending.push_back({node.left, 0});
+            continue;
+        }
+
+        Op op = {node.op, node.arg};
+        if(node.op == OP_CHANGED)
+        {
+            auto found = std::find(watched.begin(), watched.end(), node.arg);
+            op.arg = found - watched.begin();
+            if(found == watched.end()) watched.push_back(node.arg);
+        }
+        code.push_back(op);
+
+        if(node.left < 0) depth++;
+        else if(node.right >= 0) depth--;
+        stack_depth = std::max(stack_depth, depth);
+    }
+
+    if(stack_depth > MAX_DEPTH)
+    {
+        error = "expression nested too deeply";
+        code.clear();
+        return 0;
+    }
+
+    watched_values.assign(watched.size(), 0);
+    return 1;
+}
+
+void Condition::snapshot(const Bus & bus)
+{
+    for(size_t i=0; i!=watched.size(); ++i) watched_values[i] = bus.ram[watched[i]];
+}
+
+bool Condition::has_pc_anchor() const
+{
+    return pc_anchor;
+}
+
+uint16_t Condition::get_pc_anchor() const
+{
+    return pc_anchor_addr;
+}
+
+const std::vector<uint16_t> & Condition::get_watched() const
+{
+    return watch_anchors;
+}
+
+uint64_t Condition::get_min_cycles() const
+{
+    return min_cycles;
+}
+
+// EVALUATION =================================
+
+bool Condition::eval(const Bus & bus, uint64_t cycles) const
+{
+    const i8080 & cpu = bus.cpu;
+    std::array<uint64_t, MAX_DEPTH> stack;
+    size_t top = 0;
+
+    for(const Op & op: code)
+    {
+        // Binary operators pop b and replace a with the result
+        uint64_t b = 0;
+        if(op.code >= OP_EQ && op.code != OP_NOT) b = stack[--top];
+        uint64_t & a = stack[top ? top - 1 : 0];
+
+        switch(op.code)
+        {
+            case OP_CONST:   stack[top++] = op.arg; break;
+            case OP_CYCLES:  stack[top++] = cycles; break;
+            case OP_CHANGED: stack[top++] = bus.ram[watched[op.arg]] != watched_values[op.arg]; break;
+            case OP_MEM:     a = bus.ram[a & 0xFFFF]; break;
+            case OP_NOT:     a = !a; break;
+
+            case OP_REG:
+            {
+                uint64_t v = 0;
+                switch(op.arg)
+                {
+                    case REG_A:  v = cpu.A; break;
+                    case REG_B:  v = cpu.B; break;
+                    case REG_C:  v = cpu.C; break;
+                    case REG_D:  v = cpu.D; break;
+                    case REG_E:  v = cpu.E; break;
+                    case REG_H:  v = cpu.H; break;
+                    case REG_L:  v = cpu.L; break;
+                    case REG_F:  v = cpu.status; break;
+                    case REG_BC: v = (cpu.B << 8) | cpu.C; break;
+                    case REG_DE: v = (cpu.D << 8) | cpu.E; break;
+                    case REG_HL: v = (cpu.H << 8) | cpu.L; break;
+                    case REG_SP: v = cpu.SP; break;
+                    case REG_PC: v = cpu.PC; break;
+                }
+                stack[top++] = v;
+                break;
+            }
+
+            case OP_EQ:      a = a == b; break;
+            case OP_NE:      a = a != b; break;
+            case OP_LT:      a = a <  b; break;
+            case OP_LE:      a = a <= b; break;
+            case OP_GT:      a = a >  b; break;
+            case OP_GE:      a = a >= b; break;
+            case OP_BITAND:  a = a &  b; break;
+            case OP_AND:     a = a && b; break;
+            case OP_OR:      a = a || b; break;
+        }
+    }
+    return top && stack[0];
+}
+
+bool Condition::any_changed(const Bus & bus) const
+{
+    for(size_t i=0; i!=watched.size(); ++i)
+    {
+        bool anchor = std::count(watch_anchors.begin(), watch_anchors.end(), watched[i]);
+        if(anchor && bus.ram[watched[i]] != watched_values[i]) return 1;
+    }
+    return 0;
+}
+
+// RUNNING ====================================
+
+RunUntil run_until(Bus & bus, Condition & condition, uint64_t & cycles, uint64_t max_cycles)
+{
+    i8080 & cpu = bus.cpu;
+    cycles = 0;
+    condition.snapshot(bus);
+    if(condition.eval(bus, 0)) return RUN_UNTIL_MET;
+
+    // Stop points of the run's own, the host's are left alone
+    bool anchored = condition.has_pc_anchor();
+    uint16_t anchor = condition.get_pc_anchor();
+    bool own_breakpoint = anchored && !cpu.has_breakpoint(anchor);
+    if(own_breakpoint) cpu.set_breakpoint(anchor);
+
+    const std::vector<uint16_t> & watched = condition.get_watched();
+    bool watching = !anchored && !watched.empty();
+    for(uint16_t addr: watched) if(watching) bus.add_watchpoint(addr, 1, Bus::WATCH_WRITE);
+
+    bool every_step = !anchored && watched.empty();
+    uint64_t min_cycles = condition.get_min_cycles();
+    uint64_t limit = max_cycles ? max_cycles : UINT64_MAX;
+
+    if(cpu.get_debug_stop() != i8080::DEBUG_NONE) cpu.resume();
+
+    RunUntil result = cpu.is_stopped() ? RUN_UNTIL_STOPPED : RUN_UNTIL_LIMIT;
+    while(result == RUN_UNTIL_LIMIT && cycles < limit)
+    {
+        cycles += cpu.step();
+
+        if(cpu.is_stopped())
+        {
+            i8080::DebugStop why = cpu.get_debug_stop();
+            bool ours = (why == i8080::DEBUG_BREAKPOINT && anchored && cpu.PC == anchor)
+                     || (why == i8080::DEBUG_WATCHPOINT && watching
+                         && std::count(watched.begin(), watched.end(), bus.get_watch_hit().addr));
+            if(!ours)
+            {
+                result = RUN_UNTIL_STOPPED;
+                break;
+            }
+
+            cpu.resume();
+            if(cycles >= min_cycles && condition.eval(bus, cycles))
+            {
+                result = RUN_UNTIL_MET;
+                break;
+            }
+
+            // Once a watched byte has changed the other terms can come
+            // true anywhere
+            if(watching && condition.any_changed(bus))
+            {
+                for(uint16_t addr: watched) bus.remove_watchpoint(addr, 1, Bus::WATCH_WRITE);
+                watching = 0;
+                every_step = 1;
+            }
+            continue;
+        }
+
+        if(every_step && cycles >= min_cycles && condition.eval(bus, cycles))
+        {
+            result = RUN_UNTIL_MET;
+            break;
+        }
+    }
+
+    if(own_breakpoint) cpu.clear_breakpoint(anchor);
+    for(uint16_t addr: watched) if(watching) bus.remove_watchpoint(addr, 1, Bus::WATCH_WRITE);
+    return result;
+}
@@ -0,0 +1,96 @@
+/*
+Conditions to run the guest until, compiled once from text such as
+
+    PC == 0x059C && A == 0
+    mem[0x2400] changed
+    cycles >= 2000000 && (F & 0x40) != 0
+
+into bytecode for a small stack machine. Registers are A B C D E H L F,
+the pairs BC DE HL SP PC, and cycles, counted from the start of the run.
+mem[addr] reads a byte and mem[addr] changed is true once the byte at a
+constant address differs from its value when the run started. Numbers
+are decimal, so 0100 is one hundred, or 0x hex. Operators, loosest
+first: || && comparisons & !
+
+run_until() only evaluates the condition where it can first become true,
+judged from its top level && terms:
+    PC == n             at a breakpoint on n, before the instruction runs
+    mem[n] changed      after writes to n, through a write watchpoint,
+                        and after every instruction once one has changed
+    cycles >= n         not at all until n cycles have run
+and otherwise after every instruction.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Bus;
+
+class Condition
+{
+    public:
+        // Returns false and describes the problem in error if text doesn't
+        // parse
+        bool compile(const std::string & text, std::string & error);
+
+        // Records the bytes 'changed' compares against
+        void snapshot(const Bus & bus);
+
+        bool eval(const Bus & bus, uint64_t cycles) const;
+
+        // Whether any byte a top level 'changed' term watches differs now
+        bool any_changed(const Bus & bus) const;
+
+        // Found from the top level && terms when compiling
+        bool has_pc_anchor() const;
+        uint16_t get_pc_anchor() const;
+        const std::vector<uint16_t> & get_watched() const;
+        uint64_t get_min_cycles() const;
+
+        enum OpCode : uint8_t
+        {
+            OP_CONST, OP_REG, OP_MEM, OP_CHANGED, OP_CYCLES,
+            OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE,
+            OP_BITAND, OP_NOT, OP_AND, OP_OR
+        };
+
+        enum Register : uint8_t
+        {
+            REG_A, REG_B, REG_C, REG_D, REG_E, REG_H, REG_L, REG_F,
+            REG_BC, REG_DE, REG_HL, REG_SP, REG_PC
+        };
+
+        struct Op
+        {
+            OpCode code;
+            uint64_t arg;       // Constant, register or watched byte index
+        };
+
+    private:
+        static const size_t MAX_DEPTH = 32;
+
+        std::vector<Op> code;
+        size_t stack_depth = 0;
+
+        bool pc_anchor = 0;
+        uint16_t pc_anchor_addr = 0;
+        std::vector<uint16_t> watched;          // Every 'changed' byte
+        std::vector<uint8_t> watched_values;
+        std::vector<uint16_t> watch_anchors;    // Those of top level terms
+        uint64_t min_cycles = 0;
+};
+
+enum RunUntil
+{
+    RUN_UNTIL_MET,          // The condition is true
+    RUN_UNTIL_STOPPED,      // The guest stopped first
+    RUN_UNTIL_LIMIT         // max_cycles ran first
+};
+
+// Steps the CPU until the condition holds, the CPU stops or max_cycles
+// have run, 0 meaning no limit. cycles returns the cycles run. The
+// breakpoint and watchpoints it sets are removed again.
+RunUntil run_until(Bus & bus, Condition & condition, uint64_t & cycles, uint64_t max_cycles = 0);
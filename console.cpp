@@ -0,0 +1,298 @@
+#include <cerrno>
+#include <chrono>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "console.h"
+
+// SINKS ======================================
+
+void StdoutSink::write(const char * data, size_t size)
+{
+    fwrite(data, 1, size, stdout);
+}
+
+void StdoutSink::flush()
+{
+    fflush(stdout);
+}
+
+FileSink::FileSink(const std::string & path)
+{
+    file = fopen(path.c_str(), "ab");
+}
+
+FileSink::~FileSink()
+{
+    if(file) fclose(file);
+}
+
+bool FileSink::is_open()
+{
+    return file != nullptr;
+}
+
+void FileSink::write(const char * data, size_t size)
+{
+    if(file) fwrite(data, 1, size, file);
+}
+
+void FileSink::flush()
+{
+    if(file) fflush(file);
+}
+
+CaptureSink::CaptureSink(size_t capacity) : capacity(capacity) {}
+
+void CaptureSink::write(const char * data, size_t size)
+{
+    size_t room = capacity - captured.size();
+    size_t kept = (size < room) ? size : room;
+
+    captured.append(data, kept);
+    dropped_bytes += size - kept;
+}
+
+const std::string & CaptureSink::text()
+{
+    return captured;
+}
+
+size_t CaptureSink::dropped()
+{
+    return dropped_bytes;
+}
+
+void CaptureSink::clear()
+{
+    captured.clear();
+    dropped_bytes = 0;
+}
+
+// CONSOLE ====================================
+
+ConsoleOutput::ConsoleOutput()
+    : owned_sink(new StdoutSink)
+{
+    sink = owned_sink.get();
+    buffer.reserve(buffer_size);
+}
+
+ConsoleOutput::~ConsoleOutput()
+{
+    flush();
+}
+
+void ConsoleOutput::set_sink(std::unique_ptr<ConsoleSink> new_sink)
+{
+    flush();
+    owned_sink = std::move(new_sink);
+    sink = owned_sink.get();
+}
+
+void ConsoleOutput::set_sink(ConsoleSink * new_sink)
+{
+    flush();
+    owned_sink.reset();
+    sink = new_sink;
+}
+
+void ConsoleOutput::put(char c)
+{
+    buffer.push_back(c);
+
+    if(buffer.size() >= buffer_size || (c=='\n' && policy==FLUSH_ON_NEWLINE))
+    {
+        flush();
+    }
+}
+
+void ConsoleOutput::write(const char * data, size_t size)
+{
+    for(size_t i=0; i!=size; ++i) put(data[i]);
+}
+
+// Hands everything buffered to the sink in one write
+void ConsoleOutput::flush()
+{
+    if(!sink) return;
+
+    if(!buffer.empty())
+    {
+        sink->write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+    sink->flush();
+}
+
+// INPUT ======================================
+
+ConsoleInput::ConsoleInput(size_t capacity)
+{
+    // Round up to a power of two so positions wrap with a mask
+    size_t size = 1;
+    while(size < capacity) size <<= 1;
+    ring.resize(size);
+    mask = size - 1;
+}
+
+ConsoleInput::~ConsoleInput()
+{
+    close();
+}
+
+void ConsoleInput::set_data(const uint8_t * new_data, size_t size)
+{
+    close();
+    data = new_data;
+    data_size = size;
+    data_pos = 0;
+}
+
+void ConsoleInput::set_script(const std::string & text)
+{
+    close();
+    script = text;
+    data = (const uint8_t *)script.data();
+    data_size = script.size();
+    data_pos = 0;
+}
+
+bool ConsoleInput::open_file(const std::string & path)
+{
+    close();
+    int file = ::open(path.c_str(), O_RDONLY);
+    if(file < 0) return 0;
+
+    start_reader(file, 1);
+    return 1;
+}
+
+void ConsoleInput::open_stdin()
+{
+    close();
+    start_reader(STDIN_FILENO, 0);
+}
+
+void ConsoleInput::close()
+{
+    if(reader.joinable())
+    {
+        stopping = 1;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            space_ready.notify_all();
+        }
+        reader.join();
+        stopping = 0;
+    }
+    if(owns_fd && fd >= 0) ::close(fd);
+    fd = -1;
+    owns_fd = 0;
+
+    head = 0;
+    tail = 0;
+    end_of_input = 1;
+    data = nullptr;
+    data_size = 0;
+    data_pos = 0;
+    script.clear();
+}
+
+bool ConsoleInput::ready()
+{
+    if(!reader.joinable()) return data_pos < data_size;
+
+    return head.load(std::memory_order_acquire) != tail.load(std::memory_order_relaxed);
+}
+
+int ConsoleInput::get()
+{
+    if(!reader.joinable())
+    {
+        return (data_pos < data_size) ? data[data_pos++] : -1;
+    }
+
+    size_t t = tail.load(std::memory_order_relaxed);
+    if(head.load(std::memory_order_acquire) == t) return -1;
+
+    uint8_t c = ring[t & mask];
+    tail.store(t + 1, std::memory_order_release);
+
+    // Wake the reader if it was waiting for room
+    if(reader_waiting)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        space_ready.notify_one();
+    }
+    return c;
+}
+
+int ConsoleInput::wait_get()
+{
+    int c = get();
+    if(c >= 0 || !reader.joinable()) return c;
+
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        data_ready.wait(guard, [this] { return head != tail || end_of_input; });
+    }
+    return get();
+}
+
+void ConsoleInput::start_reader(int new_fd, bool owned)
+{
+    fd = new_fd;
+    owns_fd = owned;
+    end_of_input = 0;
+    reader = std::thread(&ConsoleInput::read_loop, this);
+}
+
+// Moves whatever the source has into the ring. Polls with a timeout so
+// close() can stop the thread while stdin is idle.
+void ConsoleInput::read_loop()
+{
+    uint8_t chunk[512];
+
+    while(!stopping)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t room = ring.size() - (h - tail.load(std::memory_order_acquire));
+
+        if(room == 0)
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            reader_waiting = 1;
+            space_ready.wait_for(guard, std::chrono::milliseconds(50), [this]
+            {
+                return stopping || head - tail < ring.size();
+            });
+            reader_waiting = 0;
+            continue;
+        }
+
+        pollfd p = {fd, POLLIN, 0};
+        int ready = poll(&p, 1, 50);
+        if(ready == 0 || (ready < 0 && errno == EINTR)) continue;
+        if(ready < 0) break;
+
+        ssize_t n = ::read(fd, chunk, (room < sizeof(chunk)) ? room : sizeof(chunk));
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) break;
+
+        for(ssize_t i=0; i!=n; ++i) ring[(h + i) & mask] = chunk[i];
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            head.store(h + n, std::memory_order_release);
+        }
+        data_ready.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        end_of_input = 1;
+    }
+    data_ready.notify_all();
+}
@@ -0,0 +1,164 @@
+/*
+Console output for the BDOS. Characters are collected in a large buffer
+and handed to a pluggable sink only when the flush policy asks for it
+(buffer size, a newline for interactive use, an explicit flush() or
+destruction), so guest console output costs a byte append rather than an
+iostream call and flush per character.
+
+Console input comes from a ring buffer. A reader thread fills it from
+stdin or a file, while in-memory data and scripts are read in place.
+Status polls never block. A read with nothing buffered parks the calling
+thread on a condition variable until data or end of input arrives.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Destination of flushed console output
+class ConsoleSink
+{
+    public:
+        virtual ~ConsoleSink() {}
+        virtual void write(const char * data, size_t size) = 0;
+        virtual void flush() {}
+};
+
+// Standard output, one write per flush
+class StdoutSink : public ConsoleSink
+{
+    public:
+        void write(const char * data, size_t size) override;
+        void flush() override;
+};
+
+// Appends to a host file
+class FileSink : public ConsoleSink
+{
+    public:
+        FileSink(const std::string & path);
+        ~FileSink();
+        bool is_open();
+        void write(const char * data, size_t size) override;
+        void flush() override;
+
+    private:
+        FILE * file = nullptr;
+};
+
+// Keeps output in memory for batch and test jobs. Anything past the
+// capacity is dropped and counted rather than growing without bound.
+class CaptureSink : public ConsoleSink
+{
+    public:
+        CaptureSink(size_t capacity = 1 << 20);
+        void write(const char * data, size_t size) override;
+
+        const std::string & text();
+        size_t dropped();
+        void clear();
+
+    private:
+        std::string captured;
+        size_t capacity;
+        size_t dropped_bytes = 0;
+};
+
+// Discards everything
+class NullSink : public ConsoleSink
+{
+    public:
+        void write(const char *, size_t) override {}
+};
+
+class ConsoleOutput
+{
+    public:
+        ConsoleOutput();
+        ~ConsoleOutput();
+
+    public:
+        // When buffered output is passed to the sink, besides flush()
+        enum FLUSH_POLICY
+        {
+            FLUSH_ON_SIZE,      // Only when the buffer fills (batch runs)
+            FLUSH_ON_NEWLINE    // Also at every line feed (interactive runs)
+        };
+
+        FLUSH_POLICY policy = FLUSH_ON_SIZE;
+        size_t buffer_size = 64 * 1024;
+
+        // Replaces the sink, flushing anything pending to the old one.
+        // The console keeps a non-owning pointer when given a raw sink.
+        void set_sink(std::unique_ptr<ConsoleSink> new_sink);
+        void set_sink(ConsoleSink * new_sink);
+
+        void put(char c);
+        void write(const char * data, size_t size);
+        void flush();
+
+    private:
+        std::string buffer;
+        std::unique_ptr<ConsoleSink> owned_sink;
+        ConsoleSink * sink = nullptr;
+};
+
+class ConsoleInput
+{
+    public:
+        ConsoleInput(size_t capacity = 4096);
+        ~ConsoleInput();
+
+        // Input sources, each replaces the previous one. Data given to
+        // set_data is not copied and must outlive the run.
+        void set_data(const uint8_t * data, size_t size);
+        void set_script(const std::string & text);
+        bool open_file(const std::string & path);
+        void open_stdin();
+        void close();
+
+        // True if a character can be read without waiting
+        bool ready();
+
+        // Next character, or -1 if none is buffered
+        int get();
+
+        // Next character, parking until one arrives. -1 at end of input.
+        int wait_get();
+
+    private:
+        // In-memory source, read in place
+        const uint8_t * data = nullptr;
+        size_t data_size = 0;
+        size_t data_pos = 0;
+        std::string script;
+
+        // Single producer, single consumer ring filled by the reader thread
+        std::vector<uint8_t> ring;
+        size_t mask;
+        std::atomic<size_t> head{0};
+        std::atomic<size_t> tail{0};
+        std::atomic<bool> end_of_input{1};
+
+        // Reader thread state
+        std::thread reader;
+        int fd = -1;
+        bool owns_fd = 0;
+        std::atomic<bool> stopping{0};
+        std::atomic<bool> reader_waiting{0};
+        std::mutex lock;
+        std::condition_variable data_ready;
+        std::condition_variable space_ready;
+
+        void start_reader(int new_fd, bool owned);
+        void read_loop();
+};
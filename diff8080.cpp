@@ -0,0 +1,429 @@
+/*
+Differential tester, runs randomised instruction streams through the i8080
+core and the Ref8080 reference model side by side and reports the first
+divergence in registers, flags, cycles or memory. The core is built with
+cycle exact timing.
+
+Build:
+    g++ -O2 -pthread diff8080.cpp ref8080.cpp i8080.cpp opcodes.cpp profile.cpp trace.cpp mapfile.cpp bus.cpp BDOS.cpp bios.cpp console.cpp disk.cpp -o diff8080
+
+Usage: diff8080 [-t threads] [-v vectors] [-s seed] [-l length] [-b batch]
+                [-m flagmask] [-x op,op,...] [-k]
+    -t  worker threads (default: all cores)
+    -v  number of test vectors (default 10000000)
+    -s  seed, the same seed always produces the same vectors
+    -l  instructions per vector (default 4)
+    -b  vectors per memory check batch (default 256)
+    -m  flag bits to compare (default d5, all of S Z AC P CY)
+    -x  extra opcodes to leave out of the streams
+    -k  keep going after a divergence, resyncing the reference with the
+        core, and print a per-opcode summary
+
+Each batch starts from memory filled from its own seed, so a vector is
+reproducible from (seed, batch, length) regardless of the thread count.
+Registers are compared after every instruction. Memory is compared once
+per batch, and a mismatching batch is replayed vector by vector to find
+the first one that diverged.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bus.h"
+#include "ref8080.h"
+
+using namespace std;
+
+// Options shared by every shard
+struct DiffConfig
+{
+    uint64_t vectors = 10000000;
+    uint64_t seed = 0x8080;
+    unsigned length = 4;
+    unsigned batch = 256;
+    uint8_t flag_mask = Ref8080::FLAG_MASK;
+    bool keep_going = 0;
+    bool allowed[256] = {};
+};
+
+// Register state in a form both models can be compared through
+struct CpuState
+{
+    uint8_t A, B, C, D, E, H, L, F;
+    uint16_t SP, PC;
+};
+
+struct Divergence
+{
+    uint64_t vector_id = UINT64_MAX;
+    unsigned step = 0;
+    uint8_t opcode = 0;
+    string field;
+    CpuState before, core, ref;
+    vector<uint8_t> stream;
+};
+
+static uint64_t splitmix64(uint64_t & x)
+{
+    uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Instruction length from the opcode bit fields
+static unsigned op_length(uint8_t op)
+{
+    if((op & 0xCF) == 0x01) return 3;                                  // LXI
+    if(op==0x22 || op==0x2A || op==0x32 || op==0x3A) return 3;         // SHLD LHLD STA LDA
+    if((op & 0xC7) == 0xC2 || (op & 0xC7) == 0xC4) return 3;           // Jcc Ccc
+    if(op==0xC3 || op==0xCB || (op & 0xCF) == 0xCD) return 3;          // JMP CALL
+    if((op & 0xC7) == 0x06 || (op & 0xC7) == 0xC6) return 2;           // MVI, ALU immediate
+    if(op==0xD3 || op==0xDB) return 2;                                 // OUT IN
+    return 1;
+}
+
+static CpuState core_state(i8080 & cpu)
+{
+    return {cpu.A, cpu.B, cpu.C, cpu.D, cpu.E, cpu.H, cpu.L, cpu.status, cpu.SP, cpu.PC};
+}
+
+static CpuState ref_state(Ref8080 & ref)
+{
+    return {ref.A, ref.B, ref.C, ref.D, ref.E, ref.H, ref.L, ref.F, ref.SP, ref.PC};
+}
+
+// Name of the first field that differs, empty if the states agree
+static string compare(const CpuState & a, const CpuState & b, uint8_t flag_mask)
+{
+    if(a.PC != b.PC) return "PC";
+    if(a.SP != b.SP) return "SP";
+    if(a.A != b.A) return "A";
+    if(a.B != b.B) return "B";
+    if(a.C != b.C) return "C";
+    if(a.D != b.D) return "D";
+    if(a.E != b.E) return "E";
+    if(a.H != b.H) return "H";
+    if(a.L != b.L) return "L";
+
+    uint8_t diff = (a.F ^ b.F) & flag_mask;
+    if(diff & Ref8080::S)  return "flag S";
+    if(diff & Ref8080::Z)  return "flag Z";
+    if(diff & Ref8080::AC) return "flag AC";
+    if(diff & Ref8080::P)  return "flag P";
+    if(diff & Ref8080::CY) return "flag CY";
+    return "";
+}
+
+static string format_state(const CpuState & s)
+{
+    ostringstream out;
+    out << hex << setfill('0')
+        << "A:" << setw(2) << (int)s.A << " B:" << setw(2) << (int)s.B
+        << " C:" << setw(2) << (int)s.C << " D:" << setw(2) << (int)s.D
+        << " E:" << setw(2) << (int)s.E << " H:" << setw(2) << (int)s.H
+        << " L:" << setw(2) << (int)s.L << " F:" << setw(2) << (int)s.F
+        << " SP:" << setw(4) << s.SP << " PC:" << setw(4) << s.PC;
+    return out.str();
+}
+
+class DiffShard
+{
+    public:
+        DiffShard(const DiffConfig & config)
+            : config(config), bus(new Bus(i8080::CYCLE_EXACT)), ref_mem(new uint8_t[0x10000])
+        {
+            bus->cpu.trace = 0;
+            bus->bdos.output_enabled = 0;
+            ref.mem = ref_mem.get();
+
+            // Compare the bare cores, without the host BDOS at 0005
+            bus->cpu.clear_trap(0x0005);
+
+            for(int op=0; op!=256; ++op)
+            {
+                if(config.allowed[op]) allowed_ops.push_back(op);
+            }
+        }
+
+        // Runs one batch, returns true if every vector agreed. Divergences
+        // are added to found, only the first unless keep going is set, in
+        // which case the models are resynced and the batch carries on.
+        bool run_batch(uint64_t batch, vector<Divergence> & found)
+        {
+            uint64_t first = batch * config.batch;
+            uint64_t last = min<uint64_t>(first + config.batch, config.vectors);
+
+            fill_memory(batch);
+            if(!run_vectors(first, last, found, 0)) return 0;
+            if(memcmp(bus->ram.data(), ref_mem.get(), 0x10000) == 0) return found.empty();
+
+            // Something wrote memory differently, replay to find the vector
+            found.clear();
+            fill_memory(batch);
+            run_vectors(first, last, found, 1);
+            return 0;
+        }
+
+        // Brings the reference back in line with the core after a divergence
+        void resync()
+        {
+            i8080 & cpu = bus->cpu;
+            ref.A = cpu.A; ref.B = cpu.B; ref.C = cpu.C; ref.D = cpu.D;
+            ref.E = cpu.E; ref.H = cpu.H; ref.L = cpu.L; ref.F = cpu.status;
+            ref.SP = cpu.SP; ref.PC = cpu.PC;
+            memcpy(ref_mem.get(), bus->ram.data(), 0x10000);
+        }
+
+        uint64_t instructions = 0;
+        uint64_t vectors = 0;           // Run, replays aside
+
+    private:
+        const DiffConfig & config;
+        unique_ptr<Bus> bus;
+        unique_ptr<uint8_t[]> ref_mem;
+        Ref8080 ref;
+        vector<uint8_t> allowed_ops;
+
+        // False once a divergence ends the batch. Checking memory after
+        // every instruction is for replays, which aren't counted again.
+        bool run_vectors(uint64_t first, uint64_t last, vector<Divergence> & found, bool check_memory)
+        {
+            Divergence div;
+            for(uint64_t v=first; v!=last; ++v)
+            {
+                if(!check_memory) vectors++;
+                if(run_vector(v, div, check_memory)) continue;
+
+                found.push_back(div);
+                if(!config.keep_going) return 0;
+                resync();
+            }
+            return 1;
+        }
+
+        void fill_memory(uint64_t batch)
+        {
+            uint64_t x = config.seed ^ (batch * 0xD1B54A32D192ED03ull);
+            for(size_t i=0; i<0x10000; i+=8)
+            {
+                uint64_t r = splitmix64(x);
+                memcpy(&ref_mem[i], &r, 8);
+            }
+            memcpy(bus->ram.data(), ref_mem.get(), 0x10000);
+        }
+
+        bool run_vector(uint64_t v, Divergence & div, bool check_memory)
+        {
+            i8080 & cpu = bus->cpu;
+            uint64_t x = config.seed ^ (v * 0x9E3779B97F4A7C15ull) ^ 0x5bd1e995;
+            uint64_t r = splitmix64(x);
+
+            // Random registers, both models start identical
+            CpuState init;
+            init.A = r; init.B = r >> 8; init.C = r >> 16; init.D = r >> 24;
+            init.E = r >> 32; init.H = r >> 40; init.L = r >> 48;
+            init.F = ((r >> 56) & Ref8080::FLAG_MASK) | 0x02;
+            r = splitmix64(x);
+            init.SP = r;
+            init.PC = r >> 16;
+
+            // Random instruction stream at PC
+            vector<uint8_t> stream;
+            for(unsigned i=0; i!=config.length; ++i)
+            {
+                uint8_t op = allowed_ops[splitmix64(x) % allowed_ops.size()];
+                r = splitmix64(x);
+                stream.push_back(op);
+                for(unsigned b=1; b<op_length(op); ++b) stream.push_back(r >> (8*b));
+            }
+            for(size_t i=0; i!=stream.size(); ++i)
+            {
+                uint16_t addr = init.PC + i;
+                bus->ram[addr] = ref_mem[addr] = stream[i];
+            }
+
+            cpu.A = init.A; cpu.B = init.B; cpu.C = init.C; cpu.D = init.D;
+            cpu.E = init.E; cpu.H = init.H; cpu.L = init.L; cpu.status = init.F;
+            cpu.SP = init.SP; cpu.PC = init.PC;
+            ref.A = init.A; ref.B = init.B; ref.C = init.C; ref.D = init.D;
+            ref.E = init.E; ref.H = init.H; ref.L = init.L; ref.F = init.F;
+            ref.SP = init.SP; ref.PC = init.PC;
+
+            for(unsigned s=0; s!=config.length; ++s)
+            {
+                // Stop once flow leaves the generated stream for an unusable opcode
+                uint8_t op = ref_mem[ref.PC];
+                if(!config.allowed[op]) break;
+
+                CpuState before = ref_state(ref);
+                uint8_t core_cycles = cpu.step();
+                uint8_t ref_cycles = ref.step();
+                instructions++;
+
+                CpuState core_after = core_state(cpu);
+                CpuState ref_after = ref_state(ref);
+                string field = compare(core_after, ref_after, config.flag_mask);
+
+                if(field.empty() && core_cycles != ref_cycles)
+                {
+                    field = "cycles core:" + to_string(core_cycles) + " ref:" + to_string(ref_cycles);
+                }
+
+                if(field.empty() && check_memory
+                   && memcmp(bus->ram.data(), ref_mem.get(), 0x10000) != 0)
+                {
+                    size_t addr = 0;
+                    while(bus->ram[addr] == ref_mem[addr]) addr++;
+
+                    ostringstream out;
+                    out << "memory " << hex << setfill('0') << setw(4) << addr
+                        << " core:" << setw(2) << (int)bus->ram[addr]
+                        << " ref:" << setw(2) << (int)ref_mem[addr];
+                    field = out.str();
+                }
+
+                if(!field.empty())
+                {
+                    div.vector_id = v;
+                    div.step = s;
+                    div.opcode = op;
+                    div.field = field;
+                    div.before = before;
+                    div.core = core_after;
+                    div.ref = ref_after;
+                    div.stream = stream;
+                    return 0;
+                }
+            }
+            return 1;
+        }
+};
+
+static void print_divergence(const Divergence & div)
+{
+    cout << "Divergence in vector " << dec << div.vector_id << ", step " << div.step
+         << ", opcode 0x" << hex << setfill('0') << setw(2) << (int)div.opcode
+         << ": " << div.field << endl;
+    cout << "  stream:";
+    for(auto b: div.stream) cout << " " << setw(2) << (int)b;
+    cout << endl;
+    cout << "  before " << format_state(div.before) << endl;
+    cout << "  core   " << format_state(div.core) << endl;
+    cout << "  ref    " << format_state(div.ref) << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    DiffConfig config;
+    unsigned threads = max(1u, thread::hardware_concurrency());
+
+    // Only opcodes the core implements can be compared
+    {
+        Bus probe;
+        for(int op=0; op!=256; ++op) config.allowed[op] = probe.cpu.implemented(op);
+    }
+
+    for(int i=1; i<argc; ++i)
+    {
+        string arg = argv[i];
+        if(arg=="-t" && i+1<argc)       threads = max(1, stoi(argv[++i]));
+        else if(arg=="-v" && i+1<argc)  config.vectors = stoull(argv[++i]);
+        else if(arg=="-s" && i+1<argc)  config.seed = stoull(argv[++i], nullptr, 0);
+        else if(arg=="-l" && i+1<argc)  config.length = max(1, stoi(argv[++i]));
+        else if(arg=="-b" && i+1<argc)  config.batch = max(1, stoi(argv[++i]));
+        else if(arg=="-m" && i+1<argc)  config.flag_mask = stoi(argv[++i], nullptr, 16);
+        else if(arg=="-k")              config.keep_going = 1;
+        else if(arg=="-x" && i+1<argc)
+        {
+            stringstream ops(argv[++i]);
+            string op;
+            while(getline(ops, op, ',')) config.allowed[stoi(op, nullptr, 16) & 0xFF] = 0;
+        }
+        else
+        {
+            cerr << "Unknown option " << arg << endl;
+            return 1;
+        }
+    }
+
+    uint64_t batches = (config.vectors + config.batch - 1) / config.batch;
+    atomic<uint64_t> next_batch(0);
+    atomic<uint64_t> first_bad(UINT64_MAX);
+    atomic<uint64_t> instructions(0);
+    atomic<uint64_t> vectors_run(0);
+    mutex result_lock;
+    Divergence first;
+    uint64_t counts[256] = {};
+    uint64_t total_divergences = 0;
+
+    auto worker = [&]()
+    {
+        DiffShard shard(config);
+        vector<Divergence> found;
+
+        for(uint64_t b = next_batch++; b < batches; b = next_batch++)
+        {
+            // Later batches can't hold the first divergence any more
+            if(!config.keep_going && b * config.batch > first_bad) break;
+
+            found.clear();
+            if(shard.run_batch(b, found)) continue;
+
+            {
+                lock_guard<mutex> lock(result_lock);
+                for(const Divergence & div: found)
+                {
+                    if(div.vector_id < first.vector_id) first = div;
+                    counts[div.opcode]++;
+                    total_divergences++;
+                }
+            }
+
+            uint64_t seen = first_bad;
+            uint64_t id = found.empty() ? UINT64_MAX : found.front().vector_id;
+            while(id < seen && !first_bad.compare_exchange_weak(seen, id)) {}
+        }
+        instructions += shard.instructions;
+        vectors_run += shard.vectors;
+    };
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> pool;
+    for(unsigned t=0; t!=threads; ++t) pool.emplace_back(worker);
+    for(auto & t: pool) t.join();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    cout << dec << vectors_run << " vectors, " << instructions << " instructions in "
+         << elapsed.count() << "s on " << threads << " threads ("
+         << (uint64_t)(vectors_run / elapsed.count()) << " vectors/sec)" << endl;
+
+    if(first.vector_id == UINT64_MAX)
+    {
+        cout << "No divergences found" << endl;
+        return 0;
+    }
+
+    print_divergence(first);
+
+    if(config.keep_going)
+    {
+        cout << dec << total_divergences << " divergences, by opcode:" << endl;
+        for(int op=0; op!=256; ++op)
+        {
+            if(counts[op]) cout << "  0x" << hex << setfill('0') << setw(2) << op
+                                << "\t" << dec << counts[op] << endl;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,217 @@
+#include <cstring>
+
+#include "disasm.h"
+
+static const char hex_digits[] = "0123456789abcdef";
+static const char hex_upper[] = "0123456789ABCDEF";
+
+// Mnemonic and register text for an opcode, ready to copy, with the
+// separator before the numeric operand already in place
+struct OpcodeTemplate
+{
+    char text[16];
+    uint8_t size;
+};
+
+struct TemplateTable
+{
+    OpcodeTemplate ops[256];
+
+    TemplateTable()
+    {
+        for(int op=0; op!=256; ++op)
+        {
+            const OpcodeInfo & info = opcode_table[op];
+            OpcodeTemplate & t = ops[op];
+            size_t n = 0;
+
+            for(const char * c = mnemonic_names[info.mnemonic]; *c; ++c) t.text[n++] = *c;
+
+            bool has_registers = info.registers[0] != 0;
+            if(has_registers || info.format != OPERAND_NONE)
+            {
+                while(n < 5) t.text[n++] = ' ';
+            }
+            for(const char * c = info.registers; *c; ++c) t.text[n++] = *c;
+            if(has_registers && info.format != OPERAND_NONE) t.text[n++] = ',';
+
+            t.size = n;
+        }
+    }
+};
+
+static const TemplateTable & templates()
+{
+    static const TemplateTable table;
+    return table;
+}
+
+static inline char * put_byte(char * out, uint8_t val)
+{
+    out[0] = hex_digits[val >> 4];
+    out[1] = hex_digits[val & 0x0F];
+    return out + 2;
+}
+
+// Four digits like the original %04X, more only past 64K
+static inline char * put_addr(char * out, uint32_t addr)
+{
+    int digits = (addr > 0xFFFFFF) ? 8 : (addr > 0xFFFF) ? 6 : 4;
+    for(int i=digits-1; i>=0; --i) *out++ = hex_upper[(addr >> (4*i)) & 0x0F];
+    return out;
+}
+
+DecodedOp decode_op(const uint8_t * code, size_t size, size_t offset, uint32_t base)
+{
+    const uint8_t * bytes = code + offset;
+    const OpcodeInfo & info = opcode_table[bytes[0]];
+
+    DecodedOp op;
+    op.addr = base + offset;
+    op.opcode = bytes[0];
+    op.length = info.length;
+    op.mnemonic = info.mnemonic;
+    op.flow = info.flow;
+    op.operand = 0;
+
+    if(offset + info.length > size)
+    {
+        // Not enough bytes left for the operands
+        op.length = 1;
+        op.mnemonic = MN_DB;
+        op.flow = FLOW_NONE;
+    }
+    else if(info.length == 2)
+    {
+        op.operand = bytes[1];
+    }
+    else if(info.length == 3)
+    {
+        op.operand = (bytes[2]<<8) | bytes[1];
+    }
+    return op;
+}
+
+size_t decode_range(const uint8_t * code, size_t size, size_t offset, size_t end,
+                    uint32_t base, std::vector<DecodedOp> & out)
+{
+    if(end > size) end = size;
+    while(offset < end)
+    {
+        out.push_back(decode_op(code, size, offset, base));
+        offset += out.back().length;
+    }
+    return offset;
+}
+
+bool flow_target(const DecodedOp & op, uint32_t & target)
+{
+    switch(op.flow)
+    {
+        case FLOW_JUMP:
+        case FLOW_JUMP_COND:
+        case FLOW_CALL:
+        case FLOW_CALL_COND:
+            target = op.operand;
+            return 1;
+        case FLOW_RESTART:
+            target = op.opcode & 0x38;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static inline char * put_word(char * out, uint16_t val)
+{
+    return put_byte(put_byte(out, val >> 8), val & 0xFF);
+}
+
+// The numeric operand, if the opcode has one
+static inline char * put_operand(char * p, const DecodedOp & op)
+{
+    switch(opcode_table[op.opcode].format)
+    {
+        case OPERAND_NONE:
+            break;
+        case OPERAND_D8:
+        case OPERAND_PORT:
+            *p++ = '#'; *p++ = '$';
+            p = put_byte(p, op.operand);
+            break;
+        case OPERAND_D16:
+            *p++ = '#'; *p++ = '$';
+            p = put_word(p, op.operand);
+            break;
+        case OPERAND_ADDR:
+            *p++ = '$';
+            p = put_word(p, op.operand);
+            break;
+    }
+    return p;
+}
+
+size_t format_op(const DecodedOp & op, const uint8_t * bytes, char * out)
+{
+    char * p = put_addr(out, op.addr);
+    *p++ = ' ';
+
+    if(op.mnemonic == MN_DB)
+    {
+        std::memcpy(p, "DB   #$", 7);
+        p = put_byte(p + 7, op.opcode);
+    }
+    else
+    {
+        const OpcodeTemplate & t = templates().ops[op.opcode];
+        std::memcpy(p, t.text, sizeof(t.text));
+        p = put_operand(p + t.size, op);
+    }
+
+    *p++ = ' '; *p++ = '-';
+    for(uint8_t i=0; i!=op.length; ++i)
+    {
+        *p++ = ' ';
+        p = put_byte(p, bytes[i]);
+    }
+    *p++ = '\n';
+
+    return p - out;
+}
+
+size_t format_operands(const DecodedOp & op, char * out)
+{
+    char * p = out;
+    if(op.mnemonic == MN_DB)
+    {
+        *p++ = '#'; *p++ = '$';
+        return put_byte(p, op.opcode) - out;
+    }
+
+    const OpcodeInfo & info = opcode_table[op.opcode];
+    for(const char * c = info.registers; *c; ++c) *p++ = *c;
+    if(info.registers[0] && info.format != OPERAND_NONE) *p++ = ',';
+
+    return put_operand(p, op) - out;
+}
+
+size_t disassemble_line(const uint8_t * code, size_t size, size_t offset,
+                        uint32_t addr, char * out, uint8_t & length)
+{
+    DecodedOp op = decode_op(code, size, offset, addr - offset);
+    length = op.length;
+    return format_op(op, code + offset, out);
+}
+
+size_t disassemble_block(const uint8_t * code, size_t size, size_t offset, uint32_t base,
+                         char * out, size_t capacity, size_t & used)
+{
+    used = 0;
+    while(offset < size && capacity - used >= DISASM_LINE_MAX)
+    {
+        uint8_t length;
+        used += disassemble_line(code, size, offset, base + offset, out + used, length);
+        offset += length;
+    }
+    return offset;
+}
@@ -0,0 +1,120 @@
+/*
+Table driven 8080 disassembler built on the shared opcode table.
+
+Instructions decode into compact DecodedOp records, read in place from
+memory the caller owns (an mmap'd file, Bus::ram), for tools that want
+structured data. Text is formatted straight into a caller provided
+buffer from per-opcode templates, so bulk disassembly makes no stdio or
+allocation calls per instruction.
+
+Each line reads:    0100 MVI  B,#$12 - 06 12
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "opcodes.h"
+
+// A decoded instruction. operand holds the immediate byte or word, the
+// address or the port number, and is 0 when there is none.
+struct DecodedOp
+{
+    uint32_t addr;
+    uint16_t operand;
+    uint8_t opcode;
+    uint8_t length;
+    Mnemonic mnemonic;
+    FlowKind flow;
+};
+
+// Decodes the instruction at code[offset], base is the address of code[0].
+// An instruction cut off by the end of the code decodes as a one byte MN_DB.
+DecodedOp decode_op(const uint8_t * code, size_t size, size_t offset, uint32_t base = 0);
+
+// Linear sweep from code[offset] while the offset is before end, appending
+// to out. Returns the offset reached, past end if an instruction straddles it.
+size_t decode_range(const uint8_t * code, size_t size, size_t offset, size_t end,
+                    uint32_t base, std::vector<DecodedOp> & out);
+
+// The address a jump, call or RST transfers to. False for returns, PCHL
+// and instructions that don't change the flow.
+bool flow_target(const DecodedOp & op, uint32_t & target);
+
+// A linear sweep that decodes lazily as it is iterated, e.g.
+//     for(const DecodedOp & op: DecodeSpan(bus.ram.data(), bus.ram.size())) ...
+class DecodeSpan
+{
+    public:
+        DecodeSpan(const uint8_t * code, size_t size, uint32_t base = 0)
+            : code(code), size(size), base(base) {}
+
+        class iterator
+        {
+            public:
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = DecodedOp;
+                using difference_type = std::ptrdiff_t;
+                using pointer = const DecodedOp *;
+                using reference = const DecodedOp &;
+
+                iterator(const DecodeSpan * span, size_t offset) : span(span), offset(offset)
+                {
+                    if(offset < span->size) op = decode_op(span->code, span->size, offset, span->base);
+                }
+
+                reference operator*() const { return op; }
+                pointer operator->() const { return &op; }
+
+                iterator & operator++()
+                {
+                    offset += op.length;
+                    if(offset < span->size) op = decode_op(span->code, span->size, offset, span->base);
+                    else offset = span->size;
+                    return *this;
+                }
+
+                bool operator==(const iterator & other) const { return offset == other.offset; }
+                bool operator!=(const iterator & other) const { return offset != other.offset; }
+
+            private:
+                const DecodeSpan * span;
+                size_t offset;
+                DecodedOp op = {};
+        };
+
+        iterator begin() const { return iterator(this, 0); }
+        iterator end() const { return iterator(this, size); }
+
+    private:
+        const uint8_t * code;
+        size_t size;
+        uint32_t base;
+};
+
+// Formats a decoded instruction, whose bytes start at bytes, as one line.
+// Returns the characters written, at most DISASM_LINE_MAX.
+size_t format_op(const DecodedOp & op, const uint8_t * bytes, char * out);
+
+// Formats just the operands of a decoded instruction, e.g. "B,#$12",
+// without a terminator. Returns the characters written, at most 16.
+size_t format_operands(const DecodedOp & op, char * out);
+
+// Longest line disassemble_line writes, including the newline
+static const size_t DISASM_LINE_MAX = 48;
+
+// Formats the instruction at code[offset], which sits at address addr,
+// as one line. Returns the characters written and sets length to the
+// instruction length. An instruction cut off by the end of the code is
+// shown as a single DB byte.
+size_t disassemble_line(const uint8_t * code, size_t size, size_t offset,
+                        uint32_t addr, char * out, uint8_t & length);
+
+// Linear sweep from code[offset] until the code ends or out has no room
+// for another line. base is the address of code[0]. Returns the offset
+// reached and sets used to the characters written.
+size_t disassemble_block(const uint8_t * code, size_t size, size_t offset, uint32_t base,
+                         char * out, size_t capacity, size_t & used);
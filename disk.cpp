@@ -0,0 +1,466 @@
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bus.h"
+#include "disk.h"
+#include "savestate.h"
+
+// Guest memory used per drive, relative to its block
+static const uint16_t DRIVE_BLOCK = 0x100;
+static const uint16_t DPB_OFFSET = 0x10;
+static const uint16_t XLT_OFFSET = 0x20;
+static const uint16_t CSV_OFFSET = 0x40;
+static const uint16_t ALV_OFFSET = 0x80;
+
+// Largest tables that fit in a drive block
+static const size_t XLT_MAX = CSV_OFFSET - XLT_OFFSET;
+static const size_t CSV_MAX = ALV_OFFSET - CSV_OFFSET;
+static const size_t ALV_MAX = DRIVE_BLOCK - ALV_OFFSET;
+
+static const size_t SECTOR_SIZE = 128;
+
+// FORMATS ====================================
+
+size_t DiskFormat::image_size() const
+{
+    return (size_t)tracks * sectors_per_track * SECTOR_SIZE;
+}
+
+DiskFormat DiskFormat::ibm_sssd()
+{
+    DiskFormat format;
+    format.skew = {1, 7, 13, 19, 25, 5, 11, 17, 23, 3, 9, 15, 21,
+                   2, 8, 14, 20, 26, 6, 12, 18, 24, 4, 10, 16, 22};
+    return format;
+}
+
+// IMAGES =====================================
+
+DiskImage::DiskImage() {}
+
+DiskImage::~DiskImage()
+{
+    close();
+}
+
+bool DiskImage::open(const std::string & path, const DiskFormat & new_format, bool new_read_only)
+{
+    close();
+
+    fd = ::open(path.c_str(), new_read_only ? O_RDONLY : (O_RDWR | O_CREAT), 0644);
+    if(fd < 0) return 0;
+
+    struct stat st;
+    size_t size = new_format.image_size();
+    bool ok = fstat(fd, &st) == 0;
+
+    // A short image is extended so every sector is addressable
+    if(ok && (size_t)st.st_size < size)
+    {
+        ok = !new_read_only && ftruncate(fd, size) == 0;
+    }
+
+    void * addr = MAP_FAILED;
+    if(ok)
+    {
+        int prot = new_read_only ? PROT_READ : (PROT_READ | PROT_WRITE);
+        addr = mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+    }
+
+    if(addr == MAP_FAILED)
+    {
+        ::close(fd);
+        fd = -1;
+        return 0;
+    }
+
+    map = (uint8_t *)addr;
+    map_size = size;
+    format = new_format;
+    read_only = new_read_only;
+    this->path = path;
+    return 1;
+}
+
+void DiskImage::close()
+{
+    if(map)
+    {
+        if(!read_only) msync(map, map_size, MS_SYNC);
+        munmap(map, map_size);
+        map = nullptr;
+        map_size = 0;
+    }
+    if(fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+bool DiskImage::is_open()
+{
+    return map != nullptr;
+}
+
+bool DiskImage::is_read_only()
+{
+    return read_only;
+}
+
+const DiskFormat & DiskImage::get_format()
+{
+    return format;
+}
+
+const std::string & DiskImage::get_path()
+{
+    return path;
+}
+
+uint8_t * DiskImage::sector(uint16_t track, uint16_t physical_sector)
+{
+    uint16_t index = physical_sector - format.first_sector;
+    if(!map || track >= format.tracks || index >= format.sectors_per_track) return nullptr;
+
+    return map + ((size_t)track * format.sectors_per_track + index) * SECTOR_SIZE;
+}
+
+// Schedules write back of the whole mapping, the kernel only writes dirty pages
+void DiskImage::sync()
+{
+    if(map && !read_only) msync(map, map_size, MS_ASYNC);
+}
+
+// DISK SYSTEM ================================
+
+DiskSystem::DiskSystem() {}
+
+DiskSystem::~DiskSystem()
+{
+    flush();
+}
+
+void DiskSystem::connect_bus(Bus * new_bus)
+{
+    bus = new_bus;
+}
+
+bool DiskSystem::attach(uint8_t d, const std::string & path, const DiskFormat & format, bool read_only)
+{
+    if(d >= MAX_DRIVES) return 0;
+
+    // The guest tables have fixed room per drive
+    if(format.skew.size() > XLT_MAX || format.cks > CSV_MAX || format.dsm / 8u + 1 > ALV_MAX)
+    {
+        return 0;
+    }
+
+    detach(d);
+    if(!drives[d].open(path, format, read_only)) return 0;
+
+    install_tables(d);
+    return 1;
+}
+
+void DiskSystem::detach(uint8_t d)
+{
+    if(d >= MAX_DRIVES) return;
+
+    flush();
+    for(auto & entry: cache)
+    {
+        if(entry.drive == d) entry.valid = 0;
+    }
+    drives[d].close();
+}
+
+void DiskSystem::set_table_base(uint16_t addr)
+{
+    table_base = addr;
+    for(uint8_t d=0; d!=MAX_DRIVES; ++d)
+    {
+        if(drives[d].is_open()) install_tables(d);
+    }
+}
+
+uint16_t DiskSystem::select_disk(uint8_t d)
+{
+    if(d >= MAX_DRIVES || !drives[d].is_open()) return 0;
+
+    drive = d;
+    return dph_addr(d);
+}
+
+void DiskSystem::home()
+{
+    track = 0;
+}
+
+void DiskSystem::set_track(uint16_t new_track)
+{
+    track = new_track;
+}
+
+void DiskSystem::set_sector(uint16_t new_sector)
+{
+    sector = new_sector;
+}
+
+void DiskSystem::set_dma(uint16_t addr)
+{
+    dma_addr = addr;
+}
+
+// Logical sector to physical, using the guest's table as the BDOS passes it
+uint16_t DiskSystem::sector_translate(uint16_t logical, uint16_t table)
+{
+    if(table == 0) return logical + drives[drive].get_format().first_sector;
+
+    return bus->read_from_ram(table + logical);
+}
+
+uint8_t DiskSystem::read()
+{
+    CacheEntry * entry = lookup(drive, track, sector, 1);
+    if(!entry) return 1;
+
+    for(size_t i=0; i!=SECTOR_SIZE; ++i) bus->write_to_ram(dma_addr + i, entry->data[i]);
+    return 0;
+}
+
+// The BIOS deblocking hint, the write type (0 deferred, 1 directory, 2
+// unallocated), is ignored on purpose: every write is served from the
+// cache until the next batch, whatever its type
+uint8_t DiskSystem::write(uint8_t /*type*/)
+{
+    if(drives[drive].is_read_only()) return 1;
+
+    CacheEntry * entry = lookup(drive, track, sector, 0);
+    if(!entry) return 1;
+
+    for(size_t i=0; i!=SECTOR_SIZE; ++i) entry->data[i] = bus->read_from_ram(dma_addr + i);
+
+    if(!entry->dirty)
+    {
+        entry->dirty = 1;
+        dirty_count++;
+    }
+
+    if(dirty_count >= CACHE_SECTORS / 2) flush();
+    return 0;
+}
+
+bool DiskSystem::load_system(uint8_t d, uint16_t addr, uint16_t sectors)
+{
+    if(d >= MAX_DRIVES || !drives[d].is_open()) return 0;
+
+    const DiskFormat & format = drives[d].get_format();
+
+    for(uint16_t i=0; i!=sectors; ++i)
+    {
+        uint16_t t = (i + 1) / format.sectors_per_track;
+        uint16_t s = (i + 1) % format.sectors_per_track + format.first_sector;
+
+        CacheEntry * entry = lookup(d, t, s, 1);
+        if(!entry) return 0;
+
+        for(size_t j=0; j!=SECTOR_SIZE; ++j) bus->write_to_ram(addr + i * SECTOR_SIZE + j, entry->data[j]);
+    }
+    return 1;
+}
+
+// Copies every dirty sector into its mapping, then syncs each image once
+void DiskSystem::flush()
+{
+    if(dirty_count == 0) return;
+
+    bool touched[MAX_DRIVES] = {};
+
+    for(auto & entry: cache)
+    {
+        if(!entry.valid || !entry.dirty) continue;
+
+        uint8_t * dest = drives[entry.drive].sector(entry.track, entry.sector);
+        if(dest) std::memcpy(dest, entry.data.data(), SECTOR_SIZE);
+
+        entry.dirty = 0;
+        touched[entry.drive] = 1;
+    }
+    dirty_count = 0;
+
+    for(int d=0; d!=MAX_DRIVES; ++d)
+    {
+        if(touched[d]) drives[d].sync();
+    }
+}
+
+void DiskSystem::save_state(StateWriter & out)
+{
+    flush();
+
+    out.put(table_base);
+    out.put(drive);
+    out.put(track);
+    out.put(sector);
+    out.put(dma_addr);
+
+    for(auto & image: drives)
+    {
+        out.put((uint8_t)image.is_open());
+        if(!image.is_open()) continue;
+
+        const DiskFormat & f = image.get_format();
+        out.put_string(image.get_path());
+        out.put((uint8_t)image.is_read_only());
+        out.put(f.tracks);
+        out.put(f.sectors_per_track);
+        out.put(f.first_sector);
+        out.put((uint8_t)f.skew.size());
+        out.put(f.skew.data(), f.skew.size());
+        out.put(f.bsh);
+        out.put(f.blm);
+        out.put(f.exm);
+        out.put(f.dsm);
+        out.put(f.drm);
+        out.put(f.al0);
+        out.put(f.al1);
+        out.put(f.cks);
+        out.put(f.off);
+    }
+}
+
+bool DiskSystem::load_state(StateReader & in)
+{
+    // Sectors cached from the images before are of no use after
+    flush();
+    for(auto & entry: cache) entry.valid = 0;
+
+    in.get(table_base);
+    in.get(drive);
+    in.get(track);
+    in.get(sector);
+    in.get(dma_addr);
+
+    for(uint8_t d=0; d!=MAX_DRIVES && in.ok; ++d)
+    {
+        uint8_t attached;
+        in.get(attached);
+        if(!attached)
+        {
+            detach(d);
+            continue;
+        }
+
+        DiskFormat f;
+        uint8_t read_only, skew_size;
+        std::string path = in.get_string();
+        in.get(read_only);
+        in.get(f.tracks);
+        in.get(f.sectors_per_track);
+        in.get(f.first_sector);
+        in.get(skew_size);
+        const uint8_t * skew = in.view(skew_size);
+        if(skew) f.skew.assign(skew, skew + skew_size);
+        in.get(f.bsh);
+        in.get(f.blm);
+        in.get(f.exm);
+        in.get(f.dsm);
+        in.get(f.drm);
+        in.get(f.al0);
+        in.get(f.al1);
+        in.get(f.cks);
+        in.get(f.off);
+        if(!in.ok) break;
+
+        DiskImage & image = drives[d];
+        bool same = image.is_open() && image.get_path() == path && image.is_read_only() == (bool)read_only;
+        if(!same && !attach(d, path, f, read_only)) return 0;
+    }
+    return in.ok;
+}
+
+// Finds a sector in the cache, replacing the least recently used entry on
+// a miss. A dirty victim flushes the whole batch of dirty sectors.
+DiskSystem::CacheEntry * DiskSystem::lookup(uint8_t d, uint16_t t, uint16_t s, bool load)
+{
+    if(d >= MAX_DRIVES) return nullptr;
+
+    uint8_t * src = drives[d].sector(t, s);
+    if(!src) return nullptr;
+
+    CacheEntry * victim = &cache[0];
+    for(auto & entry: cache)
+    {
+        if(entry.valid && entry.drive==d && entry.track==t && entry.sector==s)
+        {
+            entry.last_used = ++use_counter;
+            return &entry;
+        }
+
+        if(!victim->valid) continue;
+        if(!entry.valid || entry.last_used < victim->last_used) victim = &entry;
+    }
+
+    if(victim->valid && victim->dirty) flush();
+
+    victim->valid = 1;
+    victim->dirty = 0;
+    victim->drive = d;
+    victim->track = t;
+    victim->sector = s;
+    victim->last_used = ++use_counter;
+    if(load) std::memcpy(victim->data.data(), src, SECTOR_SIZE);
+
+    return victim;
+}
+
+uint16_t DiskSystem::dph_addr(uint8_t d)
+{
+    return table_base + d * DRIVE_BLOCK;
+}
+
+// Writes the DPH, DPB and skew table for a drive into guest memory
+void DiskSystem::install_tables(uint8_t d)
+{
+    const DiskFormat & format = drives[d].get_format();
+
+    uint16_t base = dph_addr(d);
+    uint16_t dirbuf = table_base + MAX_DRIVES * DRIVE_BLOCK;
+    uint16_t xlt = format.skew.empty() ? 0 : base + XLT_OFFSET;
+
+    auto put_word = [this](uint16_t addr, uint16_t val)
+    {
+        bus->write_to_ram(addr, val & 0xFF);
+        bus->write_to_ram(addr + 1, val >> 8);
+    };
+
+    // Disk parameter header, the three BDOS scratch words start cleared
+    put_word(base + 0, xlt);
+    put_word(base + 2, 0);
+    put_word(base + 4, 0);
+    put_word(base + 6, 0);
+    put_word(base + 8, dirbuf);
+    put_word(base + 10, base + DPB_OFFSET);
+    put_word(base + 12, base + CSV_OFFSET);
+    put_word(base + 14, base + ALV_OFFSET);
+
+    // Disk parameter block
+    uint16_t dpb = base + DPB_OFFSET;
+    put_word(dpb + 0, format.sectors_per_track);
+    bus->write_to_ram(dpb + 2, format.bsh);
+    bus->write_to_ram(dpb + 3, format.blm);
+    bus->write_to_ram(dpb + 4, format.exm);
+    put_word(dpb + 5, format.dsm);
+    put_word(dpb + 7, format.drm);
+    bus->write_to_ram(dpb + 9, format.al0);
+    bus->write_to_ram(dpb + 10, format.al1);
+    put_word(dpb + 11, format.cks);
+    put_word(dpb + 13, format.off);
+
+    for(size_t i=0; i!=format.skew.size(); ++i) bus->write_to_ram(xlt + i, format.skew[i]);
+}
@@ -0,0 +1,164 @@
+/*
+BIOS level disk subsystem for CP/M disk images.
+
+Image files are attached with mmap and addressed the way the CP/M BIOS
+sees them: SELDSK, SETTRK, SETSEC, SETDMA, READ, WRITE and SECTRAN.
+Sector reads and writes go through a small write-back cache. Dirty
+sectors are copied into the mapping together and synced with one msync
+per image, so a disk heavy program never costs a syscall per 128 byte
+sector.
+
+The disk parameter headers, parameter blocks, skew tables and scratch
+areas the guest BDOS expects are written to guest memory, and the BIOS
+jump table reaches these functions through host traps (see bios.h).
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Forward declaration
+class Bus;
+class StateWriter;
+class StateReader;
+
+// Geometry and CP/M parameters of an image format
+struct DiskFormat
+{
+    uint16_t tracks = 77;
+    uint16_t sectors_per_track = 26;
+    uint8_t first_sector = 1;           // Physical sector numbering base
+    std::vector<uint8_t> skew;          // Logical to physical, empty for none
+
+    // Disk parameter block
+    uint8_t bsh = 3;
+    uint8_t blm = 7;
+    uint8_t exm = 0;
+    uint16_t dsm = 242;
+    uint16_t drm = 63;
+    uint8_t al0 = 0xC0;
+    uint8_t al1 = 0x00;
+    uint16_t cks = 16;
+    uint16_t off = 2;
+
+    size_t image_size() const;
+
+    // 8" single sided, single density, the CP/M distribution format
+    static DiskFormat ibm_sssd();
+};
+
+// A disk image file mapped into memory
+class DiskImage
+{
+    public:
+        DiskImage();
+        ~DiskImage();
+
+        // Maps the image, creating or extending it to the full size
+        // when writable. Returns false if it can't be mapped.
+        bool open(const std::string & path, const DiskFormat & format, bool read_only);
+        void close();
+
+        bool is_open();
+        bool is_read_only();
+        const DiskFormat & get_format();
+        const std::string & get_path();
+
+        // Start of a physical sector in the mapping, nullptr if out of range
+        uint8_t * sector(uint16_t track, uint16_t physical_sector);
+
+        // Writes mapped changes back to the file
+        void sync();
+
+    private:
+        DiskFormat format;
+        std::string path;
+        int fd = -1;
+        uint8_t * map = nullptr;
+        size_t map_size = 0;
+        bool read_only = 0;
+};
+
+class DiskSystem
+{
+    public:
+        DiskSystem();
+        ~DiskSystem();
+
+        // Called by Bus on creation to link to the disk system
+        void connect_bus(Bus * new_bus);
+
+    public:
+        static const int MAX_DRIVES = 4;
+        static const int CACHE_SECTORS = 32;
+
+        // Attaches an image to a drive (0 = A:) and installs its tables
+        bool attach(uint8_t drive, const std::string & path,
+                    const DiskFormat & format = DiskFormat::ibm_sssd(), bool read_only = 0);
+        void detach(uint8_t drive);
+
+        // Moves the DPHs, DPBs, skew tables and scratch areas in guest
+        // memory, reinstalling them for attached drives
+        void set_table_base(uint16_t addr);
+
+        // BIOS entry points
+        uint16_t select_disk(uint8_t drive);        // DPH address, 0 if no drive
+        void home();
+        void set_track(uint16_t track);
+        void set_sector(uint16_t sector);
+        void set_dma(uint16_t addr);
+        uint16_t sector_translate(uint16_t logical, uint16_t table);
+        uint8_t read();                             // 0 ok, 1 error
+        uint8_t write(uint8_t type);                // 0 ok, 1 error or read only
+
+        // Loads consecutive sectors from the system tracks, starting at
+        // track 0 sector 2 (after the boot sector), as a BIOS cold or
+        // warm boot does for the CCP and BDOS
+        bool load_system(uint8_t drive, uint16_t addr, uint16_t sectors);
+
+        // Writes every dirty sector back to its image
+        void flush();
+
+        // The attached images, by path, and the BIOS selection, for save
+        // states. Saving flushes the cache, so the images hold every
+        // write up to the save. Loading attaches the images again unless
+        // they are already attached.
+        void save_state(StateWriter & out);
+        bool load_state(StateReader & in);
+
+    private:
+        Bus * bus = nullptr;
+        std::array<DiskImage, MAX_DRIVES> drives;
+
+        // Guest memory used for the drive tables
+        uint16_t table_base = 0xF800;
+
+        // Current BIOS selection
+        uint8_t drive = 0;
+        uint16_t track = 0;
+        uint16_t sector = 0;
+        uint16_t dma_addr = 0x0080;
+
+        // Write-back sector cache, least recently used entry is replaced
+        struct CacheEntry
+        {
+            bool valid = 0;
+            bool dirty = 0;
+            uint8_t drive = 0;
+            uint16_t track = 0;
+            uint16_t sector = 0;
+            uint64_t last_used = 0;
+            std::array<uint8_t, 128> data;
+        };
+        std::array<CacheEntry, CACHE_SECTORS> cache;
+        uint64_t use_counter = 0;
+        int dirty_count = 0;
+
+        CacheEntry * lookup(uint8_t d, uint16_t t, uint16_t s, bool load);
+        uint16_t dph_addr(uint8_t d);
+        void install_tables(uint8_t d);
+};
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <cstring>
+
+#include "fuzz.h"
+
+const char * fuzz_outcome_name(FuzzOutcome outcome)
+{
+    switch(outcome)
+    {
+        case FuzzOutcome::OK:               return "ok";
+        case FuzzOutcome::TIMEOUT:          return "timeout";
+        case FuzzOutcome::NOT_IMPLEMENTED:  return "not_implemented";
+        case FuzzOutcome::STACK_RUNAWAY:    return "stack_runaway";
+        case FuzzOutcome::DIAG_ERROR:       return "diag_error";
+    }
+    return "unknown";
+}
+
+bool fuzz_outcome_is_crash(FuzzOutcome outcome)
+{
+    return outcome==FuzzOutcome::NOT_IMPLEMENTED
+        || outcome==FuzzOutcome::STACK_RUNAWAY
+        || outcome==FuzzOutcome::DIAG_ERROR;
+}
+
+FuzzTarget::FuzzTarget()
+    : bus(new Bus(i8080::FAST)), reset_image(new std::array<uint8_t, 64*1024>)
+{
+    // Tracing and console output would dominate the exec rate. Runs are
+    // budgeted in instructions, so the core needn't keep exact time.
+    // Inputs mustn't create or delete files in the host directory, and
+    // runs stay independent of whatever is in it.
+    bus->cpu.trace = 0;
+    bus->bdos.output_enabled = 0;
+    bus->bdos.files_enabled = 0;
+
+    *reset_image = bus->ram;
+    bus->clear_dirty_pages();
+}
+
+FuzzTarget::~FuzzTarget() {}
+
+void FuzzTarget::load_firmware(const char * filename, uint16_t org)
+{
+    bus->load_rom(filename, org);
+    *reset_image = bus->ram;
+    bus->clear_dirty_pages();
+}
+
+void FuzzTarget::attach_coverage(uint8_t * map)
+{
+    bus->cpu.coverage_map = map;
+}
+
+FuzzOutcome FuzzTarget::run(const uint8_t * data, size_t size)
+{
+    i8080 & cpu = bus->cpu;
+
+    // Restore memory and registers to the reset state. Only the pages the
+    // last run wrote differ from the image.
+    bus->revert_dirty_pages(reset_image->data());
+    cpu.A = cpu.B = cpu.C = cpu.D = cpu.E = cpu.H = cpu.L = 0;
+    cpu.status = 0;
+    cpu.PC = entry;
+    cpu.SP = stack_top;
+    cpu.coverage_prev = 0;
+    cpu.reset_stop();
+    bus->bdos.reset();
+
+    // Deliver the input
+    if(input_mode==RAM_REGION)
+    {
+        size_t len = std::min<size_t>({size, input_max, bus->ram.size() - input_addr});
+        std::memcpy(&bus->ram[input_addr], data, len);
+        bus->mark_dirty(input_addr, len);
+        bus->bdos.set_console_input(nullptr, 0);
+    }
+    else
+    {
+        bus->bdos.set_console_input(data, size);
+    }
+
+    for(steps=0; steps!=max_steps; )
+    {
+        cpu.step();
+        steps++;
+
+        if(cpu.is_stopped())
+        {
+            if(!cpu.implemented(cpu.get_opcode())) return FuzzOutcome::NOT_IMPLEMENTED;
+            return FuzzOutcome::OK;
+        }
+        if(cpu.SP < stack_floor || cpu.SP > stack_top) return FuzzOutcome::STACK_RUNAWAY;
+        if(diag_exit_at_zero && cpu.PC==0x0000) return FuzzOutcome::DIAG_ERROR;
+    }
+
+    return FuzzOutcome::TIMEOUT;
+}
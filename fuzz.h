@@ -0,0 +1,75 @@
+/*
+A fuzzing target wrapped around the i8080 core.
+Each execution restores a pristine copy of the loaded firmware and a fresh
+BDOS disk state, feeds the input through a RAM region or the BDOS console
+input, and runs until the program stops, crashes or uses up its step
+budget. BDOS file functions fail, so inputs never reach the host's files.
+
+Edge coverage is recorded by the core into an AFL style bitmap when it is
+built with FUZZ_COVERAGE, without it the instrumentation compiles out.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "bus.h"
+
+// Classification of a single execution
+enum class FuzzOutcome : uint8_t
+{
+    OK,                 // Program stopped normally (BDOS reset or input ran out)
+    TIMEOUT,            // Step budget exhausted
+    NOT_IMPLEMENTED,    // Hit an opcode the core doesn't implement
+    STACK_RUNAWAY,      // SP left the configured stack window
+    DIAG_ERROR          // CPUDIAG style failure, PC reached 0x0000
+};
+
+const char * fuzz_outcome_name(FuzzOutcome outcome);
+
+// Crash-like outcomes are reported to the fuzzer as crashes
+bool fuzz_outcome_is_crash(FuzzOutcome outcome);
+
+class FuzzTarget
+{
+    public:
+        FuzzTarget();
+        ~FuzzTarget();
+
+    public:
+        // Where the input is delivered
+        enum INPUT_MODE
+        {
+            RAM_REGION,
+            CONSOLE_INPUT
+        };
+
+        // Configuration, set before load_firmware()
+        INPUT_MODE input_mode = RAM_REGION;
+        uint16_t input_addr = 0x2000;   // RAM region start
+        uint16_t input_max = 0x1000;    // Bytes beyond this are dropped
+        uint16_t entry = 0x0100;        // PC at the start of each execution
+        uint16_t stack_top = 0xF000;    // Initial SP
+        uint16_t stack_floor = 0xE000;  // SP below this counts as runaway
+        uint64_t max_steps = 1000000;   // Instructions before a timeout
+        bool diag_exit_at_zero = 1;     // Treat PC==0x0000 as a CPUDIAG failure
+
+        // Loads the firmware and snapshots memory as the reset image
+        void load_firmware(const char * filename, uint16_t org);
+
+        // Coverage map of i8080::COVERAGE_MAP_SIZE bytes, may be shared memory
+        void attach_coverage(uint8_t * map);
+
+        // Runs a single input from the reset image
+        FuzzOutcome run(const uint8_t * data, size_t size);
+
+        // Number of instructions the last run executed
+        uint64_t steps = 0;
+
+    private:
+        // Bus is too large for the stack of most fuzzer threads
+        std::unique_ptr<Bus> bus;
+        std::unique_ptr<std::array<uint8_t, 64*1024>> reset_image;
+};
@@ -0,0 +1,122 @@
+/*
+Fuzzing front end for the i8080 core, build with FUZZ_COVERAGE defined:
+    g++ -O2 -pthread -DFUZZ_COVERAGE fuzz8080.cpp fuzz.cpp i8080.cpp opcodes.cpp profile.cpp trace.cpp mapfile.cpp bus.cpp BDOS.cpp bios.cpp console.cpp disk.cpp -o fuzz8080
+
+Usage: fuzz8080 [-f firmware] [-o org] [-c] [-r addr] [-n repeat] [input...]
+    -f  firmware loaded into memory before every execution
+    -o  firmware origin, also used as the entry point (default 0100)
+    -c  feed the input through the BDOS console instead of RAM
+    -r  RAM region the input is copied to (default 2000)
+    -n  run each input this many times, for measuring exec/sec
+
+Inputs are read from stdin when no files are given. When started by AFL the
+coverage map is attached to __AFL_SHM_ID and crash-like outcomes abort().
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <sys/shm.h>
+
+#include "fuzz.h"
+
+#ifndef FUZZ_COVERAGE
+#error "fuzz8080 needs the core built with FUZZ_COVERAGE"
+#endif
+
+using namespace std;
+
+static vector<uint8_t> read_input(istream & in)
+{
+    return vector<uint8_t>(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+int main(int argc, char *argv[])
+{
+    FuzzTarget target;
+    const char * firmware = nullptr;
+    uint16_t org = 0x0100;
+    uint64_t repeat = 1;
+    vector<const char *> inputs;
+
+    for(int i=1; i<argc; ++i)
+    {
+        string arg = argv[i];
+        if(arg=="-f" && i+1<argc)       firmware = argv[++i];
+        else if(arg=="-o" && i+1<argc)  org = stoi(argv[++i], nullptr, 16);
+        else if(arg=="-r" && i+1<argc)  target.input_addr = stoi(argv[++i], nullptr, 16);
+        else if(arg=="-n" && i+1<argc)  repeat = stoull(argv[++i]);
+        else if(arg=="-c")              target.input_mode = FuzzTarget::CONSOLE_INPUT;
+        else                            inputs.push_back(argv[i]);
+    }
+
+    target.entry = org;
+    if(firmware) target.load_firmware(firmware, org);
+
+    // Use AFL's shared map if we were started by afl-fuzz
+    vector<uint8_t> local_map(i8080::COVERAGE_MAP_SIZE);
+    uint8_t * map = local_map.data();
+    bool under_afl = 0;
+    if(const char * shm_id = getenv("__AFL_SHM_ID"))
+    {
+        void * shm = shmat(atoi(shm_id), nullptr, 0);
+        if(shm != (void *)-1)
+        {
+            map = (uint8_t *)shm;
+            under_afl = 1;
+        }
+    }
+    target.attach_coverage(map);
+
+    vector<vector<uint8_t>> data;
+    if(inputs.empty())
+    {
+        data.push_back(read_input(cin));
+    }
+    for(auto name: inputs)
+    {
+        ifstream in(name, ios::binary);
+        if(!in)
+        {
+            cerr << "error: Couldn't open " << name << endl;
+            return 1;
+        }
+        data.push_back(read_input(in));
+    }
+
+    uint64_t execs = 0;
+    auto start = chrono::steady_clock::now();
+    for(size_t i=0; i!=data.size(); ++i)
+    {
+        FuzzOutcome outcome = FuzzOutcome::OK;
+        for(uint64_t n=0; n!=repeat; ++n)
+        {
+            outcome = target.run(data[i].data(), data[i].size());
+            execs++;
+        }
+
+        if(!under_afl)
+        {
+            cout << (inputs.empty() ? "<stdin>" : inputs[i]) << "\t"
+                 << fuzz_outcome_name(outcome) << "\t" << target.steps << " steps" << "\n";
+        }
+        else if(fuzz_outcome_is_crash(outcome))
+        {
+            abort();
+        }
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    if(!under_afl && repeat > 1)
+    {
+        cout << execs << " execs in " << elapsed.count() << "s, "
+             << (uint64_t)(execs / elapsed.count()) << " exec/sec" << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,470 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "bus.h"
+#include "gdbstub.h"
+
+// Registers in the order of GDB's Z80 'g' packet, see gdbstub.h
+static const unsigned REGISTER_COUNT = 13;
+enum { REG_AF, REG_BC, REG_DE, REG_HL, REG_SP, REG_PC };
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static int hex_value(char c)
+{
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static void put_byte(std::string & out, uint8_t b)
+{
+    out += hex_digits[b >> 4];
+    out += hex_digits[b & 0x0F];
+}
+
+// Reads hex digits from text at pos up to a character not a digit,
+// returning false if there are none
+static bool parse_hex(const std::string & text, size_t & pos, uint32_t & value)
+{
+    size_t start = pos;
+    value = 0;
+    while(pos < text.size() && hex_value(text[pos]) >= 0)
+    {
+        value = (value << 4) | hex_value(text[pos]);
+        pos++;
+    }
+    return pos != start;
+}
+
+// A 16 bit register as GDB sends it, low byte first
+static bool parse_word_le(const std::string & text, size_t pos, uint16_t & value)
+{
+    if(pos + 4 > text.size()) return 0;
+    int d[4];
+    for(int i=0; i!=4; ++i)
+    {
+        d[i] = hex_value(text[pos + i]);
+        if(d[i] < 0) return 0;
+    }
+    value = ((d[0] << 4) | d[1]) | (((d[2] << 4) | d[3]) << 8);
+    return 1;
+}
+
+GdbStub::GdbStub(Bus & bus) : bus(bus) {}
+
+GdbStub::~GdbStub()
+{
+    close_client();
+    if(listen_fd >= 0) ::close(listen_fd);
+    if(!unix_path.empty()) unlink(unix_path.c_str());
+}
+
+bool GdbStub::listen(const std::string & address)
+{
+    if(address.find('/') != std::string::npos)
+    {
+        sockaddr_un addr = {};
+        if(address.size() >= sizeof(addr.sun_path)) return 0;
+        addr.sun_family = AF_UNIX;
+        std::strcpy(addr.sun_path, address.c_str());
+
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(listen_fd < 0) return 0;
+
+        unlink(address.c_str());
+        if(bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) != 0) return 0;
+        unix_path = address;
+    }
+    else
+    {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(atoi(address.c_str()));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(listen_fd < 0) return 0;
+
+        int on = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if(bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) != 0) return 0;
+    }
+
+    return ::listen(listen_fd, 1) == 0;
+}
+
+bool GdbStub::serve()
+{
+    if(listen_fd < 0) return 0;
+
+    fd = accept(listen_fd, nullptr, nullptr);
+    if(fd < 0) return 0;
+
+    // Packets are small and each waits on the last
+    int on = 1;
+    if(unix_path.empty()) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    ack = 1;
+
+    bool ok = 1;
+    bool done = 0;
+    bool killed = 0;
+    while(!done)
+    {
+        std::string packet;
+        if(!read_packet(packet))
+        {
+            ok = 0;
+            break;
+        }
+
+        bool resume = 0;
+        std::string reply = handle(packet, resume, done);
+        if(resume) reply = run(packet[0] == 's', done);
+
+        // A kill gets no reply
+        if(packet == "k")
+        {
+            killed = 1;
+            break;
+        }
+        if(!send_packet(reply))
+        {
+            ok = 0;
+            break;
+        }
+        if(packet == "QStartNoAckMode") ack = 0;
+    }
+
+    // The guest runs on without the debugger unless it was killed
+    for(uint32_t addr=0; addr!=0x10000; ++addr) bus.cpu.clear_breakpoint(addr);
+    bus.clear_watchpoints();
+    if(killed) bus.cpu.stop();
+    else if(bus.cpu.get_debug_stop() != i8080::DEBUG_NONE) bus.cpu.resume();
+
+    close_client();
+    return ok;
+}
+
+// PACKETS ====================================
+
+bool GdbStub::read_byte(uint8_t & byte)
+{
+    return recv(fd, &byte, 1, 0) == 1;
+}
+
+bool GdbStub::read_packet(std::string & packet)
+{
+    uint8_t c;
+    while(1)
+    {
+        // Skip acks and noise up to the start of a packet
+        do
+        {
+            if(!read_byte(c)) return 0;
+            if(c == 0x03)
+            {
+                packet = "\x03";
+                return 1;
+            }
+        } while(c != '$');
+
+        packet.clear();
+        uint8_t sum = 0;
+        while(1)
+        {
+            if(!read_byte(c)) return 0;
+            if(c == '#') break;
+            sum += c;
+
+            // Binary data escapes '#', '$', '}' and '*'
+            if(c == '}')
+            {
+                if(!read_byte(c)) return 0;
+                sum += c;
+                c ^= 0x20;
+            }
+            packet += c;
+        }
+
+        uint8_t check[2];
+        if(!read_byte(check[0]) || !read_byte(check[1])) return 0;
+        int hi = hex_value(check[0]);
+        int lo = hex_value(check[1]);
+        bool valid = hi >= 0 && lo >= 0 && ((hi << 4) | lo) == sum;
+
+        if(ack)
+        {
+            char reply = valid ? '+' : '-';
+            if(send(fd, &reply, 1, MSG_NOSIGNAL) != 1) return 0;
+        }
+        if(valid || !ack) return 1;
+    }
+}
+
+bool GdbStub::send_packet(const std::string & data)
+{
+    std::string out = "$";
+    uint8_t sum = 0;
+    for(char c: data)
+    {
+        // Replies are hex or plain text, only '#', '$' and '}' need escaping
+        if(c == '#' || c == '$' || c == '}')
+        {
+            out += '}';
+            sum += '}';
+            c ^= 0x20;
+        }
+        out += c;
+        sum += c;
+    }
+    out += '#';
+    put_byte(out, sum);
+
+    for(int attempt=0; attempt!=8; ++attempt)
+    {
+        if(send(fd, out.data(), out.size(), MSG_NOSIGNAL) != (ssize_t)out.size()) return 0;
+        if(!ack) return 1;
+
+        uint8_t c;
+        do
+        {
+            if(!read_byte(c)) return 0;
+        } while(c != '+' && c != '-');
+        if(c == '+') return 1;
+    }
+    return 0;
+}
+
+// Looks for a ^C without waiting, GDB sends nothing else while the
+// guest runs
+bool GdbStub::interrupt_pending()
+{
+    pollfd p = {fd, POLLIN, 0};
+    if(poll(&p, 1, 0) <= 0) return 0;
+
+    uint8_t c;
+    return read_byte(c) && c == 0x03;
+}
+
+void GdbStub::close_client()
+{
+    if(fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+// COMMANDS ===================================
+
+std::string GdbStub::handle(const std::string & packet, bool & resume, bool & done)
+{
+    if(packet.empty()) return "";
+
+    i8080 & cpu = bus.cpu;
+    const std::string args = packet.substr(1);
+    size_t pos = 0;
+    uint32_t value;
+
+    switch(packet[0])
+    {
+        case 0x03: return "S02";
+        case '?': return "S05";
+        case 'g': return read_registers();
+        case 'G': return write_registers(args) ? "OK" : "E01";
+        case 'm': return read_memory(args);
+        case 'M': return write_memory(args) ? "OK" : "E01";
+        case 'Z': return set_point(args, 1);
+        case 'z': return set_point(args, 0);
+        case 'H': return "OK";
+        case 'k': done = 1; return "";
+
+        case 'D':
+            done = 1;
+            return "OK";
+
+        case 'p':
+        {
+            if(!parse_hex(args, pos, value) || value >= REGISTER_COUNT) return "E01";
+            std::string regs = read_registers();
+            return regs.substr(value * 4, 4);
+        }
+
+        case 'P':
+        {
+            uint16_t word;
+            if(!parse_hex(args, pos, value) || pos >= args.size() || args[pos] != '=') return "E01";
+            if(!parse_word_le(args, pos + 1, word)) return "E01";
+            return write_register(value, word) ? "OK" : "E01";
+        }
+
+        // An address to resume from may follow
+        case 's':
+        case 'c':
+            if(parse_hex(args, pos, value)) cpu.PC = value;
+            resume = 1;
+            return "";
+    }
+
+    if(packet.compare(0, 10, "qSupported") == 0) return "PacketSize=1000";
+    if(packet == "QStartNoAckMode") return "OK";
+    if(packet == "qAttached") return "1";
+    if(packet == "qC") return "QC1";
+    if(packet == "qfThreadInfo") return "m1";
+    if(packet == "qsThreadInfo") return "l";
+
+    return "";
+}
+
+std::string GdbStub::run(bool single, bool & done)
+{
+    i8080 & cpu = bus.cpu;
+    cpu.resume();
+
+    if(single)
+    {
+        cpu.step();
+    }
+    else
+    {
+        while(!cpu.is_stopped())
+        {
+            for(uint32_t i=0; i!=POLL_STEPS && !cpu.is_stopped(); ++i) cpu.step();
+            if(!cpu.is_stopped() && interrupt_pending()) return "S02";
+        }
+    }
+
+    if(cpu.get_debug_stop() == i8080::DEBUG_WATCHPOINT)
+    {
+        Bus::WatchHit hit = bus.get_watch_hit();
+        const char * kind = (hit.kind == Bus::WATCH_WRITE) ? "watch"
+                          : (hit.kind == Bus::WATCH_READ) ? "rwatch" : "awatch";
+        char reply[32];
+        snprintf(reply, sizeof(reply), "T05%s:%x;", kind, hit.addr);
+        return reply;
+    }
+
+    if(cpu.get_debug_stop() == i8080::DEBUG_NONE && cpu.is_stopped())
+    {
+        if(!cpu.implemented(cpu.get_opcode())) return "S04";
+
+        done = 1;
+        return "W00";
+    }
+
+    return "S05";
+}
+
+std::string GdbStub::read_registers()
+{
+    i8080 & cpu = bus.cpu;
+    uint16_t regs[REGISTER_COUNT] = {};
+    regs[REG_AF] = (cpu.A << 8) | cpu.status;
+    regs[REG_BC] = (cpu.B << 8) | cpu.C;
+    regs[REG_DE] = (cpu.D << 8) | cpu.E;
+    regs[REG_HL] = (cpu.H << 8) | cpu.L;
+    regs[REG_SP] = cpu.SP;
+    regs[REG_PC] = cpu.PC;
+
+    std::string out;
+    for(uint16_t r: regs)
+    {
+        put_byte(out, r & 0xFF);
+        put_byte(out, r >> 8);
+    }
+    return out;
+}
+
+bool GdbStub::write_registers(const std::string & hex)
+{
+    for(unsigned n=0; n!=REGISTER_COUNT; ++n)
+    {
+        uint16_t value;
+        if(!parse_word_le(hex, n * 4, value)) return n != 0;
+        write_register(n, value);
+    }
+    return 1;
+}
+
+bool GdbStub::write_register(unsigned n, uint16_t value)
+{
+    i8080 & cpu = bus.cpu;
+    switch(n)
+    {
+        case REG_AF: cpu.A = value >> 8; cpu.status = value; break;
+        case REG_BC: cpu.B = value >> 8; cpu.C = value; break;
+        case REG_DE: cpu.D = value >> 8; cpu.E = value; break;
+        case REG_HL: cpu.H = value >> 8; cpu.L = value; break;
+        case REG_SP: cpu.SP = value; break;
+        case REG_PC: cpu.PC = value; break;
+        default: return n < REGISTER_COUNT;
+    }
+    return 1;
+}
+
+// Memory is read and written directly, so the debugger never trips a
+// watchpoint. Addresses wrap at 64K.
+std::string GdbStub::read_memory(const std::string & args)
+{
+    size_t pos = 0;
+    uint32_t addr, length;
+    if(!parse_hex(args, pos, addr) || pos >= args.size() || args[pos++] != ',') return "E01";
+    if(!parse_hex(args, pos, length) || length > 0x10000) return "E01";
+
+    std::string out;
+    for(uint32_t i=0; i!=length; ++i) put_byte(out, bus.ram[uint16_t(addr + i)]);
+    return out;
+}
+
+bool GdbStub::write_memory(const std::string & args)
+{
+    size_t pos = 0;
+    uint32_t addr, length;
+    if(!parse_hex(args, pos, addr) || pos >= args.size() || args[pos++] != ',') return 0;
+    if(!parse_hex(args, pos, length) || pos >= args.size() || args[pos++] != ':') return 0;
+    if(args.size() - pos < 2 * (size_t)length) return 0;
+
+    for(uint32_t i=0; i!=length; ++i)
+    {
+        int hi = hex_value(args[pos + 2*i]);
+        int lo = hex_value(args[pos + 2*i + 1]);
+        if(hi < 0 || lo < 0) return 0;
+        bus.ram[uint16_t(addr + i)] = (hi << 4) | lo;
+        bus.mark_dirty(uint16_t(addr + i), 1);
+    }
+    return 1;
+}
+
+// Z/z type,addr,kind. Types 0 and 1 are breakpoints, 2 to 4 write, read
+// and access watchpoints with kind as the length.
+std::string GdbStub::set_point(const std::string & args, bool insert)
+{
+    size_t pos = 0;
+    uint32_t type, addr, kind;
+    if(!parse_hex(args, pos, type) || pos >= args.size() || args[pos++] != ',') return "E01";
+    if(!parse_hex(args, pos, addr) || pos >= args.size() || args[pos++] != ',') return "E01";
+    if(!parse_hex(args, pos, kind) || addr > 0xFFFF) return "E01";
+
+    if(type <= 1)
+    {
+        if(insert) bus.cpu.set_breakpoint(addr);
+        else       bus.cpu.clear_breakpoint(addr);
+        return "OK";
+    }
+
+    static const Bus::WatchKind kinds[] = {Bus::WATCH_WRITE, Bus::WATCH_READ, Bus::WATCH_ACCESS};
+    if(type > 4 || kind == 0 || kind > 0xFFFF) return "";
+
+    Bus::WatchKind watch = kinds[type - 2];
+    if(insert) bus.add_watchpoint(addr, kind, watch);
+    else if(!bus.remove_watchpoint(addr, kind, watch)) return "E01";
+    return "OK";
+}
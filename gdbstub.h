@@ -0,0 +1,79 @@
+/*
+GDB remote serial protocol stub, serving one debugger session over a
+local TCP port or a Unix socket.
+
+GDB has no 8080 target, so the stub presents the Z80 register layout the
+8080 is a subset of: af, bc, de, hl, sp, pc, ix, iy, af', bc', de', hl'
+and ir, 16 bits each. The Z80 only registers read as 0 and writes to them
+are ignored. Connect with:
+
+    (gdb) set architecture z80
+    (gdb) target remote localhost:1234
+
+Supported: register and memory reads and writes, single step, continue,
+^C, software and hardware breakpoints (both kept in the core's fetch
+bitmap) and write, read and access watchpoints (kept by the Bus per
+page). A guest that ends reports as an exit, an unimplemented opcode as
+SIGILL.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+class Bus;
+
+class GdbStub
+{
+    public:
+        GdbStub(Bus & bus);
+        ~GdbStub();
+
+        GdbStub(const GdbStub &) = delete;
+        GdbStub & operator=(const GdbStub &) = delete;
+
+        // Listens on localhost at a port number, or on a Unix socket when
+        // address contains a '/'. Returns false if it can't.
+        bool listen(const std::string & address);
+
+        // Waits for GDB to connect and serves it until it detaches, kills
+        // the guest or the guest ends. After a detach the breakpoints
+        // and watchpoints are gone and the guest can run on. Returns
+        // false if the connection fails.
+        bool serve();
+
+    private:
+        Bus & bus;
+        int listen_fd = -1;
+        int fd = -1;
+        std::string unix_path;
+        bool ack = 1;
+
+        // Steps run between checks for a ^C from GDB
+        static const uint32_t POLL_STEPS = 1 << 14;
+
+        // Reads a packet, acknowledging it. Returns false when GDB has
+        // gone. A lone ^C comes back as "\x03".
+        bool read_packet(std::string & packet);
+        bool send_packet(const std::string & data);
+        bool read_byte(uint8_t & byte);
+        bool interrupt_pending();
+
+        // Answers one packet. Sets resume for s and c, whose reply comes
+        // when the guest stops, and done for packets that end the session.
+        std::string handle(const std::string & packet, bool & resume, bool & done);
+
+        // Runs the guest, one instruction or until it stops, and returns
+        // the stop reply. Sets done if the guest has ended.
+        std::string run(bool single, bool & done);
+
+        std::string read_registers();
+        bool write_registers(const std::string & hex);
+        bool write_register(unsigned n, uint16_t value);
+        std::string read_memory(const std::string & args);
+        bool write_memory(const std::string & args);
+        std::string set_point(const std::string & args, bool insert);
+
+        void close_client();
+};
@@ -4,19 +4,37 @@
 
 #include "bus.h"
 #include "i8080.h"
+#include "opcodes.h"
+#include "profile.h"
+#include "savestate.h"
+#include "trace.h"
 
 #define CPUDIAG
 
 using namespace std;
 
 // Constructor
-i8080::i8080() {
+i8080::i8080(Timing timing) : timing(timing) {
     // Headers for the print output
     //cout << "CLK\tOPS\tPC\tOPCODE\tALIAS\tDATA\tREGISTERS\t\t\t\t\t\tFLAGS\tSP CONTENTS" << endl;
 
 #ifdef CPUDIAG
     PC = 0x0100; // The CPU test program origin is 0100
 #endif
+
+    // Flatten the instruction map into a 256 entry table so the
+    // run loop doesn't pay for a hash lookup on every opcode.
+    // Missing opcodes run the 'not implemented' instruction.
+    for(int op=0; op!=256; ++op)
+    {
+        auto found = instructions.find(op);
+        decode_table[op] = (found != instructions.end()) ? &found->second : &not_implemented;
+
+        flow_op[op] = opcode_table[op].flow != FLOW_NONE && opcode_table[op].flow != FLOW_HALT;
+    }
+
+    if(timing == CYCLE_EXACT) core = &i8080::execute<ExactTiming>;
+    else                      core = &i8080::execute<FastTiming>;
 };
 
 // Desctructor
@@ -27,29 +45,7 @@ bool i8080::clock()
 {
     if(cycles==0)
     {
-        // Automaticlly progresses the program counter by 1
-        // Addressing modes add additional steps if required
-        PC_previous = PC;
-        opcode = read(PC++);
-
-        // Finds the related instruction in the instructions map
-        // If not found, runs the 'not implemented' instruction.
-        try {
-            instruction = instructions.at(opcode);
-        }
-        catch(...) {
-            instruction = not_implemented;
-            stopped = 1; // Uncomment if searching for not implemented functions
-        }   
-
-        // Performs the opcode instruction
-        (this->*instruction.addrmode)();
-
-        // Performs the opcode instruction
-        (this->*instruction.operation)();
-
-        op_count ++;
-        print_CPU_detail();
+        step();
     }
 
     clock_count++;
@@ -69,18 +65,255 @@ bool i8080::clock()
     return stopped;
 }
 
+// Executes a single instruction, returning the cycles it takes
+uint8_t i8080::step()
+{
+    return (this->*core)();
+}
+
+// The run loop, compiled once per timing policy so neither core tests
+// the mode per instruction
+template<class TimingPolicy>
+uint8_t i8080::execute()
+{
+    // Automaticlly progresses the program counter by 1
+    // Addressing modes add additional steps if required
+    if(fetch_map[PC])
+    {
+        if(breakpoint_map[PC] && PC != break_pass)
+        {
+            debug_break(DEBUG_BREAKPOINT);
+            return 0;
+        }
+        break_pass = NO_BREAK_PASS;
+
+        if(trap_map[PC])
+        {
+#ifdef PROFILE_COUNTERS
+            if(profile) profile->record_trap(PC);
+#endif
+            run_trap();
+
+            // Recorded as the RET the handler stands in for
+            if(tracer && tracer->filter.wants_trap(PC_previous)) tracer->record(*this, PC_previous, opcode, cycles);
+            if(sampler) sampler->tick(PC, SP, cycles);
+            if(call_graph) call_graph->trap(SP, cycles);
+            return cycles;
+        }
+    }
+
+    PC_previous = PC;
+    opcode = fetch(PC++);
+
+    // Finds the related instruction in the decode table
+    instruction = decode_table[opcode];
+
+    // Resolves the addressing mode
+    (this->*instruction->addrmode)();
+
+    // Performs the opcode instruction
+    uint8_t taken = (this->*instruction->operation)();
+
+    if(TimingPolicy::exact) cycles = opcode_table[opcode].cycles[taken];
+    else                    cycles = opcode_table[opcode].cycles[0];
+
+    op_count ++;
+
+#ifdef FUZZ_COVERAGE
+    // AFL style edge coverage, only recorded at flow instructions
+    // so straight line code costs a single table lookup.
+    if(flow_op[opcode] && coverage_map)
+    {
+        uint16_t cur = (PC * 0x9E37u) >> 1;
+        coverage_map[(cur ^ coverage_prev) & (COVERAGE_MAP_SIZE-1)]++;
+        coverage_prev = cur >> 1;
+    }
+#endif
+
+#ifdef PROFILE_COUNTERS
+    if(profile) profile->record(PC_previous, opcode, cycles, flow_op[opcode]);
+#endif
+
+    if(sampler)
+    {
+        if(flow_op[opcode]) sampler->flow(opcode, PC_previous, PC, SP);
+        sampler->tick(PC, SP, cycles);
+    }
+
+    if(call_graph) call_graph->step(opcode, PC_previous, PC, SP, cycles, flow_op[opcode]);
+
+    if(tracer && tracer->filter.wants(PC_previous, opcode)) tracer->record(*this, PC_previous, opcode, cycles);
+
+    if(trace) print_CPU_detail();
+
+    return cycles;
+}
+
 // Connect to bus
 void i8080::connect_bus(Bus *new_bus)
 {
     bus = new_bus;
 };
 
+// Stops the run loop, e.g. on a BDOS system reset
+void i8080::stop()
+{
+    stopped = 1;
+}
+
+void i8080::reset_stop()
+{
+    stopped = 0;
+    debug_stop = DEBUG_NONE;
+}
+
+bool i8080::is_stopped()
+{
+    return stopped;
+}
+
+void i8080::set_trap(uint16_t addr, TrapHandler handler)
+{
+    traps[addr] = std::move(handler);
+    trap_map[addr] = 1;
+    fetch_map[addr] = 1;
+}
+
+void i8080::clear_trap(uint16_t addr)
+{
+    traps.erase(addr);
+    trap_map[addr] = 0;
+    fetch_map[addr] = breakpoint_map[addr];
+}
+
+bool i8080::has_trap(uint16_t addr)
+{
+    return trap_map[addr];
+}
+
+void i8080::set_breakpoint(uint16_t addr)
+{
+    breakpoint_map[addr] = 1;
+    fetch_map[addr] = 1;
+}
+
+void i8080::clear_breakpoint(uint16_t addr)
+{
+    breakpoint_map[addr] = 0;
+    fetch_map[addr] = trap_map[addr];
+}
+
+bool i8080::has_breakpoint(uint16_t addr)
+{
+    return breakpoint_map[addr];
+}
+
+void i8080::debug_break(DebugStop reason)
+{
+    debug_stop = reason;
+    stopped = 1;
+}
+
+i8080::DebugStop i8080::get_debug_stop()
+{
+    return debug_stop;
+}
+
+void i8080::resume()
+{
+    stopped = 0;
+    debug_stop = DEBUG_NONE;
+    break_pass = breakpoint_map[PC] ? PC : NO_BREAK_PASS;
+}
+
+// A trap counts as the RET ending the routine it replaces
+void i8080::run_trap()
+{
+    PC_previous = PC;
+    opcode = 0xC9;
+    instruction = decode_table[opcode];
+
+    if(traps[PC](*this))
+    {
+        PC = (read(SP+1)<<8) | read(SP);
+        SP += 2;
+    }
+
+    op_count++;
+    cycles = opcode_table[opcode].cycles[0];
+}
+
+// The opcode of the last executed instruction
+uint8_t i8080::get_opcode()
+{
+    return opcode;
+}
+
+bool i8080::implemented(uint8_t op)
+{
+    return decode_table[op] != &not_implemented;
+}
+
+i8080::Timing i8080::get_timing()
+{
+    return timing;
+}
+
+void i8080::save_state(StateWriter & out)
+{
+    out.put(A);
+    out.put(status);
+    out.put(B);
+    out.put(C);
+    out.put(D);
+    out.put(E);
+    out.put(H);
+    out.put(L);
+    out.put(SP);
+    out.put(PC);
+    out.put((uint8_t)interupts_enabled);
+    out.put(cycles);
+    out.put(clock_count);
+    out.put(op_count);
+}
+
+bool i8080::load_state(StateReader & in)
+{
+    uint8_t inte;
+    in.get(A);
+    in.get(status);
+    in.get(B);
+    in.get(C);
+    in.get(D);
+    in.get(E);
+    in.get(H);
+    in.get(L);
+    in.get(SP);
+    in.get(PC);
+    in.get(inte);
+    in.get(cycles);
+    in.get(clock_count);
+    in.get(op_count);
+
+    interupts_enabled = inte;
+    PC_previous = PC;
+    reset_stop();
+    break_pass = NO_BREAK_PASS;
+    return in.ok;
+}
+
 // Read from ram via bus
 uint8_t i8080::read(uint16_t addr)
 {
     return bus->read_from_ram(addr);
 }
 
+// Instruction bytes aren't data, so they skip the watchpoints
+uint8_t i8080::fetch(uint16_t addr)
+{
+    return bus->fetch_from_ram(addr);
+}
+
 // Write to ram via bus
 void i8080::write(uint16_t addr, uint8_t data)
 {
@@ -126,25 +359,26 @@ void i8080::print_CPU_detail()
     cout << "\t" << setfill('0') << setw(4) << hex << (int)(PC_previous);
     
     cout << "\t" << "0x" << setfill('0') << setw(2) << right << hex << (int)opcode;
-    cout << "\t" << instruction.alias;
+    cout << "\t" << mnemonic_names[opcode_table[opcode].mnemonic];
+    if(opcode_table[opcode].registers[0]) cout << " " << opcode_table[opcode].registers;
 
     // This horrible block prints the data that follows an instruction if relevant
-    if(this->instruction.addrmode==&i8080::IM8) {
+    if(this->instruction->addrmode==&i8080::IM8) {
         cout << "\t" << setfill('0') << setw(2) << hex << (int)(byte2);       
     }
-    else if(this->instruction.addrmode==&i8080::IM16) {
+    else if(this->instruction->addrmode==&i8080::IM16) {
         cout << "\t" << setfill('0') << setw(4) << hex << (int)((byte3<<8) | byte2);             
     }
-    else if(this->instruction.addrmode==(&i8080::RGI8M) | this->instruction.addrmode==(&i8080::RGI8r)) {
+    else if(this->instruction->addrmode==(&i8080::RGI8M) | this->instruction->addrmode==(&i8080::RGI8r)) {
         cout << "\t" << setfill('0') << setw(4) << hex << (int)(rp_addr);             
     }
-    else if(this->instruction.addrmode==&i8080::RGI16) {
+    else if(this->instruction->addrmode==&i8080::RGI16) {
         cout << "\t" << setfill('0') << setw(4) << hex << (int)(rp_val);             
     }
-    else if(this->instruction.addrmode==&i8080::IMRI) {
+    else if(this->instruction->addrmode==&i8080::IMRI) {
         cout << "\t" << setfill('0') << setw(4) << hex << (int)rp_addr << "/" << setw(2) << (int)byte2;             
     }
-    else if(this->instruction.addrmode==&i8080::DIR) {
+    else if(this->instruction->addrmode==&i8080::DIR) {
         switch(opcode)
         {
             case 0xd3: cout << "\t" << setfill('0') << setw(2) << hex << (int)byte2;
@@ -188,7 +422,7 @@ uint8_t i8080::DIR()
         // Special functions like OUT use direct addressing differently
         // so clumsy exceptions are included above default behaviour.
         case 0xd3: // OUT
-            byte2 = read(PC);
+            byte2 = fetch(PC);
             PC++;
 
             // Output ports haven't been implemented yet, so for
@@ -213,7 +447,7 @@ uint8_t i8080::DIR()
 // Returns either a single byte (data) or 2 byte (address) value
 uint8_t i8080::IM8()
 {
-    byte2 = read(PC);
+    byte2 = fetch(PC);
     PC++;
 
     return 0;
@@ -221,9 +455,9 @@ uint8_t i8080::IM8()
 
 uint8_t i8080::IM16()
 {
-    byte2 = read(PC);
+    byte2 = fetch(PC);
     PC++;
-    byte3 = read(PC);
+    byte3 = fetch(PC);
     PC++;
 
     return 0;
@@ -421,6 +655,7 @@ uint8_t i8080::RGD()
         case 0xf5: rh=&A; rl=&status; break; // PUSH PSW
         case 0xf9: rh=&H; rl=&L; break; // SPHL 
     }
+    return 0;
 };
 
 // Address mode: Register indirect from memory (RP address)
@@ -499,7 +734,6 @@ uint8_t i8080::ACI()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 7;
     return 0;
 }
 
@@ -523,7 +757,6 @@ uint8_t i8080::ADCr()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 4;
     return 0;
 }
 
@@ -547,7 +780,6 @@ uint8_t i8080::ADCM()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 7;
     return 0;
 }
 
@@ -568,7 +800,6 @@ uint8_t i8080::ADDr()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 4;
     return 0;
 }
 
@@ -589,7 +820,6 @@ uint8_t i8080::ADDM()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 7;
     return 0;
 }
 
@@ -610,7 +840,6 @@ uint8_t i8080::ADI()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 7;
     return 0;
 }
 
@@ -629,7 +858,6 @@ uint8_t i8080::ANAr()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 4;
     return 0;
 }
 
@@ -648,7 +876,6 @@ uint8_t i8080::ANAM()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 7;
     return 0;
 }
 
@@ -667,33 +894,19 @@ uint8_t i8080::ANI()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 7;
     return 0;
 }
 
 // Instruction: Call
 uint8_t i8080::CALL()
 {
-#ifdef CPUDIAG
-    if (((byte3<<8)|byte2) == 5)
-    {
-        stopped=1;
-        bus->bdos_request(C, D, E);
-    }
-    else    
-
-#endif   
-
-    {  
-        //cout << "Standard call function" << endl;
-        write(SP-1, (PC>>8));
-        write(SP-2, (PC&0x00FF));
-        SP -= 2;      
-     
-        PC = (byte3<<8)|byte2;
-    }   
+    // BDOS calls are served by the trap at 0005
+    write(SP-1, (PC>>8));
+    write(SP-2, (PC&0x00FF));
+    SP -= 2;      
+ 
+    PC = (byte3<<8)|byte2;
 
-    cycles = 17;
     return 0;
 }
 
@@ -720,15 +933,10 @@ uint8_t i8080::Cc()
         SP -= 2;      
         
         PC = (byte3<<8)|byte2;
-
-        cycles = 17;
-        return 0;
-    }
-    else
-    {
-        cycles = 11;
-        return 0;
+        return 1;
     }
+
+    return 0;
 }
 
 // Instruction: Complement Accumulator
@@ -736,7 +944,6 @@ uint8_t i8080::CMA()
 {
     A ^= 0xFF;
 
-    cycles = 4;
     return 0;
 }
 
@@ -745,7 +952,6 @@ uint8_t i8080::CMC()
 {
     status ^= CY;
 
-    cycles = 4;
     return 0;
 }
 
@@ -765,7 +971,6 @@ uint8_t i8080::CMPr()
     // Sign - Bit 7
     set_flag(S, ((temp_val&0x80) > 0));
 
-    cycles = 4;
     return 0;
 }
 
@@ -785,7 +990,6 @@ uint8_t i8080::CMPM()
     // Sign - Bit 7
     set_flag(S, ((temp_val&0x80) > 0));
 
-    cycles = 4;
     return 0;
 }
 
@@ -807,7 +1011,6 @@ uint8_t i8080::CPI()
     // Sign - Bit 7
     set_flag(S, ((r&0x80) > 0));
 
-    cycles = 7;
     return 0;
 }
 
@@ -817,7 +1020,6 @@ uint8_t i8080::DAA()
 {
     // Does nothing for now
 
-    cycles = 4;
     return 0;
 }
 
@@ -843,7 +1045,6 @@ uint8_t i8080::DAD()
 
     set_flag(CY, (temp_sum & 0xFFFF0000) > 0);
 
-    cycles = 10;
     return 0;
 }
 
@@ -862,7 +1063,6 @@ uint8_t i8080::DCR()
     // Sign - Bit 7
     set_flag(S, ((*r&0x80) > 0));
 
-    cycles = 5;
     return 0;
 }
 
@@ -884,8 +1084,6 @@ uint8_t i8080::DCRM()
     // Sign - Bit 7
     set_flag(S, ((temp_rp&0x80) > 0));
 
-
-    cycles = 10;
     return 0;
 }
 
@@ -918,8 +1116,6 @@ uint8_t i8080::DCX()
     // Sign - Bit 7
     set_flag(S, ((temp_rp&0x80) > 0));
 
-
-    cycles = 10;
     return 0;
 }
 
@@ -928,7 +1124,6 @@ uint8_t i8080::EI()
 {
     interupts_enabled = 1;
 
-    cycles = 4;
     return 0;
 }
 
@@ -946,8 +1141,6 @@ uint8_t i8080::INR()
     // Sign - Bit 7
     set_flag(S, ((*r&0x80) > 0));
 
-
-    cycles = 5;
     return 0;
 }
 
@@ -969,8 +1162,6 @@ uint8_t i8080::INRM()
     // Sign - Bit 7
     set_flag(S, ((temp_rp&0x80) > 0));
 
-
-    cycles = 10;
     return 0;
 }
 
@@ -994,7 +1185,6 @@ uint8_t i8080::INX()
         *rl = temp_pair & 0x00FF;
     }
 
-    cycles = 5;
     return 0;
 }
 
@@ -1019,7 +1209,6 @@ uint8_t i8080::JMP()
         case 0xfa: if(get_flag(S))  PC = addr; break;   // JM
      }
 
-    cycles = 10;
     return 0;
 }
 
@@ -1029,7 +1218,6 @@ uint8_t i8080::LDA()
     // The register pair is derived in the addressing mode
     A = addr_val;
 
-    cycles = 13;
     return 0;
 }
 
@@ -1039,7 +1227,6 @@ uint8_t i8080::LDAX()
     // The register pair is derived in the addressing mode
     A = rp_val;
 
-    cycles = 7;
     return 0;
 }
 
@@ -1050,7 +1237,6 @@ uint8_t i8080::LHLD()
     L = read(data_address);
     H = read(data_address + 1);
 
-    cycles = 16;
     return 0;
 }
 
@@ -1069,7 +1255,6 @@ uint8_t i8080::LXI()
         case 0x31: SP = (byte3<<8)|byte2; break;
     }
 
-    cycles = 10;
     return 0;
 }
 
@@ -1078,7 +1263,7 @@ uint8_t i8080::MOV()
 {
     *r1=*r2;
 
-    cycles = 7;
+    return 0;
 }
 
 // Instruction: Move to/from memory
@@ -1105,7 +1290,7 @@ uint8_t i8080::MOVM()
         case 0x7e: A=rp_val; break;
     }
 
-    cycles = 7;
+    return 0;
 }
 
 // Instruction: Move to register immediate
@@ -1122,7 +1307,6 @@ uint8_t i8080::MVI()
         case 0x3e: A=byte2; break;
     }
 
-    cycles = 7;
     return 0;
 }
 
@@ -1131,14 +1315,12 @@ uint8_t i8080::MVIM()
 { 
     write(rp_addr, byte2);
 
-    cycles = 10;
     return 0;
 }
 
 // Instruction: No operation
 uint8_t i8080::NOP()
 {
-    cycles = 4;
     return 0;
 }
 
@@ -1159,7 +1341,6 @@ uint8_t i8080::ORAr()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 4;
     return 0;
 }
 
@@ -1180,7 +1361,6 @@ uint8_t i8080::ORAM()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 7;
     return 0;
 }
 
@@ -1201,7 +1381,6 @@ uint8_t i8080::ORI()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 7;
     return 0;
 }
 
@@ -1213,17 +1392,15 @@ uint8_t i8080::OUT()
     // implementation *port is just a nullptr.
     //*port = A;
 
-    cycles = 10;
     return 0;
 }
 
 // Instruction: Jump H and L indirect
 uint8_t i8080::PCHL()
 {
-    uint16_t data_address = (byte3<<8) | byte2;
+    uint16_t data_address = (*rh<<8) | *rl;
     PC = data_address;
 
-    cycles = 5;
     return 0;
 }
 
@@ -1235,7 +1412,6 @@ uint8_t i8080::POP()
 
     SP += 2;
     
-    cycles = 10;
     return 0;  
 }
 
@@ -1248,7 +1424,6 @@ uint8_t i8080::POPpsw()
     A = read((SP+1));
     SP += 2;
     
-    cycles = 10;
     return 0;  
 }
 
@@ -1259,7 +1434,6 @@ uint8_t i8080::PUSHrp()
     write(SP-2, *rl);
     SP -= 2;
     
-    cycles = 11;
     return 0;  
 }
 
@@ -1282,7 +1456,6 @@ uint8_t i8080::SBBr()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 4;
     return 0;
 }
 
@@ -1305,7 +1478,6 @@ uint8_t i8080::SBBM()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 7;
     return 0;
 }
 
@@ -1328,7 +1500,6 @@ uint8_t i8080::SBI()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 7;
     return 0;
 }
 
@@ -1339,7 +1510,6 @@ uint8_t i8080::SHLD()
     write(data_address, L);
     write(data_address+1, H);
 
-    cycles = 16;
     return 0;
 }
 
@@ -1349,7 +1519,6 @@ uint8_t i8080::SPHL()
     uint16_t temp_addr = (*rh<<8) | *rl;
     SP = temp_addr;
 
-    cycles = 5;
     return 0;
 }
 
@@ -1359,7 +1528,6 @@ uint8_t i8080::STA()
     // The register pair is derived in the addressing mode
     write(dir_addr, A);
 
-    cycles = 13;
     return 0;
 }
 
@@ -1369,7 +1537,6 @@ uint8_t i8080::STAX()
     // The register pair is derived in the addressing mode
     write(rp_addr, A);
 
-    cycles = 7;
     return 0;
 }
 
@@ -1378,7 +1545,6 @@ uint8_t i8080::STC()
 {
     set_flag(CY, 1);
 
-    cycles = 4;
     return 0;
 }
 
@@ -1398,7 +1564,6 @@ uint8_t i8080::SUBr()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 4;
     return 0;
 }
 
@@ -1418,7 +1583,6 @@ uint8_t i8080::SUBM()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 7;
     return 0;
 }
 
@@ -1438,7 +1602,6 @@ uint8_t i8080::SUI()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 7;
     return 0;
 }
 
@@ -1457,7 +1620,6 @@ uint8_t i8080::RAL()
     set_flag(CY, (temp_A7 > 0));
     A |= temp_CY;
 
-    cycles = 4;
     return 0;
 }
 
@@ -1476,7 +1638,6 @@ uint8_t i8080::RAR()
     set_flag(CY, (temp_A0 > 0));
     A |= (temp_CY<<7);
 
-    cycles = 4;
     return 0;
 }
 
@@ -1500,15 +1661,10 @@ uint8_t i8080::Rc()
     {
         PC = rp_val;
         SP += 2;
-        
-        cycles = 11;
-        return 0;
-    }    
-    else
-    {
-        cycles = 5;
-        return 0;
+        return 1;
     }
+
+    return 0;
 }
 
 // Instruction: Return
@@ -1517,7 +1673,6 @@ uint8_t i8080::RET()
     PC = rp_val;
     SP += 2;
     
-    cycles = 10;
     return 0;
 }
 
@@ -1537,7 +1692,6 @@ uint8_t i8080::RLC()
     // Move old A7 to A0
     A = A|(temp_A7>>7);
 
-    cycles = 4;
     return 0;
 }
 
@@ -1557,7 +1711,6 @@ uint8_t i8080::RRC()
     // Move old A0 to A7
     A = A|(temp_A0<<7);
 
-    cycles = 4;
     return 0;
 }
 
@@ -1572,7 +1725,6 @@ uint8_t i8080::XCHG()
     D=temp_H;
     E=temp_L;
 
-    cycles = 4;
     return 0;
 }
 
@@ -1591,7 +1743,6 @@ uint8_t i8080::XRAr()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 4;
     return 0;
 }
 
@@ -1610,7 +1761,6 @@ uint8_t i8080::XRAM()
     // Sign - Bit 7
     set_flag(S, ((A&0x80) > 0));
 
-    cycles = 7;
     return 0;
 }
 
@@ -1632,7 +1782,6 @@ uint8_t i8080::XRI()
     set_flag(S, ((A&0x80) > 0));
     //
 
-    cycles = 7;
     return 0;
 }
 
@@ -1648,13 +1797,12 @@ uint8_t i8080::XTHL()
     write(SP+1, temp_H);
     write(SP, temp_L);
 
-    cycles = 18;
     return 0;
 }
 
 // Instruction: Not implemented
 uint8_t i8080::NotImplemented()
 {
-    cycles = 1;
+    stopped = 1;
     return 0;
 }
\ No newline at end of file
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <array>
+#include <bitset>
 #include <cstdint>
+#include <functional>
 #include <map>
 #include <string>
 #include <unordered_map>
@@ -12,18 +14,68 @@
 // Forward declaration of the bus class
 // only use as a pointer so minimises #include usage
 class Bus;
+class ExecutionProfile;
+class SamplingProfiler;
+class CallGraphProfiler;
+class TraceWriter;
+class StateWriter;
+class StateReader;
 
 class i8080
 {
     public:
-        i8080();
+        // How the core keeps time, fixed when it is built so the run loop
+        // never tests it. CYCLE_EXACT charges each instruction its data
+        // sheet cycles, the taken forms of Ccc and Rcc included. FAST
+        // charges every opcode its untaken count, all a host pacing or
+        // polling by cycles needs.
+        enum Timing { CYCLE_EXACT, FAST };
+
+        i8080(Timing timing = CYCLE_EXACT);
         ~i8080();
 
     public:
         bool clock();
+        uint8_t step();
         void connect_bus(Bus *new_bus);
         uint8_t get_cpu_reg(uint8_t r);
 
+        // Run state, used by hosts driving the core with step()
+        void stop();
+        void reset_stop();
+        bool is_stopped();
+        uint8_t get_opcode();
+        bool implemented(uint8_t op);
+        Timing get_timing();
+
+        // Host traps run a native handler in place of the guest code at
+        // an address, e.g. the BDOS entry or BIOS jump table slots. The
+        // handler returns 1 to return to the caller as a RET would, or 0
+        // if it has set PC itself. A handler must not remove its own trap.
+        using TrapHandler = std::function<bool(i8080 & cpu)>;
+        void set_trap(uint16_t addr, TrapHandler handler);
+        void clear_trap(uint16_t addr);
+        bool has_trap(uint16_t addr);
+
+        // Debugger stops. A breakpoint stops the CPU before the
+        // instruction at its address runs, step() returning 0 cycles.
+        // Watchpoints are kept by the Bus, which stops the CPU through
+        // debug_break() once the instruction touching them has run.
+        enum DebugStop : uint8_t { DEBUG_NONE, DEBUG_BREAKPOINT, DEBUG_WATCHPOINT };
+        void set_breakpoint(uint16_t addr);
+        void clear_breakpoint(uint16_t addr);
+        bool has_breakpoint(uint16_t addr);
+        void debug_break(DebugStop reason);
+        DebugStop get_debug_stop();
+
+        // Clears the stop and lets a breakpoint at PC run once
+        void resume();
+
+        // Registers, flags, interrupt enable and cycle counters, for save
+        // states (savestate.h). A loaded CPU is never stopped.
+        void save_state(StateWriter & out);
+        bool load_state(StateReader & in);
+
     public:
         // Bus
         Bus *bus = nullptr;
@@ -39,6 +91,31 @@ class i8080
         uint8_t status = 0x00;  // The 'flag register' status (F)
         uint16_t PC = 0x0000;
         uint16_t SP = 0x0000;
+
+        // Prints the CPU detail line after every instruction
+        bool trace = 1;
+
+        // Edge coverage bitmap, only recorded when built with FUZZ_COVERAGE.
+        // The map is owned by the host (e.g. an AFL shared memory segment).
+        static const uint32_t COVERAGE_MAP_SIZE = 1 << 16;
+        uint8_t * coverage_map = nullptr;
+        uint16_t coverage_prev = 0x0000;
+
+        // Per opcode, PC and block counters, only recorded when built with
+        // PROFILE_COUNTERS. Owned by the host.
+        ExecutionProfile * profile = nullptr;
+
+        // Periodic PC and call stack samples, always compiled in as it
+        // costs a null check when unset. Owned by the host.
+        SamplingProfiler * sampler = nullptr;
+
+        // Inclusive and exclusive cycles per routine and the call graph.
+        // Owned by the host.
+        CallGraphProfiler * call_graph = nullptr;
+
+        // Binary instruction trace, for comparing with other emulators.
+        // Owned by the host.
+        TraceWriter * tracer = nullptr;
         
         // Array of pointers to registers, currently only
         // used for fault finding print functions
@@ -60,6 +137,7 @@ class i8080
     private:
         // Bus related instructions
         uint8_t read(uint16_t addr);
+        uint8_t fetch(uint16_t addr);
         void    write(uint16_t addr, uint8_t data);
 
         // Private CPU related functions
@@ -71,6 +149,19 @@ class i8080
         // Internal print instructions
         void print_CPU_detail();
 
+        // Runs the trap handler at PC
+        void run_trap();
+
+        // One core per timing policy, generated from the same handlers.
+        // step() calls the one chosen at construction.
+        struct ExactTiming { static const bool exact = 1; };
+        struct FastTiming  { static const bool exact = 0; };
+
+        template<class TimingPolicy> uint8_t execute();
+
+        Timing timing;
+        uint8_t (i8080::*core)() = nullptr;
+
         // Emulation variables
         uint32_t clock_count = 0;       // Total accumulated clock functions
         uint16_t op_count = 0;          // Total number of operations that have occured  
@@ -108,259 +199,280 @@ class i8080
         uint8_t * rl;   // Register low (16-bit memory ops)
         uint8_t * rh;   // Register high (16-bit memory ops)
 
-        // Data struction for opcode instructions
+        // Data struction for opcode instructions. Operations return 1 when
+        // a conditional call or return is taken, the cycles are looked up
+        // in the opcode table (opcodes.h).
         struct Instruction
         {
-            std::string alias;
             uint8_t (i8080::*operation)(void) = nullptr;
             uint8_t (i8080::*addrmode)(void) = nullptr;
         };
 
-        // A forward declaration use for extraction of instructions
-        // from the instruction table below
-        Instruction instruction;
+        // The instruction currently being executed, taken from the
+        // dense decode table built from the instruction map below
+        const Instruction * instruction = nullptr;
+        std::array<const Instruction *, 256> decode_table;
+
+        // One bit per address marks the PCs with a trap or breakpoint,
+        // so the fetch only pays a bit test. The trap handlers and the
+        // breakpoints are looked up once a bit is set.
+        std::bitset<64*1024> fetch_map;
+        std::bitset<64*1024> trap_map;
+        std::bitset<64*1024> breakpoint_map;
+        std::unordered_map<uint16_t, TrapHandler> traps;
+
+        // Why the debugger stopped the CPU, and the breakpoint resumed
+        // from, which runs once
+        DebugStop debug_stop = DEBUG_NONE;
+        uint32_t break_pass = NO_BREAK_PASS;
+        static const uint32_t NO_BREAK_PASS = 0x10000;
+
+        // Marks opcodes that can change the flow of control (jumps,
+        // calls, returns, RST and PCHL), used for edge coverage
+        std::array<bool, 256> flow_op;
 
-        // Map containing opcode details.
+        // Map containing opcode details. Names and lengths are in the
+        // shared opcode table (opcodes.h).
         using a = i8080;
         const std::unordered_map<uint8_t, Instruction> instructions
         {
-            {0x00, {"NOP",      &a::NOP,    &a::IMP}},
-            {0x01, {"LXI BC",   &a::LXI,    &a::IM16}},
-            {0x02, {"STAX BC",  &a::STAX,   &a::RGI8r}},
-            {0x03, {"INX BC",   &a::INX,    &a::RGD}},
-            {0x04, {"INR B",    &a::INR,    &a::RGD}},              
-            {0x05, {"DCR B",    &a::DCR,    &a::RGD}},
-            {0x06, {"MVI B,d",  &a::MVI,    &a::IM8}},
-            {0x07, {"RLC",      &a::RLC,    &a::IMP}},          
-            {0x09, {"DAD B",    &a::DAD,    &a::RGD}},
-            {0x0a, {"LDAX BE",  &a::LDAX,   &a::RGI8r}},             
-            {0x0b, {"DCX BC",   &a::DCX,    &a::RGD}},           
-            {0x0c, {"INR C",    &a::INR,    &a::RGD}},                         
-            {0x0d, {"DCR C",    &a::DCR,    &a::RGD}},            
-            {0x0e, {"MVI C,d",  &a::MVI,    &a::IM8}},
-            {0x0f, {"RRC",      &a::RRC,    &a::IMP}},
-            {0x11, {"LXI DE",   &a::LXI,    &a::IM16}}, 
-            {0x12, {"STAX DE",  &a::STAX,   &a::RGI8r}},            
-            {0x13, {"INX DE",   &a::INX,    &a::RGD}},
-            {0x14, {"INR D",    &a::INR,    &a::RGD}},                         
-            {0x15, {"DCR D",    &a::DCR,    &a::RGD}},             
-            {0x16, {"MVI D,d",  &a::MVI,    &a::IM8}},           
-            {0x17, {"RAL",      &a::RAL,    &a::IMP}},           
-            {0x19, {"DAD D",    &a::DAD,    &a::RGD}},
-            {0x1a, {"LDAX D",   &a::LDAX,   &a::RGI8r}}, 
-            {0x1b, {"DCX DE",   &a::DCX,    &a::RGD}},               
-            {0x1c, {"INR E",    &a::INR,    &a::RGD}},                         
-            {0x1d, {"DCR E",    &a::DCR,    &a::RGD}},             
-            {0x1e, {"MVI E,d",  &a::MVI,    &a::IM8}},             
-            {0x1f, {"RAR",      &a::RAR,    &a::IMP}},                        
-            {0x21, {"LXI HL",   &a::LXI,    &a::IM16}},
-            {0x22, {"SHLD",     &a::SHLD,   &a::IM16}},            
-            {0x23, {"INX HL",   &a::INX,    &a::RGD}},  
-            {0x24, {"INR H",    &a::INR,    &a::RGD}},                         
-            {0x25, {"DCR H",    &a::DCR,    &a::RGD}},                         
-            {0x26, {"MVI H,d",  &a::MVI,    &a::IM8}},
-            {0x27, {"DAA",      &a::DAA,    &a::IMP}},                  
-            {0x29, {"DAD HL",   &a::DAD,    &a::RGD}},
-            {0x2a, {"LHLD",     &a::LHLD,   &a::IM16}},
-            {0x2b, {"DCX HL",   &a::DCX,    &a::RGD}}, 
-            {0x2c, {"INR L",    &a::INR,    &a::RGD}},                         
-            {0x2d, {"DCR L",    &a::DCR,    &a::RGD}},  
-            {0x2e, {"MVI L,d",  &a::MVI,    &a::IM8}}, 
-            {0x2f, {"CMA",      &a::CMA,    &a::IMP}}, 
-            {0x31, {"LXI SP",   &a::LXI,    &a::IM16}},
-            {0x32, {"STA adr",  &a::STA,    &a::DIR}},  
-            {0x33, {"INX SP",   &a::INX,    &a::RGD}},             
-            {0x34, {"INR M",    &a::INRM,   &a::IMP}}, // RGI, but implemented as IMP
-            {0x35, {"DCR M",    &a::DCRM,   &a::IMP}}, // RGI, but implemented as IMP
-            {0x36, {"MVI M,d",  &a::MVIM,   &a::IMRI}},
-            {0x37, {"STC",      &a::STC,    &a::IMP}},                      
-            {0x39, {"DAD SP",   &a::DAD,    &a::RGD}},            
-            {0x3a, {"LDA adr",  &a::LDA,    &a::DIR}}, 
-            {0x3b, {"DCX SP",   &a::DCX,    &a::RGD}},             
-            {0x3c, {"INR A",    &a::INR,    &a::RGD}},                                   
-            {0x3d, {"DCR A",    &a::DCR,    &a::RGD}},              
-            {0x3e, {"MVI A,d",  &a::MVI,    &a::IM8}}, 
-            {0x3f, {"CMC",      &a::CMC,    &a::IMP}},             
-            {0x40, {"MOV B,B",  &a::MOV,    &a::RGD}},               
-            {0x41, {"MOV B,C",  &a::MOV,    &a::RGD}},
-            {0x42, {"MOV B,D",  &a::MOV,    &a::RGD}},
-            {0x43, {"MOV B,E",  &a::MOV,    &a::RGD}},
-            {0x44, {"MOV B,H",  &a::MOV,    &a::RGD}},
-            {0x45, {"MOV B,L",  &a::MOV,    &a::RGD}},
-            {0x46, {"MOV B,M",  &a::MOVM,   &a::RGI8M}}, 
-            {0x47, {"MOV B,A",  &a::MOV,    &a::RGD}},               
-            {0x48, {"MOV C,B",  &a::MOV,    &a::RGD}},             
-            {0x49, {"MOV C,C",  &a::MOV,    &a::RGD}},                      
-            {0x4a, {"MOV C,D",  &a::MOV,    &a::RGD}},             
-            {0x4b, {"MOV C,E",  &a::MOV,    &a::RGD}},               
-            {0x4c, {"MOV C,H",  &a::MOV,    &a::RGD}},             
-            {0x4d, {"MOV C,L",  &a::MOV,    &a::RGD}},               
-            {0x4e, {"MOV C,M",  &a::MOVM,   &a::RGI8M}},             
-            {0x4f, {"MOV C,A",  &a::MOV,    &a::RGD}},    
-            {0x50, {"MOV D,B",  &a::MOV,    &a::RGD}},
-            {0x51, {"MOV D,C",  &a::MOV,    &a::RGD}},
-            {0x52, {"MOV D,D",  &a::MOV,    &a::RGD}},
-            {0x53, {"MOV D,E",  &a::MOV,    &a::RGD}},
-            {0x54, {"MOV D,H",  &a::MOV,    &a::RGD}},
-            {0x55, {"MOV D,L",  &a::MOV,    &a::RGD}},
-            {0x56, {"MOV D,M",  &a::MOVM,   &a::RGI8M}},            
-            {0x57, {"MOV D,A",  &a::MOV,    &a::RGD}},       
-            {0x58, {"MOV E,B",  &a::MOV,    &a::RGD}},
-            {0x59, {"MOV E,C",  &a::MOV,    &a::RGD}},
-            {0x5a, {"MOV E,D",  &a::MOV,    &a::RGD}},
-            {0x5b, {"MOV E,E",  &a::MOV,    &a::RGD}},
-            {0x5c, {"MOV E,H",  &a::MOV,    &a::RGD}},
-            {0x5d, {"MOV E,L",  &a::MOV,    &a::RGD}},
-            {0x5e, {"MOV E,M",  &a::MOVM,   &a::RGI8M}},
-            {0x5f, {"MOV E,A",  &a::MOV,    &a::RGD}},
-            {0x60, {"MOV H,b",  &a::MOV,    &a::RGD}},           
-            {0x61, {"MOV H,C",  &a::MOV,    &a::RGD}},
-            {0x62, {"MOV H,D",  &a::MOV,    &a::RGD}},
-            {0x63, {"MOV H,E",  &a::MOV,    &a::RGD}},
-            {0x64, {"MOV H,H",  &a::MOV,    &a::RGD}},
-            {0x65, {"MOV H,L",  &a::MOV,    &a::RGD}},
-            {0x66, {"MOV H,M",  &a::MOVM,   &a::RGI8M}},
-            {0x67, {"MOV H,A",  &a::MOV,    &a::RGD}},       
-            {0x68, {"MOV L,B",  &a::MOV,    &a::RGD}},
-            {0x69, {"MOV L,C",  &a::MOV,    &a::RGD}},
-            {0x6a, {"MOV L,D",  &a::MOV,    &a::RGD}},
-            {0x6b, {"MOV L,E",  &a::MOV,    &a::RGD}},
-            {0x6c, {"MOV L,H",  &a::MOV,    &a::RGD}},
-            {0x6d, {"MOV L,L",  &a::MOV,    &a::RGD}},
-            {0x6e, {"MOV L,M",  &a::MOVM,   &a::RGI8M}},
-            {0x6f, {"MOV L,A",  &a::MOV,    &a::RGD}},
-            {0x70, {"MOV M,B",  &a::MOVM,   &a::RGI8M}},              
-            {0x71, {"MOV M,C",  &a::MOVM,   &a::RGI8M}},  
-            {0x72, {"MOV M,D",  &a::MOVM,   &a::RGI8M}}, 
-            {0x73, {"MOV M,E",  &a::MOVM,   &a::RGI8M}}, 
-            {0x74, {"MOV M,H",  &a::MOVM,   &a::RGI8M}}, 
-            {0x75, {"MOV M,L",  &a::MOVM,   &a::RGI8M}}, 
-            {0x77, {"MOV M,A",  &a::MOVM,   &a::RGI8M}},            
-            {0x78, {"MOV A,B",  &a::MOV,    &a::RGD}},
-            {0x79, {"MOV A,C",  &a::MOV,    &a::RGD}},
-            {0x7a, {"MOV A,D",  &a::MOV,    &a::RGD}},
-            {0x7b, {"MOV A,E",  &a::MOV,    &a::RGD}},            
-            {0x7c, {"MOV A,H",  &a::MOV,    &a::RGD}},
-            {0x7d, {"MOV A,L",  &a::MOV,    &a::RGD}},            
-            {0x7e, {"MOV A,M",  &a::MOVM,   &a::RGI8M}},
-            {0x7f, {"MOV A,A",  &a::MOV,    &a::RGD}},             
-            {0x80, {"ADD B",    &a::ADDr,   &a::RGD}},            
-            {0x81, {"ADD C",    &a::ADDr,   &a::RGD}},
-            {0x82, {"ADD D",    &a::ADDr,   &a::RGD}},
-            {0x83, {"ADD E",    &a::ADDr,   &a::RGD}},
-            {0x84, {"ADD H",    &a::ADDr,   &a::RGD}},
-            {0x85, {"ADD L",    &a::ADDr,   &a::RGD}},
-            {0x86, {"ADD M",    &a::ADDM,   &a::RGI8M}},            
-            {0x87, {"ADD A",    &a::ADDr,   &a::RGD}},
-            {0x88, {"ADC B",    &a::ADCr,   &a::RGD}},            
-            {0x89, {"ADC C",    &a::ADCr,   &a::RGD}},
-            {0x8a, {"ADC D",    &a::ADCr,   &a::RGD}},
-            {0x8b, {"ADC E",    &a::ADCr,   &a::RGD}},
-            {0x8c, {"ADC H",    &a::ADCr,   &a::RGD}},
-            {0x8d, {"ADC L",    &a::ADCr,   &a::RGD}},
-            {0x8e, {"ADC M",    &a::ADCM,   &a::RGI8M}},   
-            {0x8f, {"ADC A",    &a::ADCr,   &a::RGD}},       
-            {0x90, {"SUB B",    &a::SUBr,   &a::RGD}},                      
-            {0x91, {"SUB C",    &a::SUBr,   &a::RGD}},
-            {0x92, {"SUB D",    &a::SUBr,   &a::RGD}},
-            {0x93, {"SUB E",    &a::SUBr,   &a::RGD}},
-            {0x94, {"SUB H",    &a::SUBr,   &a::RGD}},         
-            {0x95, {"SUB L",    &a::SUBr,   &a::RGD}},
-            {0x96, {"SUB M",    &a::SUBM,   &a::RGI8M}},           
-            {0x97, {"SUB A",    &a::SUBr,   &a::RGD}},            
-            {0x98, {"SBB B",    &a::SBBr,   &a::RGD}},            
-            {0x99, {"SBB C",    &a::SBBr,   &a::RGD}},
-            {0x9a, {"SBB D",    &a::SBBr,   &a::RGD}},
-            {0x9b, {"SBB E",    &a::SBBr,   &a::RGD}},
-            {0x9c, {"SBB H",    &a::SBBr,   &a::RGD}},
-            {0x9d, {"SBB L",    &a::SBBr,   &a::RGD}},
-            {0x9e, {"SBB M",    &a::SBBM,   &a::RGI8M}},   
-            {0x9f, {"SBB A",    &a::SBBr,   &a::RGD}},                      
-            {0xa0, {"ANA B",    &a::ANAr,   &a::RGD}},
-            {0xa1, {"ANA C",    &a::ANAr,   &a::RGD}},
-            {0xa2, {"ANA D",    &a::ANAr,   &a::RGD}},
-            {0xa3, {"ANA E",    &a::ANAr,   &a::RGD}},
-            {0xa4, {"ANA H",    &a::ANAr,   &a::RGD}},
-            {0xa5, {"ANA L",    &a::ANAr,   &a::RGD}},
-            {0xa6, {"ANA M",    &a::ANAM,   &a::RGI8M}},  
-            {0xa7, {"ANA A",    &a::ANAr,   &a::RGD}},
-            {0xa8, {"XRA B",    &a::XRAr,   &a::RGD}},            
-            {0xa9, {"XRA C",    &a::XRAr,   &a::RGD}},
-            {0xaa, {"XRA D",    &a::XRAr,   &a::RGD}},
-            {0xab, {"XRA E",    &a::XRAr,   &a::RGD}},
-            {0xac, {"XRA H",    &a::XRAr,   &a::RGD}},
-            {0xad, {"XRA L",    &a::XRAr,   &a::RGD}},         
-            {0xae, {"XRA M",    &a::XRAM,   &a::RGI8M}},  
-            {0xaf, {"XRA A",    &a::XRAr,   &a::RGD}},
-            {0xb0, {"ORA B",    &a::ORAr,   &a::RGD}},
-            {0xb1, {"ORA C",    &a::ORAr,   &a::RGD}},
-            {0xb2, {"ORA D",    &a::ORAr,   &a::RGD}},
-            {0xb3, {"ORA E",    &a::ORAr,   &a::RGD}},
-            {0xb4, {"ORA H",    &a::ORAr,   &a::RGD}},
-            {0xb5, {"ORA L",    &a::ORAr,   &a::RGD}},
-            {0xb6, {"ORA M",    &a::ORAM,   &a::RGI8M}},
-            {0xb7, {"ORA A",    &a::ORAr,   &a::RGD}},
-            {0xb8, {"CMP B",    &a::CMPr,   &a::RGD}},            
-            {0xb9, {"CMP C",    &a::CMPr,   &a::RGD}},
-            {0xba, {"CMP D",    &a::CMPr,   &a::RGD}},
-            {0xbb, {"CMP E",    &a::CMPr,   &a::RGD}},
-            {0xbc, {"CMP H",    &a::CMPr,   &a::RGD}},
-            {0xbd, {"CMP L",    &a::CMPr,   &a::RGD}},         
-            {0xbe, {"CMP M",    &a::CMPM,   &a::RGI8M}},              
-            {0xbf, {"CMP A",    &a::CMPr,   &a::RGD}},     
-            {0xc0, {"RNZ",      &a::Rc,     &a::RGI16}},             
-            {0xc1, {"POP BC",   &a::POP,    &a::RGD}},  // This is listed as RGI, but is implemented as RGD
-            {0xc2, {"JNZ",      &a::JMP,    &a::IM16}},            
-            {0xc3, {"JMP",      &a::JMP,    &a::IM16}},
-            {0xc4, {"CNZ",      &a::Cc,     &a::IM16}},                 
-            {0xc5, {"PUSH B",   &a::PUSHrp, &a::RGD}},  // This is listed as RGI, but is implemented as RGD
-            {0xc6, {"ADI d",    &a::ADI,    &a::IM8}},          
-            {0xc8, {"RZ",       &a::Rc,     &a::RGI16}}, 
-            {0xc9, {"RET",      &a::RET,    &a::RGI16}},
-            {0xca, {"JZ",       &a::JMP,    &a::IM16}},        
-            {0xcc, {"CZ",       &a::Cc,     &a::IM16}},               
-            {0xcd, {"CALL",     &a::CALL,   &a::IM16}},
-            {0xce, {"ACI d",    &a::ACI,    &a::IM8}},
-            {0xd0, {"RNC",      &a::Rc,     &a::RGI16}},          
-            {0xd1, {"POP DE",   &a::POP,    &a::RGD}},  // This is listed as RGI, but is implemented as RGD
-            {0xd2, {"JNC",      &a::JMP,    &a::IM16}},
-            {0xd3, {"OUT 6",    &a::OUT,    &a::DIR}}, 
-            {0xd4, {"CNC",      &a::Cc,     &a::IM16}},             
-            {0xd5, {"PUSH D",   &a::PUSHrp, &a::RGD}},  // This is listed as RGI, but is implemented as RGD
-            {0xd6, {"SUI d",    &a::SUI,    &a::IM8}},           
-            {0xd8, {"RC",       &a::Rc,     &a::RGI16}},             
-            {0xda, {"JC",       &a::JMP,    &a::IM16}},          
-            {0xdc, {"CC",       &a::Cc,     &a::IM16}},                        
-            {0xde, {"SBI d",    &a::SBI,    &a::IM8}},            
-            {0xe0, {"RPO",      &a::Rc,     &a::RGI16}},         
-            {0xe1, {"POP HL",   &a::POP,    &a::RGD}},  // This is listed as RGI, but is implemented as RGD
-            {0xe2, {"JPO",      &a::JMP,    &a::IM16}},               
-            {0xe3, {"XTHL",     &a::XTHL,   &a::IMP}},  // Should be RGI, but implemented as IMP            
-            {0xe4, {"CPO",      &a::Cc,     &a::IM16}},             
-            {0xe5, {"PUSH HL",  &a::PUSHrp, &a::RGD}},  // This is listed as RGI, but is implemented as RGD
-            {0xe6, {"ANI d",    &a::ANI,    &a::IM8}},            
-            {0xe8, {"RPE",      &a::Rc,     &a::RGI16}},            
-            {0xe9, {"PCHL",     &a::PCHL,   &a::RGD}},              
-            {0xea, {"JPE",      &a::JMP,    &a::IM16}},         
-            {0xeb, {"XCHG",     &a::XCHG,   &a::RGD}},
-            {0xec, {"CPE",      &a::Cc,     &a::IM16}},             
-            {0xee, {"XRI d",    &a::XRI,    &a::IM8}},                
-            {0xf0, {"RP",       &a::Rc,     &a::RGI16}}, 
-            {0xf1, {"POP PSW",  &a::POPpsw, &a::IMP}},  // Listed as RGI, but implemented as IMP
-            {0xf2, {"JP",       &a::JMP,    &a::IM16}},
-            {0xf4, {"CP",       &a::Cc,     &a::IM16}},             
-            {0xf5, {"PSH PSW",  &a::PUSHrp, &a::RGD}},  // This is listed as RGI, but is implemented as RGD
-            {0xf6, {"ORI d",    &a::ORI,    &a::IM8}},                
-            {0xf8, {"RM",       &a::Rc,     &a::RGI16}}, 
-            {0xf9, {"SPHL",     &a::SPHL,   &a::RGD}}, 
-            {0xfa, {"JM adr",   &a::JMP,    &a::IM16}},
-            {0xfb, {"EI",       &a::EI,     &a::IMP}},
-            {0xfc, {"CM",       &a::Cc,     &a::IM16}},               
-            {0xfe, {"CPI A,d",  &a::CPI,    &a::IM8}},
+            {0x00, {&a::NOP,    &a::IMP}},
+            {0x01, {&a::LXI,    &a::IM16}},
+            {0x02, {&a::STAX,   &a::RGI8r}},
+            {0x03, {&a::INX,    &a::RGD}},
+            {0x04, {&a::INR,    &a::RGD}},              
+            {0x05, {&a::DCR,    &a::RGD}},
+            {0x06, {&a::MVI,    &a::IM8}},
+            {0x07, {&a::RLC,    &a::IMP}},          
+            {0x09, {&a::DAD,    &a::RGD}},
+            {0x0a, {&a::LDAX,   &a::RGI8r}},             
+            {0x0b, {&a::DCX,    &a::RGD}},           
+            {0x0c, {&a::INR,    &a::RGD}},                         
+            {0x0d, {&a::DCR,    &a::RGD}},            
+            {0x0e, {&a::MVI,    &a::IM8}},
+            {0x0f, {&a::RRC,    &a::IMP}},
+            {0x11, {&a::LXI,    &a::IM16}}, 
+            {0x12, {&a::STAX,   &a::RGI8r}},            
+            {0x13, {&a::INX,    &a::RGD}},
+            {0x14, {&a::INR,    &a::RGD}},                         
+            {0x15, {&a::DCR,    &a::RGD}},             
+            {0x16, {&a::MVI,    &a::IM8}},           
+            {0x17, {&a::RAL,    &a::IMP}},           
+            {0x19, {&a::DAD,    &a::RGD}},
+            {0x1a, {&a::LDAX,   &a::RGI8r}}, 
+            {0x1b, {&a::DCX,    &a::RGD}},               
+            {0x1c, {&a::INR,    &a::RGD}},                         
+            {0x1d, {&a::DCR,    &a::RGD}},             
+            {0x1e, {&a::MVI,    &a::IM8}},             
+            {0x1f, {&a::RAR,    &a::IMP}},                        
+            {0x21, {&a::LXI,    &a::IM16}},
+            {0x22, {&a::SHLD,   &a::IM16}},            
+            {0x23, {&a::INX,    &a::RGD}},  
+            {0x24, {&a::INR,    &a::RGD}},                         
+            {0x25, {&a::DCR,    &a::RGD}},                         
+            {0x26, {&a::MVI,    &a::IM8}},
+            {0x27, {&a::DAA,    &a::IMP}},                  
+            {0x29, {&a::DAD,    &a::RGD}},
+            {0x2a, {&a::LHLD,   &a::IM16}},
+            {0x2b, {&a::DCX,    &a::RGD}}, 
+            {0x2c, {&a::INR,    &a::RGD}},                         
+            {0x2d, {&a::DCR,    &a::RGD}},  
+            {0x2e, {&a::MVI,    &a::IM8}}, 
+            {0x2f, {&a::CMA,    &a::IMP}}, 
+            {0x31, {&a::LXI,    &a::IM16}},
+            {0x32, {&a::STA,    &a::DIR}},  
+            {0x33, {&a::INX,    &a::RGD}},             
+            {0x34, {&a::INRM,   &a::IMP}}, // RGI, but implemented as IMP
+            {0x35, {&a::DCRM,   &a::IMP}}, // RGI, but implemented as IMP
+            {0x36, {&a::MVIM,   &a::IMRI}},
+            {0x37, {&a::STC,    &a::IMP}},                      
+            {0x39, {&a::DAD,    &a::RGD}},            
+            {0x3a, {&a::LDA,    &a::DIR}}, 
+            {0x3b, {&a::DCX,    &a::RGD}},             
+            {0x3c, {&a::INR,    &a::RGD}},                                   
+            {0x3d, {&a::DCR,    &a::RGD}},              
+            {0x3e, {&a::MVI,    &a::IM8}}, 
+            {0x3f, {&a::CMC,    &a::IMP}},             
+            {0x40, {&a::MOV,    &a::RGD}},               
+            {0x41, {&a::MOV,    &a::RGD}},
+            {0x42, {&a::MOV,    &a::RGD}},
+            {0x43, {&a::MOV,    &a::RGD}},
+            {0x44, {&a::MOV,    &a::RGD}},
+            {0x45, {&a::MOV,    &a::RGD}},
+            {0x46, {&a::MOVM,   &a::RGI8M}}, 
+            {0x47, {&a::MOV,    &a::RGD}},               
+            {0x48, {&a::MOV,    &a::RGD}},             
+            {0x49, {&a::MOV,    &a::RGD}},                      
+            {0x4a, {&a::MOV,    &a::RGD}},             
+            {0x4b, {&a::MOV,    &a::RGD}},               
+            {0x4c, {&a::MOV,    &a::RGD}},             
+            {0x4d, {&a::MOV,    &a::RGD}},               
+            {0x4e, {&a::MOVM,   &a::RGI8M}},             
+            {0x4f, {&a::MOV,    &a::RGD}},    
+            {0x50, {&a::MOV,    &a::RGD}},
+            {0x51, {&a::MOV,    &a::RGD}},
+            {0x52, {&a::MOV,    &a::RGD}},
+            {0x53, {&a::MOV,    &a::RGD}},
+            {0x54, {&a::MOV,    &a::RGD}},
+            {0x55, {&a::MOV,    &a::RGD}},
+            {0x56, {&a::MOVM,   &a::RGI8M}},            
+            {0x57, {&a::MOV,    &a::RGD}},       
+            {0x58, {&a::MOV,    &a::RGD}},
+            {0x59, {&a::MOV,    &a::RGD}},
+            {0x5a, {&a::MOV,    &a::RGD}},
+            {0x5b, {&a::MOV,    &a::RGD}},
+            {0x5c, {&a::MOV,    &a::RGD}},
+            {0x5d, {&a::MOV,    &a::RGD}},
+            {0x5e, {&a::MOVM,   &a::RGI8M}},
+            {0x5f, {&a::MOV,    &a::RGD}},
+            {0x60, {&a::MOV,    &a::RGD}},           
+            {0x61, {&a::MOV,    &a::RGD}},
+            {0x62, {&a::MOV,    &a::RGD}},
+            {0x63, {&a::MOV,    &a::RGD}},
+            {0x64, {&a::MOV,    &a::RGD}},
+            {0x65, {&a::MOV,    &a::RGD}},
+            {0x66, {&a::MOVM,   &a::RGI8M}},
+            {0x67, {&a::MOV,    &a::RGD}},       
+            {0x68, {&a::MOV,    &a::RGD}},
+            {0x69, {&a::MOV,    &a::RGD}},
+            {0x6a, {&a::MOV,    &a::RGD}},
+            {0x6b, {&a::MOV,    &a::RGD}},
+            {0x6c, {&a::MOV,    &a::RGD}},
+            {0x6d, {&a::MOV,    &a::RGD}},
+            {0x6e, {&a::MOVM,   &a::RGI8M}},
+            {0x6f, {&a::MOV,    &a::RGD}},
+            {0x70, {&a::MOVM,   &a::RGI8M}},              
+            {0x71, {&a::MOVM,   &a::RGI8M}},  
+            {0x72, {&a::MOVM,   &a::RGI8M}}, 
+            {0x73, {&a::MOVM,   &a::RGI8M}}, 
+            {0x74, {&a::MOVM,   &a::RGI8M}}, 
+            {0x75, {&a::MOVM,   &a::RGI8M}}, 
+            {0x77, {&a::MOVM,   &a::RGI8M}},            
+            {0x78, {&a::MOV,    &a::RGD}},
+            {0x79, {&a::MOV,    &a::RGD}},
+            {0x7a, {&a::MOV,    &a::RGD}},
+            {0x7b, {&a::MOV,    &a::RGD}},            
+            {0x7c, {&a::MOV,    &a::RGD}},
+            {0x7d, {&a::MOV,    &a::RGD}},            
+            {0x7e, {&a::MOVM,   &a::RGI8M}},
+            {0x7f, {&a::MOV,    &a::RGD}},             
+            {0x80, {&a::ADDr,   &a::RGD}},            
+            {0x81, {&a::ADDr,   &a::RGD}},
+            {0x82, {&a::ADDr,   &a::RGD}},
+            {0x83, {&a::ADDr,   &a::RGD}},
+            {0x84, {&a::ADDr,   &a::RGD}},
+            {0x85, {&a::ADDr,   &a::RGD}},
+            {0x86, {&a::ADDM,   &a::RGI8M}},            
+            {0x87, {&a::ADDr,   &a::RGD}},
+            {0x88, {&a::ADCr,   &a::RGD}},            
+            {0x89, {&a::ADCr,   &a::RGD}},
+            {0x8a, {&a::ADCr,   &a::RGD}},
+            {0x8b, {&a::ADCr,   &a::RGD}},
+            {0x8c, {&a::ADCr,   &a::RGD}},
+            {0x8d, {&a::ADCr,   &a::RGD}},
+            {0x8e, {&a::ADCM,   &a::RGI8M}},   
+            {0x8f, {&a::ADCr,   &a::RGD}},       
+            {0x90, {&a::SUBr,   &a::RGD}},                      
+            {0x91, {&a::SUBr,   &a::RGD}},
+            {0x92, {&a::SUBr,   &a::RGD}},
+            {0x93, {&a::SUBr,   &a::RGD}},
+            {0x94, {&a::SUBr,   &a::RGD}},         
+            {0x95, {&a::SUBr,   &a::RGD}},
+            {0x96, {&a::SUBM,   &a::RGI8M}},           
+            {0x97, {&a::SUBr,   &a::RGD}},            
+            {0x98, {&a::SBBr,   &a::RGD}},            
+            {0x99, {&a::SBBr,   &a::RGD}},
+            {0x9a, {&a::SBBr,   &a::RGD}},
+            {0x9b, {&a::SBBr,   &a::RGD}},
+            {0x9c, {&a::SBBr,   &a::RGD}},
+            {0x9d, {&a::SBBr,   &a::RGD}},
+            {0x9e, {&a::SBBM,   &a::RGI8M}},   
+            {0x9f, {&a::SBBr,   &a::RGD}},                      
+            {0xa0, {&a::ANAr,   &a::RGD}},
+            {0xa1, {&a::ANAr,   &a::RGD}},
+            {0xa2, {&a::ANAr,   &a::RGD}},
+            {0xa3, {&a::ANAr,   &a::RGD}},
+            {0xa4, {&a::ANAr,   &a::RGD}},
+            {0xa5, {&a::ANAr,   &a::RGD}},
+            {0xa6, {&a::ANAM,   &a::RGI8M}},  
+            {0xa7, {&a::ANAr,   &a::RGD}},
+            {0xa8, {&a::XRAr,   &a::RGD}},            
+            {0xa9, {&a::XRAr,   &a::RGD}},
+            {0xaa, {&a::XRAr,   &a::RGD}},
+            {0xab, {&a::XRAr,   &a::RGD}},
+            {0xac, {&a::XRAr,   &a::RGD}},
+            {0xad, {&a::XRAr,   &a::RGD}},         
+            {0xae, {&a::XRAM,   &a::RGI8M}},  
+            {0xaf, {&a::XRAr,   &a::RGD}},
+            {0xb0, {&a::ORAr,   &a::RGD}},
+            {0xb1, {&a::ORAr,   &a::RGD}},
+            {0xb2, {&a::ORAr,   &a::RGD}},
+            {0xb3, {&a::ORAr,   &a::RGD}},
+            {0xb4, {&a::ORAr,   &a::RGD}},
+            {0xb5, {&a::ORAr,   &a::RGD}},
+            {0xb6, {&a::ORAM,   &a::RGI8M}},
+            {0xb7, {&a::ORAr,   &a::RGD}},
+            {0xb8, {&a::CMPr,   &a::RGD}},            
+            {0xb9, {&a::CMPr,   &a::RGD}},
+            {0xba, {&a::CMPr,   &a::RGD}},
+            {0xbb, {&a::CMPr,   &a::RGD}},
+            {0xbc, {&a::CMPr,   &a::RGD}},
+            {0xbd, {&a::CMPr,   &a::RGD}},         
+            {0xbe, {&a::CMPM,   &a::RGI8M}},              
+            {0xbf, {&a::CMPr,   &a::RGD}},     
+            {0xc0, {&a::Rc,     &a::RGI16}},             
+            {0xc1, {&a::POP,    &a::RGD}},  // This is listed as RGI, but is implemented as RGD
+            {0xc2, {&a::JMP,    &a::IM16}},            
+            {0xc3, {&a::JMP,    &a::IM16}},
+            {0xc4, {&a::Cc,     &a::IM16}},                 
+            {0xc5, {&a::PUSHrp, &a::RGD}},  // This is listed as RGI, but is implemented as RGD
+            {0xc6, {&a::ADI,    &a::IM8}},          
+            {0xc8, {&a::Rc,     &a::RGI16}}, 
+            {0xc9, {&a::RET,    &a::RGI16}},
+            {0xca, {&a::JMP,    &a::IM16}},        
+            {0xcc, {&a::Cc,     &a::IM16}},               
+            {0xcd, {&a::CALL,   &a::IM16}},
+            {0xce, {&a::ACI,    &a::IM8}},
+            {0xd0, {&a::Rc,     &a::RGI16}},          
+            {0xd1, {&a::POP,    &a::RGD}},  // This is listed as RGI, but is implemented as RGD
+            {0xd2, {&a::JMP,    &a::IM16}},
+            {0xd3, {&a::OUT,    &a::DIR}}, 
+            {0xd4, {&a::Cc,     &a::IM16}},             
+            {0xd5, {&a::PUSHrp, &a::RGD}},  // This is listed as RGI, but is implemented as RGD
+            {0xd6, {&a::SUI,    &a::IM8}},           
+            {0xd8, {&a::Rc,     &a::RGI16}},             
+            {0xda, {&a::JMP,    &a::IM16}},          
+            {0xdc, {&a::Cc,     &a::IM16}},                        
+            {0xde, {&a::SBI,    &a::IM8}},            
+            {0xe0, {&a::Rc,     &a::RGI16}},         
+            {0xe1, {&a::POP,    &a::RGD}},  // This is listed as RGI, but is implemented as RGD
+            {0xe2, {&a::JMP,    &a::IM16}},               
+            {0xe3, {&a::XTHL,   &a::IMP}},  // Should be RGI, but implemented as IMP            
+            {0xe4, {&a::Cc,     &a::IM16}},             
+            {0xe5, {&a::PUSHrp, &a::RGD}},  // This is listed as RGI, but is implemented as RGD
+            {0xe6, {&a::ANI,    &a::IM8}},            
+            {0xe8, {&a::Rc,     &a::RGI16}},            
+            {0xe9, {&a::PCHL,   &a::RGD}},              
+            {0xea, {&a::JMP,    &a::IM16}},         
+            {0xeb, {&a::XCHG,   &a::RGD}},
+            {0xec, {&a::Cc,     &a::IM16}},             
+            {0xee, {&a::XRI,    &a::IM8}},                
+            {0xf0, {&a::Rc,     &a::RGI16}}, 
+            {0xf1, {&a::POPpsw, &a::IMP}},  // Listed as RGI, but implemented as IMP
+            {0xf2, {&a::JMP,    &a::IM16}},
+            {0xf4, {&a::Cc,     &a::IM16}},             
+            {0xf5, {&a::PUSHrp, &a::RGD}},  // This is listed as RGI, but is implemented as RGD
+            {0xf6, {&a::ORI,    &a::IM8}},                
+            {0xf8, {&a::Rc,     &a::RGI16}}, 
+            {0xf9, {&a::SPHL,   &a::RGD}}, 
+            {0xfa, {&a::JMP,    &a::IM16}},
+            {0xfb, {&a::EI,     &a::IMP}},
+            {0xfc, {&a::Cc,     &a::IM16}},               
+            {0xfe, {&a::CPI,    &a::IM8}},
 
         };
         // The default instruction if the opcode isn't found
-        Instruction not_implemented = {"...", &a::NotImplemented, &a::IMP};
+        Instruction not_implemented = {&a::NotImplemented, &a::IMP};
 
     private:
         // Addressing modes
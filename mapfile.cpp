@@ -0,0 +1,73 @@
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapfile.h"
+
+MappedFile::MappedFile() {}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string & path, bool sequential)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) return 0;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return 0;
+    }
+
+    // The mapping stays valid once the descriptor is closed
+    bool ok = 1;
+    if(st.st_size > 0)
+    {
+        void * addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(addr == MAP_FAILED)
+        {
+            ok = 0;
+        }
+        else
+        {
+            map = (uint8_t *)addr;
+            map_size = st.st_size;
+            madvise(map, map_size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+        }
+    }
+    ::close(fd);
+    return ok;
+}
+
+void MappedFile::close()
+{
+    if(map) munmap(map, map_size);
+    map = nullptr;
+    map_size = 0;
+}
+
+const uint8_t * MappedFile::data()
+{
+    return map;
+}
+
+size_t MappedFile::size()
+{
+    return map_size;
+}
+
+void MappedFile::release(size_t offset)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t end = std::min(offset, map_size) / page * page;
+    if(map && end > 0) madvise(map, end, MADV_DONTNEED);
+}
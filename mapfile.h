@@ -0,0 +1,38 @@
+/*
+Read only memory mapped file. Tools read dumps, images and indexes in
+place through this instead of allocating and copying the whole file.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile
+{
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile & operator=(const MappedFile &) = delete;
+
+        // Returns false if the file can't be opened or mapped. An empty
+        // file opens with a null data pointer. Files read front to back
+        // are read ahead, others are left to page in on demand.
+        bool open(const std::string & path, bool sequential = 1);
+        void close();
+
+        const uint8_t * data();
+        size_t size();
+
+        // Drops the pages before offset from memory, for readers streaming
+        // through files larger than they want resident. They read back in
+        // from the file if touched again.
+        void release(size_t offset);
+
+    private:
+        uint8_t * map = nullptr;
+        size_t map_size = 0;
+};
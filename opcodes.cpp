@@ -0,0 +1,276 @@
+#include "opcodes.h"
+
+const OpcodeInfo opcode_table[256] =
+{
+    /* 00 */ {MN_NOP,          "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 01 */ {MN_LXI,          "B",     3, OPERAND_D16,  FLOW_NONE,          {10, 10}},
+    /* 02 */ {MN_STAX,         "B",     1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 03 */ {MN_INX,          "B",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 04 */ {MN_INR,          "B",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 05 */ {MN_DCR,          "B",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 06 */ {MN_MVI,          "B",     2, OPERAND_D8,   FLOW_NONE,          { 7,  7}},
+    /* 07 */ {MN_RLC,          "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 08 */ {MN_UNDOC_NOP,    "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 09 */ {MN_DAD,          "B",     1, OPERAND_NONE, FLOW_NONE,          {10, 10}},
+    /* 0a */ {MN_LDAX,         "B",     1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 0b */ {MN_DCX,          "B",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 0c */ {MN_INR,          "C",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 0d */ {MN_DCR,          "C",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 0e */ {MN_MVI,          "C",     2, OPERAND_D8,   FLOW_NONE,          { 7,  7}},
+    /* 0f */ {MN_RRC,          "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 10 */ {MN_UNDOC_NOP,    "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 11 */ {MN_LXI,          "D",     3, OPERAND_D16,  FLOW_NONE,          {10, 10}},
+    /* 12 */ {MN_STAX,         "D",     1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 13 */ {MN_INX,          "D",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 14 */ {MN_INR,          "D",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 15 */ {MN_DCR,          "D",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 16 */ {MN_MVI,          "D",     2, OPERAND_D8,   FLOW_NONE,          { 7,  7}},
+    /* 17 */ {MN_RAL,          "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 18 */ {MN_UNDOC_NOP,    "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 19 */ {MN_DAD,          "D",     1, OPERAND_NONE, FLOW_NONE,          {10, 10}},
+    /* 1a */ {MN_LDAX,         "D",     1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 1b */ {MN_DCX,          "D",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 1c */ {MN_INR,          "E",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 1d */ {MN_DCR,          "E",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 1e */ {MN_MVI,          "E",     2, OPERAND_D8,   FLOW_NONE,          { 7,  7}},
+    /* 1f */ {MN_RAR,          "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 20 */ {MN_UNDOC_NOP,    "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 21 */ {MN_LXI,          "H",     3, OPERAND_D16,  FLOW_NONE,          {10, 10}},
+    /* 22 */ {MN_SHLD,         "",      3, OPERAND_ADDR, FLOW_NONE,          {16, 16}},
+    /* 23 */ {MN_INX,          "H",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 24 */ {MN_INR,          "H",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 25 */ {MN_DCR,          "H",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 26 */ {MN_MVI,          "H",     2, OPERAND_D8,   FLOW_NONE,          { 7,  7}},
+    /* 27 */ {MN_DAA,          "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 28 */ {MN_UNDOC_NOP,    "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 29 */ {MN_DAD,          "H",     1, OPERAND_NONE, FLOW_NONE,          {10, 10}},
+    /* 2a */ {MN_LHLD,         "",      3, OPERAND_ADDR, FLOW_NONE,          {16, 16}},
+    /* 2b */ {MN_DCX,          "H",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 2c */ {MN_INR,          "L",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 2d */ {MN_DCR,          "L",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 2e */ {MN_MVI,          "L",     2, OPERAND_D8,   FLOW_NONE,          { 7,  7}},
+    /* 2f */ {MN_CMA,          "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 30 */ {MN_UNDOC_NOP,    "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 31 */ {MN_LXI,          "SP",    3, OPERAND_D16,  FLOW_NONE,          {10, 10}},
+    /* 32 */ {MN_STA,          "",      3, OPERAND_ADDR, FLOW_NONE,          {13, 13}},
+    /* 33 */ {MN_INX,          "SP",    1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 34 */ {MN_INR,          "M",     1, OPERAND_NONE, FLOW_NONE,          {10, 10}},
+    /* 35 */ {MN_DCR,          "M",     1, OPERAND_NONE, FLOW_NONE,          {10, 10}},
+    /* 36 */ {MN_MVI,          "M",     2, OPERAND_D8,   FLOW_NONE,          {10, 10}},
+    /* 37 */ {MN_STC,          "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 38 */ {MN_UNDOC_NOP,    "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 39 */ {MN_DAD,          "SP",    1, OPERAND_NONE, FLOW_NONE,          {10, 10}},
+    /* 3a */ {MN_LDA,          "",      3, OPERAND_ADDR, FLOW_NONE,          {13, 13}},
+    /* 3b */ {MN_DCX,          "SP",    1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 3c */ {MN_INR,          "A",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 3d */ {MN_DCR,          "A",     1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 3e */ {MN_MVI,          "A",     2, OPERAND_D8,   FLOW_NONE,          { 7,  7}},
+    /* 3f */ {MN_CMC,          "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 40 */ {MN_MOV,          "B,B",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 41 */ {MN_MOV,          "B,C",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 42 */ {MN_MOV,          "B,D",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 43 */ {MN_MOV,          "B,E",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 44 */ {MN_MOV,          "B,H",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 45 */ {MN_MOV,          "B,L",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 46 */ {MN_MOV,          "B,M",   1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 47 */ {MN_MOV,          "B,A",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 48 */ {MN_MOV,          "C,B",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 49 */ {MN_MOV,          "C,C",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 4a */ {MN_MOV,          "C,D",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 4b */ {MN_MOV,          "C,E",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 4c */ {MN_MOV,          "C,H",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 4d */ {MN_MOV,          "C,L",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 4e */ {MN_MOV,          "C,M",   1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 4f */ {MN_MOV,          "C,A",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 50 */ {MN_MOV,          "D,B",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 51 */ {MN_MOV,          "D,C",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 52 */ {MN_MOV,          "D,D",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 53 */ {MN_MOV,          "D,E",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 54 */ {MN_MOV,          "D,H",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 55 */ {MN_MOV,          "D,L",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 56 */ {MN_MOV,          "D,M",   1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 57 */ {MN_MOV,          "D,A",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 58 */ {MN_MOV,          "E,B",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 59 */ {MN_MOV,          "E,C",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 5a */ {MN_MOV,          "E,D",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 5b */ {MN_MOV,          "E,E",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 5c */ {MN_MOV,          "E,H",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 5d */ {MN_MOV,          "E,L",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 5e */ {MN_MOV,          "E,M",   1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 5f */ {MN_MOV,          "E,A",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 60 */ {MN_MOV,          "H,B",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 61 */ {MN_MOV,          "H,C",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 62 */ {MN_MOV,          "H,D",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 63 */ {MN_MOV,          "H,E",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 64 */ {MN_MOV,          "H,H",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 65 */ {MN_MOV,          "H,L",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 66 */ {MN_MOV,          "H,M",   1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 67 */ {MN_MOV,          "H,A",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 68 */ {MN_MOV,          "L,B",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 69 */ {MN_MOV,          "L,C",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 6a */ {MN_MOV,          "L,D",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 6b */ {MN_MOV,          "L,E",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 6c */ {MN_MOV,          "L,H",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 6d */ {MN_MOV,          "L,L",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 6e */ {MN_MOV,          "L,M",   1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 6f */ {MN_MOV,          "L,A",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 70 */ {MN_MOV,          "M,B",   1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 71 */ {MN_MOV,          "M,C",   1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 72 */ {MN_MOV,          "M,D",   1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 73 */ {MN_MOV,          "M,E",   1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 74 */ {MN_MOV,          "M,H",   1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 75 */ {MN_MOV,          "M,L",   1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 76 */ {MN_HLT,          "",      1, OPERAND_NONE, FLOW_HALT,          { 7,  7}},
+    /* 77 */ {MN_MOV,          "M,A",   1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 78 */ {MN_MOV,          "A,B",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 79 */ {MN_MOV,          "A,C",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 7a */ {MN_MOV,          "A,D",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 7b */ {MN_MOV,          "A,E",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 7c */ {MN_MOV,          "A,H",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 7d */ {MN_MOV,          "A,L",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 7e */ {MN_MOV,          "A,M",   1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 7f */ {MN_MOV,          "A,A",   1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* 80 */ {MN_ADD,          "B",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 81 */ {MN_ADD,          "C",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 82 */ {MN_ADD,          "D",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 83 */ {MN_ADD,          "E",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 84 */ {MN_ADD,          "H",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 85 */ {MN_ADD,          "L",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 86 */ {MN_ADD,          "M",     1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 87 */ {MN_ADD,          "A",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 88 */ {MN_ADC,          "B",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 89 */ {MN_ADC,          "C",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 8a */ {MN_ADC,          "D",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 8b */ {MN_ADC,          "E",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 8c */ {MN_ADC,          "H",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 8d */ {MN_ADC,          "L",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 8e */ {MN_ADC,          "M",     1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 8f */ {MN_ADC,          "A",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 90 */ {MN_SUB,          "B",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 91 */ {MN_SUB,          "C",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 92 */ {MN_SUB,          "D",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 93 */ {MN_SUB,          "E",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 94 */ {MN_SUB,          "H",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 95 */ {MN_SUB,          "L",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 96 */ {MN_SUB,          "M",     1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 97 */ {MN_SUB,          "A",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 98 */ {MN_SBB,          "B",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 99 */ {MN_SBB,          "C",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 9a */ {MN_SBB,          "D",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 9b */ {MN_SBB,          "E",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 9c */ {MN_SBB,          "H",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 9d */ {MN_SBB,          "L",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* 9e */ {MN_SBB,          "M",     1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* 9f */ {MN_SBB,          "A",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* a0 */ {MN_ANA,          "B",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* a1 */ {MN_ANA,          "C",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* a2 */ {MN_ANA,          "D",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* a3 */ {MN_ANA,          "E",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* a4 */ {MN_ANA,          "H",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* a5 */ {MN_ANA,          "L",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* a6 */ {MN_ANA,          "M",     1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* a7 */ {MN_ANA,          "A",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* a8 */ {MN_XRA,          "B",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* a9 */ {MN_XRA,          "C",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* aa */ {MN_XRA,          "D",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* ab */ {MN_XRA,          "E",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* ac */ {MN_XRA,          "H",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* ad */ {MN_XRA,          "L",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* ae */ {MN_XRA,          "M",     1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* af */ {MN_XRA,          "A",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* b0 */ {MN_ORA,          "B",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* b1 */ {MN_ORA,          "C",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* b2 */ {MN_ORA,          "D",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* b3 */ {MN_ORA,          "E",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* b4 */ {MN_ORA,          "H",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* b5 */ {MN_ORA,          "L",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* b6 */ {MN_ORA,          "M",     1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* b7 */ {MN_ORA,          "A",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* b8 */ {MN_CMP,          "B",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* b9 */ {MN_CMP,          "C",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* ba */ {MN_CMP,          "D",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* bb */ {MN_CMP,          "E",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* bc */ {MN_CMP,          "H",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* bd */ {MN_CMP,          "L",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* be */ {MN_CMP,          "M",     1, OPERAND_NONE, FLOW_NONE,          { 7,  7}},
+    /* bf */ {MN_CMP,          "A",     1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* c0 */ {MN_RNZ,          "",      1, OPERAND_NONE, FLOW_RETURN_COND,   { 5, 11}},
+    /* c1 */ {MN_POP,          "B",     1, OPERAND_NONE, FLOW_NONE,          {10, 10}},
+    /* c2 */ {MN_JNZ,          "",      3, OPERAND_ADDR, FLOW_JUMP_COND,     {10, 10}},
+    /* c3 */ {MN_JMP,          "",      3, OPERAND_ADDR, FLOW_JUMP,          {10, 10}},
+    /* c4 */ {MN_CNZ,          "",      3, OPERAND_ADDR, FLOW_CALL_COND,     {11, 17}},
+    /* c5 */ {MN_PUSH,         "B",     1, OPERAND_NONE, FLOW_NONE,          {11, 11}},
+    /* c6 */ {MN_ADI,          "",      2, OPERAND_D8,   FLOW_NONE,          { 7,  7}},
+    /* c7 */ {MN_RST,          "0",     1, OPERAND_NONE, FLOW_RESTART,       {11, 11}},
+    /* c8 */ {MN_RZ,           "",      1, OPERAND_NONE, FLOW_RETURN_COND,   { 5, 11}},
+    /* c9 */ {MN_RET,          "",      1, OPERAND_NONE, FLOW_RETURN,        {10, 10}},
+    /* ca */ {MN_JZ,           "",      3, OPERAND_ADDR, FLOW_JUMP_COND,     {10, 10}},
+    /* cb */ {MN_UNDOC_JMP,    "",      3, OPERAND_ADDR, FLOW_JUMP,          {10, 10}},
+    /* cc */ {MN_CZ,           "",      3, OPERAND_ADDR, FLOW_CALL_COND,     {11, 17}},
+    /* cd */ {MN_CALL,         "",      3, OPERAND_ADDR, FLOW_CALL,          {17, 17}},
+    /* ce */ {MN_ACI,          "",      2, OPERAND_D8,   FLOW_NONE,          { 7,  7}},
+    /* cf */ {MN_RST,          "1",     1, OPERAND_NONE, FLOW_RESTART,       {11, 11}},
+    /* d0 */ {MN_RNC,          "",      1, OPERAND_NONE, FLOW_RETURN_COND,   { 5, 11}},
+    /* d1 */ {MN_POP,          "D",     1, OPERAND_NONE, FLOW_NONE,          {10, 10}},
+    /* d2 */ {MN_JNC,          "",      3, OPERAND_ADDR, FLOW_JUMP_COND,     {10, 10}},
+    /* d3 */ {MN_OUT,          "",      2, OPERAND_PORT, FLOW_NONE,          {10, 10}},
+    /* d4 */ {MN_CNC,          "",      3, OPERAND_ADDR, FLOW_CALL_COND,     {11, 17}},
+    /* d5 */ {MN_PUSH,         "D",     1, OPERAND_NONE, FLOW_NONE,          {11, 11}},
+    /* d6 */ {MN_SUI,          "",      2, OPERAND_D8,   FLOW_NONE,          { 7,  7}},
+    /* d7 */ {MN_RST,          "2",     1, OPERAND_NONE, FLOW_RESTART,       {11, 11}},
+    /* d8 */ {MN_RC,           "",      1, OPERAND_NONE, FLOW_RETURN_COND,   { 5, 11}},
+    /* d9 */ {MN_UNDOC_RET,    "",      1, OPERAND_NONE, FLOW_RETURN,        {10, 10}},
+    /* da */ {MN_JC,           "",      3, OPERAND_ADDR, FLOW_JUMP_COND,     {10, 10}},
+    /* db */ {MN_IN,           "",      2, OPERAND_PORT, FLOW_NONE,          {10, 10}},
+    /* dc */ {MN_CC,           "",      3, OPERAND_ADDR, FLOW_CALL_COND,     {11, 17}},
+    /* dd */ {MN_UNDOC_CALL,   "",      3, OPERAND_ADDR, FLOW_CALL,          {17, 17}},
+    /* de */ {MN_SBI,          "",      2, OPERAND_D8,   FLOW_NONE,          { 7,  7}},
+    /* df */ {MN_RST,          "3",     1, OPERAND_NONE, FLOW_RESTART,       {11, 11}},
+    /* e0 */ {MN_RPO,          "",      1, OPERAND_NONE, FLOW_RETURN_COND,   { 5, 11}},
+    /* e1 */ {MN_POP,          "H",     1, OPERAND_NONE, FLOW_NONE,          {10, 10}},
+    /* e2 */ {MN_JPO,          "",      3, OPERAND_ADDR, FLOW_JUMP_COND,     {10, 10}},
+    /* e3 */ {MN_XTHL,         "",      1, OPERAND_NONE, FLOW_NONE,          {18, 18}},
+    /* e4 */ {MN_CPO,          "",      3, OPERAND_ADDR, FLOW_CALL_COND,     {11, 17}},
+    /* e5 */ {MN_PUSH,         "H",     1, OPERAND_NONE, FLOW_NONE,          {11, 11}},
+    /* e6 */ {MN_ANI,          "",      2, OPERAND_D8,   FLOW_NONE,          { 7,  7}},
+    /* e7 */ {MN_RST,          "4",     1, OPERAND_NONE, FLOW_RESTART,       {11, 11}},
+    /* e8 */ {MN_RPE,          "",      1, OPERAND_NONE, FLOW_RETURN_COND,   { 5, 11}},
+    /* e9 */ {MN_PCHL,         "",      1, OPERAND_NONE, FLOW_JUMP_INDIRECT, { 5,  5}},
+    /* ea */ {MN_JPE,          "",      3, OPERAND_ADDR, FLOW_JUMP_COND,     {10, 10}},
+    /* eb */ {MN_XCHG,         "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* ec */ {MN_CPE,          "",      3, OPERAND_ADDR, FLOW_CALL_COND,     {11, 17}},
+    /* ed */ {MN_UNDOC_CALL,   "",      3, OPERAND_ADDR, FLOW_CALL,          {17, 17}},
+    /* ee */ {MN_XRI,          "",      2, OPERAND_D8,   FLOW_NONE,          { 7,  7}},
+    /* ef */ {MN_RST,          "5",     1, OPERAND_NONE, FLOW_RESTART,       {11, 11}},
+    /* f0 */ {MN_RP,           "",      1, OPERAND_NONE, FLOW_RETURN_COND,   { 5, 11}},
+    /* f1 */ {MN_POP,          "PSW",   1, OPERAND_NONE, FLOW_NONE,          {10, 10}},
+    /* f2 */ {MN_JP,           "",      3, OPERAND_ADDR, FLOW_JUMP_COND,     {10, 10}},
+    /* f3 */ {MN_DI,           "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* f4 */ {MN_CP,           "",      3, OPERAND_ADDR, FLOW_CALL_COND,     {11, 17}},
+    /* f5 */ {MN_PUSH,         "PSW",   1, OPERAND_NONE, FLOW_NONE,          {11, 11}},
+    /* f6 */ {MN_ORI,          "",      2, OPERAND_D8,   FLOW_NONE,          { 7,  7}},
+    /* f7 */ {MN_RST,          "6",     1, OPERAND_NONE, FLOW_RESTART,       {11, 11}},
+    /* f8 */ {MN_RM,           "",      1, OPERAND_NONE, FLOW_RETURN_COND,   { 5, 11}},
+    /* f9 */ {MN_SPHL,         "",      1, OPERAND_NONE, FLOW_NONE,          { 5,  5}},
+    /* fa */ {MN_JM,           "",      3, OPERAND_ADDR, FLOW_JUMP_COND,     {10, 10}},
+    /* fb */ {MN_EI,           "",      1, OPERAND_NONE, FLOW_NONE,          { 4,  4}},
+    /* fc */ {MN_CM,           "",      3, OPERAND_ADDR, FLOW_CALL_COND,     {11, 17}},
+    /* fd */ {MN_UNDOC_CALL,   "",      3, OPERAND_ADDR, FLOW_CALL,          {17, 17}},
+    /* fe */ {MN_CPI,          "",      2, OPERAND_D8,   FLOW_NONE,          { 7,  7}},
+    /* ff */ {MN_RST,          "7",     1, OPERAND_NONE, FLOW_RESTART,       {11, 11}},
+};
+
+const char * const mnemonic_names[MNEMONIC_COUNT] =
+{
+    "NOP", "LXI", "STAX", "INX", "INR", "DCR", "MVI", "RLC",
+    "*NOP", "DAD", "LDAX", "DCX", "RRC", "RAL", "RAR", "SHLD",
+    "DAA", "LHLD", "CMA", "STA", "STC", "LDA", "CMC", "MOV",
+    "HLT", "ADD", "ADC", "SUB", "SBB", "ANA", "XRA", "ORA",
+    "CMP", "RNZ", "POP", "JNZ", "JMP", "CNZ", "PUSH", "ADI",
+    "RST", "RZ", "RET", "JZ", "*JMP", "CZ", "CALL", "ACI",
+    "RNC", "JNC", "OUT", "CNC", "SUI", "RC", "*RET", "JC",
+    "IN", "CC", "*CALL", "SBI", "RPO", "JPO", "XTHL", "CPO",
+    "ANI", "RPE", "PCHL", "JPE", "XCHG", "CPE", "XRI", "RP",
+    "JP", "DI", "CP", "ORI", "RM", "SPHL", "JM", "EI",
+    "CM", "CPI", "DB",
+};
@@ -0,0 +1,72 @@
+/*
+Opcode metadata shared by the CPU and the disassembler, so the two can't
+disagree about what an opcode is called or how long it is. Undocumented
+opcodes carry the name of the instruction they behave as, marked with '*'.
+
+Cycle counts are the 8080 data sheet's. Conditional calls and returns
+take longer when the condition holds, every other opcode has one count.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+// One id per distinct mnemonic, indexes mnemonic_names. MN_DB stands
+// for a lone data byte, e.g. an instruction cut off by the end of code.
+enum Mnemonic : uint8_t
+{
+    MN_NOP, MN_LXI, MN_STAX, MN_INX, MN_INR, MN_DCR,
+    MN_MVI, MN_RLC, MN_UNDOC_NOP, MN_DAD, MN_LDAX, MN_DCX,
+    MN_RRC, MN_RAL, MN_RAR, MN_SHLD, MN_DAA, MN_LHLD,
+    MN_CMA, MN_STA, MN_STC, MN_LDA, MN_CMC, MN_MOV,
+    MN_HLT, MN_ADD, MN_ADC, MN_SUB, MN_SBB, MN_ANA,
+    MN_XRA, MN_ORA, MN_CMP, MN_RNZ, MN_POP, MN_JNZ,
+    MN_JMP, MN_CNZ, MN_PUSH, MN_ADI, MN_RST, MN_RZ,
+    MN_RET, MN_JZ, MN_UNDOC_JMP, MN_CZ, MN_CALL, MN_ACI,
+    MN_RNC, MN_JNC, MN_OUT, MN_CNC, MN_SUI, MN_RC,
+    MN_UNDOC_RET, MN_JC, MN_IN, MN_CC, MN_UNDOC_CALL, MN_SBI,
+    MN_RPO, MN_JPO, MN_XTHL, MN_CPO, MN_ANI, MN_RPE,
+    MN_PCHL, MN_JPE, MN_XCHG, MN_CPE, MN_XRI, MN_RP,
+    MN_JP, MN_DI, MN_CP, MN_ORI, MN_RM, MN_SPHL,
+    MN_JM, MN_EI, MN_CM, MN_CPI,
+    MN_DB,
+    MNEMONIC_COUNT
+};
+
+// How an instruction can change the flow of control
+enum FlowKind : uint8_t
+{
+    FLOW_NONE,
+    FLOW_JUMP,              // JMP
+    FLOW_JUMP_COND,         // Jcc
+    FLOW_JUMP_INDIRECT,     // PCHL
+    FLOW_CALL,              // CALL
+    FLOW_CALL_COND,         // Ccc
+    FLOW_RETURN,            // RET
+    FLOW_RETURN_COND,       // Rcc
+    FLOW_RESTART,           // RST n, a call to n*8
+    FLOW_HALT               // HLT
+};
+
+// How the bytes following the opcode are interpreted
+enum OperandFormat : uint8_t
+{
+    OPERAND_NONE,
+    OPERAND_D8,     // Immediate byte
+    OPERAND_D16,    // Immediate word
+    OPERAND_ADDR,   // Memory or jump address
+    OPERAND_PORT    // I/O port number
+};
+
+struct OpcodeInfo
+{
+    Mnemonic mnemonic;          // e.g. MN_MOV
+    const char * registers;     // Register operands, e.g. "B,C", or ""
+    uint8_t length;             // Instruction length in bytes
+    OperandFormat format;
+    FlowKind flow;
+    uint8_t cycles[2];          // Cycles when a condition fails, and holds
+};
+
+extern const OpcodeInfo opcode_table[256];
+extern const char * const mnemonic_names[MNEMONIC_COUNT];
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <thread>
+
+#include "i8080.h"
+#include "pacer.h"
+
+using std::chrono::nanoseconds;
+
+static int64_t to_ns(std::chrono::steady_clock::duration d)
+{
+    return std::chrono::duration_cast<nanoseconds>(d).count();
+}
+
+Pacer::Pacer(uint32_t clock_hz, uint32_t slice_us, uint32_t max_drift_us)
+    : clock_hz(clock_hz)
+{
+    slice_cycles = std::max<uint64_t>(1, (uint64_t)clock_hz * slice_us / 1000000);
+    max_drift_ns = (int64_t)max_drift_us * 1000;
+    ns_per_cycle = 1e9 / clock_hz;
+    slice_ns = slice_cycles * ns_per_cycle;
+    start();
+}
+
+uint64_t Pacer::run(i8080 & cpu)
+{
+    start();
+
+    // The per instruction loop is the same as an unpaced host's, the
+    // clock is only read between slices
+    uint64_t cycles = 0;
+    while(!cpu.is_stopped())
+    {
+        uint64_t slice_end = cycles + slice_cycles;
+        while(cycles < slice_end && !cpu.is_stopped()) cycles += cpu.step();
+        wait(cycles);
+    }
+    return cycles;
+}
+
+void Pacer::start()
+{
+    origin = Clock::now();
+    started = origin;
+    last = origin;
+    stats = {};
+}
+
+void Pacer::wait(uint64_t guest_cycles)
+{
+    stats.slices++;
+    stats.cycles = guest_cycles;
+
+    int64_t due = guest_cycles * ns_per_cycle;
+    Clock::time_point now = Clock::now();
+    int64_t ahead = due - since_origin(now);
+    last = now;
+
+    if(ahead <= 0)
+    {
+        int64_t lag = -ahead;
+        stats.overruns++;
+        stats.lag_max_ns = std::max<uint64_t>(stats.lag_max_ns, lag);
+
+        // Too far behind to catch up without a burst, carry on from here
+        if(lag > max_drift_ns)
+        {
+            origin += nanoseconds(lag);
+            stats.resyncs++;
+        }
+        return;
+    }
+
+    stats.waits++;
+    Clock::time_point target = origin + nanoseconds(due);
+
+    // Sleep until the margin before the target, then spin the rest. The
+    // slack follows late wakes up quickly and back down slowly, and one
+    // very late wake can't push the margin past half a slice.
+    int64_t margin = std::min(2 * sleep_slack_ns, slice_ns / 2);
+    if(ahead > margin)
+    {
+        Clock::time_point wake = target - nanoseconds(margin);
+        std::this_thread::sleep_until(wake);
+        Clock::time_point woke = Clock::now();
+
+        int64_t late = std::min(to_ns(woke - wake), slice_ns / 2);
+        sleep_slack_ns += (late - sleep_slack_ns) / (late > sleep_slack_ns ? 4 : 32);
+
+        stats.sleep_ns += to_ns(woke - now);
+        now = woke;
+    }
+
+    Clock::time_point spin_start = now;
+    while(now < target) now = Clock::now();
+    stats.spin_ns += to_ns(now - spin_start);
+    last = now;
+
+    uint64_t jitter = to_ns(now - target);
+    stats.jitter_total_ns += jitter;
+    stats.jitter_max_ns = std::max(stats.jitter_max_ns, jitter);
+}
+
+uint64_t Pacer::get_slice_cycles()
+{
+    return slice_cycles;
+}
+
+const Pacer::Stats & Pacer::get_stats()
+{
+    return stats;
+}
+
+void Pacer::report(FILE * out)
+{
+    double guest = stats.cycles / (double)clock_hz;
+    double host = to_ns(last - started) / 1e9;
+    double mhz = host > 0 ? stats.cycles / host / 1e6 : 0;
+    double jitter_mean = stats.waits ? stats.jitter_total_ns / (double)stats.waits : 0;
+
+    fprintf(out, "; pacing: %u Hz, %llu cycle slices\n", clock_hz, (unsigned long long)slice_cycles);
+    fprintf(out, ";   guest %.3f s, host %.3f s, %.4f MHz\n", guest, host, mhz);
+    fprintf(out, ";   slices %llu, waited %llu, overran %llu, resynced %llu\n",
+            (unsigned long long)stats.slices, (unsigned long long)stats.waits,
+            (unsigned long long)stats.overruns, (unsigned long long)stats.resyncs);
+    fprintf(out, ";   jitter mean %.1f us, max %.1f us, lag max %.1f us\n",
+            jitter_mean / 1e3, stats.jitter_max_ns / 1e3, stats.lag_max_ns / 1e3);
+    fprintf(out, ";   slept %.3f s, spun %.3f s\n", stats.sleep_ns / 1e9, stats.spin_ns / 1e9);
+}
+
+int64_t Pacer::since_origin(Clock::time_point t)
+{
+    return to_ns(t - origin);
+}
@@ -0,0 +1,78 @@
+/*
+Real time pacing, for interactive machines and hardware in the loop runs
+that need the guest at the 8080's own clock rather than flat out. Batch
+runs don't use it and pay nothing for it.
+
+The core runs in slices of guest cycles, 1 ms worth by default. After
+each slice the guest time is compared with a monotonic host clock and the
+host waits for the guest to be due: it sleeps for most of the gap and
+spins for the rest, the spin margin following how late sleeps have been
+waking. A guest that falls further behind than the drift bound, e.g.
+while the host blocks on console input, is resynchronised rather than
+run flat out to catch up.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+class i8080;
+
+class Pacer
+{
+    public:
+        Pacer(uint32_t clock_hz = 2000000, uint32_t slice_us = 1000, uint32_t max_drift_us = 20000);
+
+        // Steps the CPU until it stops, pacing after every slice, and
+        // returns the guest cycles run
+        uint64_t run(i8080 & cpu);
+
+        // For hosts with their own loop: start() sets guest time zero,
+        // then wait() after each slice with the cycles run since
+        void start();
+        void wait(uint64_t guest_cycles);
+
+        uint64_t get_slice_cycles();
+
+        struct Stats
+        {
+            uint64_t slices;
+            uint64_t cycles;
+            uint64_t waits;             // Slices that finished early and waited
+            uint64_t overruns;          // Slices that finished after they were due
+            uint64_t resyncs;           // Overruns past the drift bound
+            uint64_t jitter_total_ns;   // How far waits woke from when they were due
+            uint64_t jitter_max_ns;
+            uint64_t lag_max_ns;        // Furthest behind at the end of a slice
+            uint64_t sleep_ns;
+            uint64_t spin_ns;
+        };
+
+        const Stats & get_stats();
+
+        // Writes the rate and the jitter and overrun figures
+        void report(FILE * out);
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        uint32_t clock_hz;
+        uint64_t slice_cycles;
+        int64_t slice_ns;
+        int64_t max_drift_ns;
+        double ns_per_cycle;
+
+        // Host time of guest cycle 0, moved on by resyncs
+        Clock::time_point origin;
+        Clock::time_point started;
+        Clock::time_point last;         // End of the latest wait
+
+        // Expected oversleep, the spin margin is twice it
+        int64_t sleep_slack_ns = 50000;
+
+        Stats stats = {};
+
+        int64_t since_origin(Clock::time_point t);
+};
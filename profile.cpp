@@ -0,0 +1,408 @@
+#include <algorithm>
+
+#include "opcodes.h"
+#include "profile.h"
+
+static const size_t ADDRESS_SPACE = 64 * 1024;
+
+ExecutionProfile::ExecutionProfile()
+    : opcodes(256), pcs(ADDRESS_SPACE), block_entries(ADDRESS_SPACE), traps(ADDRESS_SPACE)
+{
+    reset();
+}
+
+void ExecutionProfile::reset()
+{
+    std::fill(opcodes.begin(), opcodes.end(), Counter{0, 0});
+    std::fill(pcs.begin(), pcs.end(), Counter{0, 0});
+    std::fill(block_entries.begin(), block_entries.end(), 0);
+    std::fill(traps.begin(), traps.end(), 0);
+    block_start = 1;
+}
+
+const ExecutionProfile::Counter & ExecutionProfile::opcode(uint8_t op)
+{
+    return opcodes[op];
+}
+
+const ExecutionProfile::Counter & ExecutionProfile::pc(uint16_t addr)
+{
+    return pcs[addr];
+}
+
+uint64_t ExecutionProfile::instructions()
+{
+    uint64_t total = 0;
+    for(const Counter & c: opcodes) total += c.count;
+    return total;
+}
+
+uint64_t ExecutionProfile::cycles()
+{
+    uint64_t total = 0;
+    for(const Counter & c: opcodes) total += c.cycles;
+    return total;
+}
+
+// A block runs from an entry until a flow instruction, the next entry or
+// an instruction that never ran
+std::vector<ExecutionProfile::HotBlock> ExecutionProfile::hot_blocks(const uint8_t * memory, size_t top)
+{
+    std::vector<HotBlock> blocks;
+
+    for(size_t start=0; start!=ADDRESS_SPACE; ++start)
+    {
+        if(!block_entries[start]) continue;
+
+        HotBlock block = {(uint16_t)start, (uint16_t)start, block_entries[start], 0, 0};
+        size_t addr = start;
+        for(size_t guard=0; guard!=ADDRESS_SPACE; ++guard)
+        {
+            const OpcodeInfo & info = opcode_table[memory[addr]];
+            block.instructions += pcs[addr].count;
+            block.cycles += pcs[addr].cycles;
+
+            addr = (addr + info.length) & (ADDRESS_SPACE - 1);
+            if(info.flow != FLOW_NONE || block_entries[addr] || !pcs[addr].count) break;
+        }
+        block.end = addr;
+        blocks.push_back(block);
+    }
+
+    size_t shown = std::min(top, blocks.size());
+    std::partial_sort(blocks.begin(), blocks.begin() + shown, blocks.end(),
+                      [](const HotBlock & a, const HotBlock & b) { return a.cycles > b.cycles; });
+    blocks.resize(shown);
+    return blocks;
+}
+
+static double percent(uint64_t part, uint64_t total)
+{
+    return total ? 100.0 * part / total : 0;
+}
+
+// Mnemonic with its register operands, e.g. "MOV B,C"
+static void opcode_name(uint8_t op, char * out, size_t size)
+{
+    const OpcodeInfo & info = opcode_table[op];
+    snprintf(out, size, "%s %s", mnemonic_names[info.mnemonic], info.registers);
+}
+
+void ExecutionProfile::report(FILE * out, const uint8_t * memory, size_t top)
+{
+    uint64_t total_count = instructions();
+    uint64_t total_cycles = cycles();
+    char name[24];
+
+    fprintf(out, "; profile: %llu instructions, %llu cycles\n",
+            (unsigned long long)total_count, (unsigned long long)total_cycles);
+
+    // Opcodes, by cycles
+    std::vector<int> order;
+    for(int op=0; op!=256; ++op)
+    {
+        if(opcodes[op].count) order.push_back(op);
+    }
+    std::sort(order.begin(), order.end(), [this](int a, int b) { return opcodes[a].cycles > opcodes[b].cycles; });
+
+    fprintf(out, "\n; opcodes\n;   op  instruction       count           cycles      %%\n");
+    for(int op: order)
+    {
+        opcode_name(op, name, sizeof(name));
+        fprintf(out, "    %02x  %-12s %12llu %16llu %6.2f\n", op, name,
+                (unsigned long long)opcodes[op].count, (unsigned long long)opcodes[op].cycles,
+                percent(opcodes[op].cycles, total_cycles));
+    }
+
+    // Hottest PCs
+    std::vector<uint32_t> hot;
+    for(uint32_t addr=0; addr!=ADDRESS_SPACE; ++addr)
+    {
+        if(pcs[addr].count) hot.push_back(addr);
+    }
+    size_t shown = std::min(top, hot.size());
+    std::partial_sort(hot.begin(), hot.begin() + shown, hot.end(),
+                      [this](uint32_t a, uint32_t b) { return pcs[a].cycles > pcs[b].cycles; });
+
+    fprintf(out, "\n; hottest PCs\n;   pc    instruction       count           cycles      %%\n");
+    for(size_t i=0; i!=shown; ++i)
+    {
+        uint32_t addr = hot[i];
+        opcode_name(memory[addr], name, sizeof(name));
+        fprintf(out, "    %04X  %-12s %12llu %16llu %6.2f\n", addr, name,
+                (unsigned long long)pcs[addr].count, (unsigned long long)pcs[addr].cycles,
+                percent(pcs[addr].cycles, total_cycles));
+    }
+
+    fprintf(out, "\n; hottest blocks\n;   start end        entries     instructions           cycles      %%\n");
+    for(const HotBlock & b: hot_blocks(memory, top))
+    {
+        fprintf(out, "    %04X  %04X %12llu %16llu %16llu %6.2f\n", b.start, b.end,
+                (unsigned long long)b.entries, (unsigned long long)b.instructions,
+                (unsigned long long)b.cycles, percent(b.cycles, total_cycles));
+    }
+
+    fprintf(out, "\n; traps\n;   pc         calls\n");
+    for(uint32_t addr=0; addr!=ADDRESS_SPACE; ++addr)
+    {
+        if(traps[addr]) fprintf(out, "    %04X  %12llu\n", addr, (unsigned long long)traps[addr]);
+    }
+}
+
+// SAMPLING ===================================
+
+SamplingProfiler::SamplingProfiler(uint32_t period, size_t capacity)
+    : capacity(std::max<size_t>(capacity, 2)), period(std::max<uint32_t>(period, 1))
+{
+    samples.reserve(this->capacity);
+    reset();
+}
+
+void SamplingProfiler::reset()
+{
+    samples.clear();
+    depth = 0;
+    top_sp = NO_FRAME;
+    countdown = period;
+}
+
+void SamplingProfiler::call(uint16_t entry, uint16_t sp)
+{
+    stack[depth % STACK_DEPTH] = {entry, stack_order(sp)};
+    depth++;
+    top_sp = stack_order(sp);
+}
+
+uint32_t SamplingProfiler::get_depth()
+{
+    return depth;
+}
+
+void SamplingProfiler::unwind_or_sample(uint16_t pc, uint16_t sp)
+{
+    uint32_t slot = stack_order(sp);
+    if(slot > top_sp)
+    {
+        while(depth && slot > stack[(depth - 1) % STACK_DEPTH].sp) depth--;
+        top_sp = depth ? stack[(depth - 1) % STACK_DEPTH].sp : NO_FRAME;
+    }
+    if(countdown <= 0) take_sample(pc);
+}
+
+void SamplingProfiler::take_sample(uint16_t pc)
+{
+    countdown += period;
+
+    // Full, thin out to every other sample and sample half as often
+    if(samples.size() == capacity)
+    {
+        for(size_t i=0; i!=capacity/2; ++i) samples[i] = samples[2*i + 1];
+        samples.resize(capacity/2);
+        if(period < (1u << 30))
+        {
+            countdown += period;
+            period *= 2;
+        }
+    }
+
+    Sample sample;
+    sample.pc = pc;
+    sample.depth = std::min<uint32_t>(depth, 0xFFFF);
+
+    uint32_t kept = std::min(depth, uint32_t(SAMPLE_DEPTH));
+    for(uint32_t i=0; i!=kept; ++i) sample.frames[i] = stack[(depth - 1 - i) % STACK_DEPTH].entry;
+    samples.push_back(sample);
+}
+
+const std::vector<SamplingProfiler::Sample> & SamplingProfiler::get_samples()
+{
+    return samples;
+}
+
+uint32_t SamplingProfiler::get_period()
+{
+    return period;
+}
+
+std::map<std::string, uint64_t> SamplingProfiler::fold(bool with_pc)
+{
+    std::map<std::string, uint64_t> folded;
+    char name[16];
+
+    for(const Sample & s: samples)
+    {
+        std::string stack;
+        int kept = std::min(int(s.depth), int(SAMPLE_DEPTH));
+
+        // Frames beyond the sample are shown as one
+        if(s.depth > SAMPLE_DEPTH) stack = "...";
+        for(int i=kept-1; i>=0; --i)
+        {
+            snprintf(name, sizeof(name), "L%04X", s.frames[i]);
+            if(!stack.empty()) stack += ';';
+            stack += name;
+        }
+
+        if(stack.empty()) stack = "top";
+        if(with_pc)
+        {
+            snprintf(name, sizeof(name), ";%04X", s.pc);
+            stack += name;
+        }
+        folded[stack]++;
+    }
+    return folded;
+}
+
+void SamplingProfiler::write_folded(FILE * out, bool with_pc)
+{
+    for(const auto & entry: fold(with_pc))
+    {
+        fprintf(out, "%s %llu\n", entry.first.c_str(), (unsigned long long)entry.second);
+    }
+}
+
+// CALL GRAPH =================================
+
+CallGraphProfiler::CallGraphProfiler()
+    : totals(ADDRESS_SPACE), active(ADDRESS_SPACE)
+{
+    reset();
+}
+
+void CallGraphProfiler::reset(uint16_t entry)
+{
+    std::fill(totals.begin(), totals.end(), Routine{0, 0, 0});
+    std::fill(active.begin(), active.end(), 0);
+    edge_totals.clear();
+    total_cycles = 0;
+
+    frames.clear();
+    frames.push_back({entry, ADDRESS_SPACE, 0, 0});
+    totals[entry].calls = 1;
+    active[entry] = 1;
+}
+
+void CallGraphProfiler::call(uint16_t entry, uint16_t sp)
+{
+    totals[entry].calls++;
+    edge_totals[(uint32_t)frames.back().entry << 16 | entry].calls++;
+
+    frames.push_back({entry, stack_order(sp), total_cycles, 0});
+    active[entry]++;
+}
+
+uint32_t CallGraphProfiler::get_depth()
+{
+    return frames.size() - 1;
+}
+
+void CallGraphProfiler::pop()
+{
+    Frame frame = frames.back();
+    frames.pop_back();
+
+    active[frame.entry]--;
+    uint64_t inclusive = account(frame, &frames.back(), active[frame.entry] == 0, totals, edge_totals);
+    frames.back().child += inclusive;
+}
+
+// A recursive routine only adds its outermost frame's inclusive cycles,
+// so they aren't counted once per level
+uint64_t CallGraphProfiler::account(const Frame & frame, const Frame * parent, bool outermost,
+                                    std::vector<Routine> & into, std::unordered_map<uint32_t, Edge> & edges_into)
+{
+    uint64_t inclusive = total_cycles - frame.start;
+
+    Routine & r = into[frame.entry];
+    r.exclusive += inclusive - frame.child;
+    if(outermost) r.inclusive += inclusive;
+
+    if(parent) edges_into[(uint32_t)parent->entry << 16 | frame.entry].inclusive += inclusive;
+    return inclusive;
+}
+
+void CallGraphProfiler::snapshot(std::vector<Routine> & into, std::unordered_map<uint32_t, Edge> & edges_into)
+{
+    into = totals;
+    edges_into = edge_totals;
+
+    std::vector<uint16_t> open = active;
+    uint64_t carried = 0;
+    for(size_t i=frames.size(); i-- != 0; )
+    {
+        Frame frame = frames[i];
+        frame.child += carried;
+
+        open[frame.entry]--;
+        const Frame * parent = i ? &frames[i-1] : nullptr;
+        carried = account(frame, parent, open[frame.entry] == 0, into, edges_into);
+    }
+}
+
+std::map<uint16_t, CallGraphProfiler::Routine> CallGraphProfiler::routines()
+{
+    std::vector<Routine> all;
+    std::unordered_map<uint32_t, Edge> unused;
+    snapshot(all, unused);
+
+    std::map<uint16_t, Routine> found;
+    for(size_t entry=0; entry!=ADDRESS_SPACE; ++entry)
+    {
+        if(all[entry].calls) found[entry] = all[entry];
+    }
+    return found;
+}
+
+std::map<uint32_t, CallGraphProfiler::Edge> CallGraphProfiler::edges()
+{
+    std::vector<Routine> unused;
+    std::unordered_map<uint32_t, Edge> all;
+    snapshot(unused, all);
+
+    return std::map<uint32_t, Edge>(all.begin(), all.end());
+}
+
+void CallGraphProfiler::report(FILE * out)
+{
+    std::map<uint16_t, Routine> found = routines();
+
+    std::vector<std::pair<uint16_t, Routine>> order(found.begin(), found.end());
+    std::sort(order.begin(), order.end(), [](const std::pair<uint16_t, Routine> & a, const std::pair<uint16_t, Routine> & b)
+    {
+        return a.second.inclusive > b.second.inclusive;
+    });
+
+    fprintf(out, "; call graph: %llu cycles, %zu routines\n", (unsigned long long)total_cycles, order.size());
+    fprintf(out, "\n; routines\n;   entry        calls        inclusive      %%        exclusive      %%\n");
+    for(const auto & entry: order)
+    {
+        const Routine & r = entry.second;
+        fprintf(out, "    L%04X %12llu %16llu %6.2f %16llu %6.2f\n", entry.first,
+                (unsigned long long)r.calls, (unsigned long long)r.inclusive, percent(r.inclusive, total_cycles),
+                (unsigned long long)r.exclusive, percent(r.exclusive, total_cycles));
+    }
+
+    fprintf(out, "\n; calls\n;   caller   callee        calls        inclusive\n");
+    for(const auto & entry: edges())
+    {
+        fprintf(out, "    L%04X -> L%04X %12llu %16llu\n", entry.first >> 16, entry.first & 0xFFFF,
+                (unsigned long long)entry.second.calls, (unsigned long long)entry.second.inclusive);
+    }
+}
+
+void CallGraphProfiler::write_dot(FILE * out)
+{
+    fprintf(out, "digraph calls {\n    node [shape=box];\n");
+    for(const auto & entry: routines())
+    {
+        fprintf(out, "    L%04X [label=\"L%04X\\n%llu incl\\n%llu excl\"];\n", entry.first, entry.first,
+                (unsigned long long)entry.second.inclusive, (unsigned long long)entry.second.exclusive);
+    }
+    for(const auto & entry: edges())
+    {
+        fprintf(out, "    L%04X -> L%04X [label=\"%llu\"];\n", entry.first >> 16, entry.first & 0xFFFF,
+                (unsigned long long)entry.second.calls);
+    }
+    fprintf(out, "}\n");
+}
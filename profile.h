@@ -0,0 +1,281 @@
+/*
+Profilers for guest code.
+
+ExecutionProfile is exact and recorded by the core when it is built
+with PROFILE_COUNTERS, without it the instrumentation compiles out.
+
+Every executed instruction adds its count and cycles to a counter pair for
+its opcode and one for its PC. Block entries are only counted at the
+instruction after a flow instruction or a trap, so the hot basic blocks
+fall out of the PC counters when the report is written.
+
+The profile is owned by the host and attached with i8080::profile. A
+profiling build of read-rom adds -DPROFILE_COUNTERS and profile.cpp and
+reports on stderr when the run ends.
+
+SamplingProfiler is cheap enough to leave on for batch jobs. The core
+keeps a shallow shadow call stack from the calls it executes, ended as
+SP moves back past each return address, and every period guest cycles
+the PC and the innermost frames go into a preallocated buffer. The
+samples come out as folded stacks for flame graph tools. Attach it with
+i8080::sampler, read-rom does so when I8080_SAMPLES names an output
+file.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <unordered_map>
+#include <string>
+#include <vector>
+
+#include "opcodes.h"
+
+// Orders stack slots by depth. SP 0000 is an empty stack at the top of
+// memory, the slot a RET from FFFE leaves, so it maps above FFFF.
+inline uint32_t stack_order(uint16_t sp)
+{
+    return uint32_t(uint16_t(sp - 1)) + 1;
+}
+
+class ExecutionProfile
+{
+    public:
+        ExecutionProfile();
+
+        struct Counter
+        {
+            uint64_t count;
+            uint64_t cycles;
+        };
+
+        // Called by the core after each instruction
+        inline void record(uint16_t pc, uint8_t opcode, uint8_t cycles, bool flow)
+        {
+            Counter & o = opcodes[opcode];
+            Counter & p = pcs[pc];
+            o.count++;
+            o.cycles += cycles;
+            p.count++;
+            p.cycles += cycles;
+
+            if(block_start) block_entries[pc]++;
+            block_start = flow;
+        }
+
+        // Called by the core when a trap runs in place of guest code. The
+        // guest resumes in a new block.
+        inline void record_trap(uint16_t pc)
+        {
+            traps[pc]++;
+            block_start = 1;
+        }
+
+        void reset();
+
+        const Counter & opcode(uint8_t op);
+        const Counter & pc(uint16_t addr);
+        uint64_t instructions();
+        uint64_t cycles();
+
+        // A basic block found from the counters, in memory as it is now
+        struct HotBlock
+        {
+            uint16_t start;
+            uint16_t end;               // One past the last instruction
+            uint64_t entries;
+            uint64_t instructions;
+            uint64_t cycles;
+        };
+
+        // The blocks with the most cycles, hottest first
+        std::vector<HotBlock> hot_blocks(const uint8_t * memory, size_t top);
+
+        // Writes the opcode table, the hottest PCs, blocks and traps,
+        // showing top entries of each. memory is the guest's 64K.
+        void report(FILE * out, const uint8_t * memory, size_t top = 20);
+
+    private:
+        std::vector<Counter> opcodes;
+        std::vector<Counter> pcs;
+        std::vector<uint64_t> block_entries;
+        std::vector<uint64_t> traps;
+        bool block_start = 1;
+};
+
+class SamplingProfiler
+{
+    public:
+        // Samples every period guest cycles, keeping up to capacity
+        // samples. A full buffer keeps every other sample and doubles
+        // the period, so a long run is still covered evenly.
+        SamplingProfiler(uint32_t period = 10000, size_t capacity = 1 << 18);
+
+        // Frames kept in a sample, innermost first
+        static const int SAMPLE_DEPTH = 8;
+
+        // Frames the shadow stack tracks, deeper calls overwrite the
+        // outermost ones
+        static const int STACK_DEPTH = 64;
+
+        struct Sample
+        {
+            uint16_t pc;
+            uint16_t depth;                 // Full stack depth, may exceed SAMPLE_DEPTH
+            uint16_t frames[SAMPLE_DEPTH];  // Routine entry addresses, innermost first
+        };
+
+        // Called by the core after a flow instruction moved PC from the
+        // instruction at from to to, with SP after it. Untaken calls don't
+        // move the stack.
+        inline void flow(uint8_t opcode, uint16_t from, uint16_t to, uint16_t sp)
+        {
+            const OpcodeInfo & info = opcode_table[opcode];
+            bool is_call = info.flow == FLOW_CALL || info.flow == FLOW_CALL_COND || info.flow == FLOW_RESTART;
+            if(is_call && to != uint16_t(from + info.length)) call(to, sp);
+        }
+
+        // Called by the core after every instruction and trap, pc is the
+        // next one. Frames whose return address SP has moved past have
+        // returned, as in CallGraphProfiler.
+        inline void tick(uint16_t pc, uint16_t sp, uint8_t cycles)
+        {
+            countdown -= cycles;
+            if((countdown <= 0) | (stack_order(sp) > top_sp)) unwind_or_sample(pc, sp);
+        }
+
+        void call(uint16_t entry, uint16_t sp);
+
+        void reset();
+
+        // Frames on the shadow stack now, calls not yet returned from
+        uint32_t get_depth();
+
+        const std::vector<Sample> & get_samples();
+        uint32_t get_period();
+
+        // Sample counts by folded stack, outermost frame first, e.g.
+        // "L0100;L0230;L0455". With with_pc the sampled PC ends each stack.
+        std::map<std::string, uint64_t> fold(bool with_pc = 0);
+
+        // Writes "stack count" lines, the input of flamegraph.pl
+        void write_folded(FILE * out, bool with_pc = 0);
+
+    private:
+        struct Frame
+        {
+            uint16_t entry;
+            uint32_t sp;                    // Return address slot, by stack_order()
+        };
+
+        // Ring of the innermost frames, depth counts every frame
+        Frame stack[STACK_DEPTH];
+        uint32_t depth = 0;
+        uint32_t top_sp = NO_FRAME;     // Slot of the innermost frame
+
+        static const uint32_t NO_FRAME = 0x10000;
+
+        // The rare part of tick()
+        void unwind_or_sample(uint16_t pc, uint16_t sp);
+
+        std::vector<Sample> samples;
+        size_t capacity;
+        uint32_t period;
+        int32_t countdown;
+
+        void take_sample(uint16_t pc);
+};
+
+// Each frame remembers where its return address sits on the guest stack.
+// A frame is live while SP is at or below that slot, so whatever moves SP
+// past it ends the call: RET, Rcc, a trap returning, POP of the return
+// address, SPHL or LXI SP onto another stack. Frames are only matched by
+// SP, never by return address, so XTHL or a rewritten return address
+// doesn't lose track of the routine.
+class CallGraphProfiler
+{
+    public:
+        CallGraphProfiler();
+
+        // Called by the core after every instruction with the opcode that
+        // ran at from, the new PC and SP, and its cycles. A call's own
+        // cycles belong to the caller and a return's to the callee.
+        inline void step(uint8_t opcode, uint16_t from, uint16_t pc, uint16_t sp, uint8_t cycles, bool flow)
+        {
+            total_cycles += cycles;
+            if(flow)
+            {
+                const OpcodeInfo & info = opcode_table[opcode];
+                bool is_call = info.flow == FLOW_CALL || info.flow == FLOW_CALL_COND || info.flow == FLOW_RESTART;
+                if(is_call && pc != uint16_t(from + info.length)) call(pc, sp);
+            }
+            while(stack_order(sp) > frames.back().sp) pop();
+        }
+
+        // Called by the core after a trap, which runs in place of guest code
+        inline void trap(uint16_t sp, uint8_t cycles)
+        {
+            total_cycles += cycles;
+            while(stack_order(sp) > frames.back().sp) pop();
+        }
+
+        // Starts again with the code at entry as the root routine
+        void reset(uint16_t entry = 0x0100);
+
+        // Calls not yet returned from, the root aside
+        uint32_t get_depth();
+
+        struct Routine
+        {
+            uint64_t calls;
+            uint64_t inclusive;         // Cycles in the routine and its callees
+            uint64_t exclusive;         // Cycles in the routine itself
+        };
+
+        struct Edge
+        {
+            uint64_t calls;
+            uint64_t inclusive;         // Cycles spent in the callee from this caller
+        };
+
+        // Totals by routine entry and by caller << 16 | callee, including
+        // the routines still running
+        std::map<uint16_t, Routine> routines();
+        std::map<uint32_t, Edge> edges();
+
+        // Routines by inclusive cycles then the call graph edges
+        void report(FILE * out);
+
+        // The call graph in Graphviz dot form
+        void write_dot(FILE * out);
+
+    private:
+        struct Frame
+        {
+            uint16_t entry;
+            uint32_t sp;                // Return address slot by stack_order(), 64K for the root
+            uint64_t start;             // total_cycles at entry
+            uint64_t child;             // Inclusive cycles of finished callees
+        };
+
+        std::vector<Frame> frames;
+        uint64_t total_cycles = 0;
+
+        std::vector<Routine> totals;            // By entry address
+        std::vector<uint16_t> active;           // Frames open per entry, for recursion
+        std::unordered_map<uint32_t, Edge> edge_totals;
+
+        void call(uint16_t entry, uint16_t sp);
+        void pop();
+
+        // Adds a finished, or for reports a still open, frame into the
+        // totals and returns its inclusive cycles
+        uint64_t account(const Frame & frame, const Frame * parent, bool outermost,
+                         std::vector<Routine> & into, std::unordered_map<uint32_t, Edge> & edges_into);
+
+        // The totals as if every open frame returned now
+        void snapshot(std::vector<Routine> & into, std::unordered_map<uint32_t, Edge> & edges_into);
+};
@@ -1,14 +1,44 @@
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <functional>
 #include <string>
+#include <vector>
 
 #include "bus.h"
+#include "condition.h"
+#include "gdbstub.h"
+#include "pacer.h"
+#include "profile.h"
+#include "trace.h"
 
 #define CPUDIAG
 
 using namespace std;
 
 
+// CP/M programs and disk images are recognised by their extension
+static bool has_extension(const string & filename, const string & upper, const string & lower)
+{
+    if(filename.size() < 4) return 0;
+    string ext = filename.substr(filename.size()-4);
+    return ext==upper || ext==lower;
+}
+
+static bool is_cpm_program(const string & filename)
+{
+    return has_extension(filename, ".COM", ".com");
+}
+
+static bool is_disk_image(const string & filename)
+{
+    return has_extension(filename, ".DSK", ".dsk");
+}
+
+// CCP address of a standard 64K CP/M 2.2 system
+static const uint16_t CCP_BASE = 0xE400;
+
 int main(int argc, char *argv[])
 {
     // If a file is provided use it, otherwise use a default ROM
@@ -22,10 +52,235 @@ int main(int argc, char *argv[])
         //cout << "Using default ROM location: " << filename << endl;
     }   
 
-    // Create bus and write ROM into RAM
-    Bus bus;
+    // Create bus and write ROM into RAM. I8080_TIMING=fast drops the
+    // taken costs of conditional calls and returns from the cycle counts.
+    const char * timing = getenv("I8080_TIMING");
+    Bus bus((timing && string(timing)=="fast") ? i8080::FAST : i8080::CYCLE_EXACT);
     uint16_t org = 0; // File address origin
 
+#ifdef PROFILE_COUNTERS
+    // Counters for the whole run, reported on stderr at exit
+    ExecutionProfile profile;
+    bus.cpu.profile = &profile;
+    auto report = [&]() { profile.report(stderr, bus.ram.data()); };
+#else
+    auto report = []() {};
+#endif
+
+    // Sampled call stacks, written as folded stacks when the run ends
+    const char * samples_path = getenv("I8080_SAMPLES");
+    const char * sample_period = getenv("I8080_SAMPLE_PERIOD");
+    SamplingProfiler sampler(sample_period ? stoul(sample_period) : 10000);
+    if(samples_path) bus.cpu.sampler = &sampler;
+
+    // Routine cycles and the call graph, reported when the run ends
+    const char * call_graph_path = getenv("I8080_CALLGRAPH");
+    CallGraphProfiler call_graph;
+    if(call_graph_path) bus.cpu.call_graph = &call_graph;
+
+    // A binary instruction trace for tracediff, written to I8080_TRACE.
+    // I8080_TRACE_FILTER narrows it, e.g. "pc=0100-01ff class=branch,bdos
+    // every=10", see TraceFilter::parse.
+    const char * trace_path = getenv("I8080_TRACE");
+    const char * trace_filter = getenv("I8080_TRACE_FILTER");
+    TraceWriter tracer;
+    if(trace_path)
+    {
+        string error;
+        if(trace_filter && !tracer.filter.parse(trace_filter, error))
+        {
+            cerr << "error: I8080_TRACE_FILTER: " << error << endl;
+            return 1;
+        }
+        if(!tracer.open(trace_path))
+        {
+            cerr << "error: Couldn't write " << trace_path << endl;
+            return 1;
+        }
+        bus.cpu.tracer = &tracer;
+    }
+
+    // Real time pacing is off unless I8080_PACE gives a clock rate in Hz,
+    // e.g. 2000000. I8080_PACE_SLICE and I8080_PACE_DRIFT set the slice
+    // and the drift bound in microseconds.
+    const char * pace_hz = getenv("I8080_PACE");
+    const char * pace_slice = getenv("I8080_PACE_SLICE");
+    const char * pace_drift = getenv("I8080_PACE_DRIFT");
+    Pacer pacer(pace_hz ? stoul(pace_hz) : 2000000,
+                pace_slice ? stoul(pace_slice) : 1000,
+                pace_drift ? stoul(pace_drift) : 20000);
+
+    // I8080_GDB names a port or Unix socket to wait for GDB on. The guest
+    // runs under the debugger, and on after it detaches.
+    const char * gdb_address = getenv("I8080_GDB");
+    auto debug = [&]()
+    {
+        GdbStub stub(bus);
+        if(!stub.listen(gdb_address))
+        {
+            cerr << "error: Couldn't listen on " << gdb_address << endl;
+            bus.cpu.stop();
+            return;
+        }
+        cerr << "Waiting for GDB on " << gdb_address << endl;
+        if(!stub.serve()) cerr << "GDB connection lost" << endl;
+    };
+
+    // I8080_UNTIL gives a condition such as "PC == 0x0105 && A == 5" to
+    // run to. The run ends there, or hands over to GDB if I8080_GDB is set.
+    const char * until_text = getenv("I8080_UNTIL");
+    auto run_to_condition = [&]()
+    {
+        Condition until;
+        string error;
+        if(!until.compile(until_text, error))
+        {
+            cerr << "error: I8080_UNTIL: " << error << endl;
+            return 0;
+        }
+
+        uint64_t cycles;
+        RunUntil result = run_until(bus, until, cycles);
+        const char * why = result == RUN_UNTIL_MET ? "met" : "not met, the guest stopped";
+        fprintf(stderr, "; until: %s after %llu cycles, PC=%04X\n", why, (unsigned long long)cycles, bus.cpu.PC);
+        return result == RUN_UNTIL_MET ? 1 : 0;
+    };
+
+    // I8080_LOAD resumes a machine saved by I8080_SAVE in place of loading
+    // the program or booting, or a base state and the deltas saved after
+    // it, separated by commas. I8080_SAVE saves the machine where the run
+    // stops, e.g. at the I8080_UNTIL condition, and I8080_SAVE_DELTA only
+    // what changed since the state loaded.
+    const char * load_path = getenv("I8080_LOAD");
+    const char * save_path = getenv("I8080_SAVE");
+    const char * save_delta_path = getenv("I8080_SAVE_DELTA");
+    auto load_state = [&]()
+    {
+        string paths = load_path;
+        size_t start = 0;
+        while(start <= paths.size())
+        {
+            size_t end = paths.find(',', start);
+            if(end == string::npos) end = paths.size();
+            string path = paths.substr(start, end - start);
+            start = end + 1;
+
+            string error;
+            auto begin = chrono::steady_clock::now();
+            if(!bus.load_state(path, error))
+            {
+                cerr << "error: " << error << endl;
+                return 0;
+            }
+            chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - begin;
+            fprintf(stderr, "; state loaded from %s in %.0f us\n", path.c_str(), elapsed.count());
+        }
+        return 1;
+    };
+    auto save_state = [&]()
+    {
+        string error;
+        if(save_delta_path && !bus.save_state(save_delta_path, 1, error)) cerr << "error: " << error << endl;
+        if(save_path && !bus.save_state(save_path, 0, error)) cerr << "error: " << error << endl;
+    };
+
+    // Steps the CPU until it stops, reporting the pacing on stderr
+    auto run = [&]()
+    {
+        if(until_text && (!run_to_condition() || !gdb_address))
+        {
+            bus.cpu.stop();
+            return;
+        }
+        if(gdb_address) debug();
+        if(!pace_hz)
+        {
+            while(!bus.cpu.is_stopped()) bus.cpu.step();
+            return;
+        }
+        pacer.run(bus.cpu);
+        pacer.report(stderr);
+    };
+
+    auto write_profiles = [&]()
+    {
+        auto write_file = [](const char * path, function<void(FILE *)> write)
+        {
+            if(!path) return;
+
+            FILE * out = fopen(path, "w");
+            if(!out)
+            {
+                cerr << "error: Couldn't write " << path << endl;
+                return;
+            }
+            write(out);
+            fclose(out);
+        };
+        write_file(samples_path, [&](FILE * out) { sampler.write_folded(out); });
+        write_file(call_graph_path, [&](FILE * out) { call_graph.report(out); });
+        if(trace_path && !tracer.close()) cerr << "error: Couldn't write " << trace_path << endl;
+    };
+
+    // A .COM file runs as a CP/M program against the current directory,
+    // any further arguments become its command line. Console input is
+    // read from stdin.
+    if(argc > 1 && is_cpm_program(filename))
+    {
+        vector<string> args(argv + 2, argv + argc);
+        bus.cpu.trace = 0;
+        bus.bdos.setup_page_zero(args);
+        bus.bdos.input.open_stdin();
+        bus.bios.install(BDOS::BIOS_BASE);
+        bus.load_rom(filename, 0x0100);
+        if(load_path && !load_state()) return 1;
+
+        // Runs until warm boot or a system reset stops the CPU
+        run();
+        save_state();
+        bus.bdos.flush_files();
+        bus.bdos.console.flush();
+        report();
+        write_profiles();
+        return 0;
+    }
+
+    // A .DSK image boots CP/M from drive A:, further images become B: onwards
+    if(argc > 1 && is_disk_image(filename))
+    {
+        for(int i=1; i<argc && i<=DiskSystem::MAX_DRIVES; ++i)
+        {
+            if(!bus.disks.attach(i-1, argv[i]))
+            {
+                cerr << "error: Couldn't attach " << argv[i] << endl;
+                return 1;
+            }
+        }
+
+        bus.bdos.input.open_stdin();
+        bus.bdos.string_skip = 0;
+        bus.cpu.trace = 0;
+
+        if(load_path)
+        {
+            if(!load_state()) return 1;
+        }
+        else if(!bus.bios.cold_boot(CCP_BASE))
+        {
+            cerr << "error: Couldn't load the system tracks" << endl;
+            return 1;
+        }
+        call_graph.reset(CCP_BASE);
+
+        run();
+        save_state();
+        bus.disks.flush();
+        bus.bdos.console.flush();
+        report();
+        write_profiles();
+        return 0;
+    }
+
 #ifdef CPUDIAG
     filename = "test/cpudiag.bin";
     cout << "CPUDIAG requested, loading test: " << filename << endl;
@@ -64,5 +319,7 @@ int main(int argc, char *argv[])
         stop_found = bus.cpu.clock();
     };
 
+    report();
+    write_profiles();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,463 @@
+#include "ref8080.h"
+
+// ALU SPECIFICATION ==========================
+
+// Sign, zero and parity of a result, plus the always set bit 1
+uint8_t Ref8080::szp(uint8_t v)
+{
+    uint8_t ones = 0;
+    for(int i=0; i!=8; ++i) ones += (v>>i) & 1;
+
+    uint8_t f = 0x02;
+    if(v & 0x80)     f |= S;
+    if(v == 0)       f |= Z;
+    if(ones%2 == 0)  f |= P;
+    return f;
+}
+
+uint8_t Ref8080::add(uint8_t a, uint8_t b, bool carry, uint8_t & f)
+{
+    unsigned sum = a + b + carry;
+    uint8_t result = sum & 0xFF;
+
+    f = szp(result);
+    if(sum > 0xFF)                          f |= CY;
+    if((a & 0x0F) + (b & 0x0F) + carry > 0x0F) f |= AC;
+    return result;
+}
+
+// The 8080 subtracts by adding the complement, so AC is the carry out
+// of bit 3 of a + ~b + !borrow, while CY is the inverted carry (borrow).
+uint8_t Ref8080::sub(uint8_t a, uint8_t b, bool borrow, uint8_t & f)
+{
+    unsigned sum = a + (uint8_t)~b + !borrow;
+    uint8_t result = sum & 0xFF;
+
+    f = szp(result);
+    if(sum <= 0xFF)                                     f |= CY;
+    if((a & 0x0F) + (~b & 0x0F) + !borrow > 0x0F)       f |= AC;
+    return result;
+}
+
+// AND sets AC to the OR of bit 3 of both operands
+uint8_t Ref8080::ana(uint8_t a, uint8_t b, uint8_t & f)
+{
+    uint8_t result = a & b;
+
+    f = szp(result);
+    if((a | b) & 0x08) f |= AC;
+    return result;
+}
+
+uint8_t Ref8080::xra(uint8_t a, uint8_t b, uint8_t & f)
+{
+    uint8_t result = a ^ b;
+    f = szp(result);
+    return result;
+}
+
+uint8_t Ref8080::ora(uint8_t a, uint8_t b, uint8_t & f)
+{
+    uint8_t result = a | b;
+    f = szp(result);
+    return result;
+}
+
+// ADD ADC SUB SBB ANA XRA ORA CMP, CMP leaves A untouched
+uint8_t Ref8080::alu(uint8_t op, uint8_t a, uint8_t b, uint8_t & f)
+{
+    bool cy = f & CY;
+    switch(op & 7)
+    {
+        case 0: return add(a, b, 0, f);
+        case 1: return add(a, b, cy, f);
+        case 2: return sub(a, b, 0, f);
+        case 3: return sub(a, b, cy, f);
+        case 4: return ana(a, b, f);
+        case 5: return xra(a, b, f);
+        case 6: return ora(a, b, f);
+        default: sub(a, b, 0, f); return a;
+    }
+}
+
+// INR and DCR leave CY alone
+uint8_t Ref8080::inr(uint8_t v, uint8_t & f)
+{
+    uint8_t result = v + 1;
+
+    f = szp(result) | (f & CY);
+    if((result & 0x0F) == 0x00) f |= AC;
+    return result;
+}
+
+uint8_t Ref8080::dcr(uint8_t v, uint8_t & f)
+{
+    uint8_t result = v - 1;
+
+    f = szp(result) | (f & CY);
+    if((result & 0x0F) != 0x0F) f |= AC;
+    return result;
+}
+
+uint8_t Ref8080::daa(uint8_t a, uint8_t & f)
+{
+    uint8_t correction = 0;
+    bool cy = f & CY;
+
+    if((a & 0x0F) > 9 || (f & AC)) correction |= 0x06;
+    if(a > 0x99 || cy)
+    {
+        correction |= 0x60;
+        cy = 1;
+    }
+
+    uint8_t result = a + correction;
+
+    f = szp(result);
+    if(cy)                                      f |= CY;
+    if((a & 0x0F) + (correction & 0x0F) > 0x0F) f |= AC;
+    return result;
+}
+
+// Rotates only touch CY
+uint8_t Ref8080::rlc(uint8_t a, uint8_t & f)
+{
+    bool out = a >> 7;
+    f = (f & ~CY) | out;
+    return (a << 1) | out;
+}
+
+uint8_t Ref8080::rrc(uint8_t a, uint8_t & f)
+{
+    bool out = a & 1;
+    f = (f & ~CY) | out;
+    return (a >> 1) | (out << 7);
+}
+
+uint8_t Ref8080::ral(uint8_t a, uint8_t & f)
+{
+    bool in = f & CY;
+    f = (f & ~CY) | (a >> 7);
+    return (a << 1) | in;
+}
+
+uint8_t Ref8080::rar(uint8_t a, uint8_t & f)
+{
+    bool in = f & CY;
+    f = (f & ~CY) | (a & 1);
+    return (a >> 1) | (in << 7);
+}
+
+// HELPERS ====================================
+
+uint8_t Ref8080::fetch8()
+{
+    return mem[PC++];
+}
+
+uint16_t Ref8080::fetch16()
+{
+    uint8_t lo = fetch8();
+    uint8_t hi = fetch8();
+    return (hi << 8) | lo;
+}
+
+uint8_t Ref8080::get_reg(uint8_t r)
+{
+    switch(r)
+    {
+        case 0: return B;
+        case 1: return C;
+        case 2: return D;
+        case 3: return E;
+        case 4: return H;
+        case 5: return L;
+        case 6: return mem[(H << 8) | L];
+        default: return A;
+    }
+}
+
+void Ref8080::set_reg(uint8_t r, uint8_t v)
+{
+    switch(r)
+    {
+        case 0: B = v; break;
+        case 1: C = v; break;
+        case 2: D = v; break;
+        case 3: E = v; break;
+        case 4: H = v; break;
+        case 5: L = v; break;
+        case 6: mem[(H << 8) | L] = v; break;
+        default: A = v; break;
+    }
+}
+
+uint16_t Ref8080::get_rp(uint8_t rp)
+{
+    switch(rp)
+    {
+        case 0: return (B << 8) | C;
+        case 1: return (D << 8) | E;
+        case 2: return (H << 8) | L;
+        default: return SP;
+    }
+}
+
+void Ref8080::set_rp(uint8_t rp, uint16_t v)
+{
+    switch(rp)
+    {
+        case 0: B = v >> 8; C = v & 0xFF; break;
+        case 1: D = v >> 8; E = v & 0xFF; break;
+        case 2: H = v >> 8; L = v & 0xFF; break;
+        default: SP = v; break;
+    }
+}
+
+void Ref8080::push(uint16_t v)
+{
+    mem[(uint16_t)(SP - 1)] = v >> 8;
+    mem[(uint16_t)(SP - 2)] = v & 0xFF;
+    SP -= 2;
+}
+
+uint16_t Ref8080::pop()
+{
+    uint16_t v = mem[SP] | (mem[(uint16_t)(SP + 1)] << 8);
+    SP += 2;
+    return v;
+}
+
+bool Ref8080::condition(uint8_t ccc)
+{
+    bool flag = 0;
+    switch(ccc >> 1)
+    {
+        case 0: flag = F & Z;  break;
+        case 1: flag = F & CY; break;
+        case 2: flag = F & P;  break;
+        case 3: flag = F & S;  break;
+    }
+    // Even codes test for the flag being clear
+    return (ccc & 1) ? flag : !flag;
+}
+
+// EXECUTION ==================================
+
+uint8_t Ref8080::step()
+{
+    uint8_t op = fetch8();
+    uint8_t dst = (op >> 3) & 7;
+    uint8_t src = op & 7;
+    uint8_t rp = (op >> 4) & 3;
+
+    // MOV and HLT
+    if((op & 0xC0) == 0x40)
+    {
+        if(op == 0x76)
+        {
+            halted = 1;
+            PC--;
+            return 7;
+        }
+        set_reg(dst, get_reg(src));
+        return (dst==6 || src==6) ? 7 : 5;
+    }
+
+    // Register/memory ALU group
+    if((op & 0xC0) == 0x80)
+    {
+        A = alu(dst, A, get_reg(src), F);
+        return (src==6) ? 7 : 4;
+    }
+
+    if((op & 0xC0) == 0x00)
+    {
+        switch(src)
+        {
+            case 0: return 4;   // NOP and its undocumented aliases
+
+            case 1:
+                if(op & 0x08)
+                {
+                    // DAD
+                    uint32_t sum = get_rp(2) + get_rp(rp);
+                    set_rp(2, sum & 0xFFFF);
+                    F = (F & ~CY) | (sum > 0xFFFF);
+                    return 10;
+                }
+                set_rp(rp, fetch16()); // LXI
+                return 10;
+
+            case 2:
+                switch(dst)
+                {
+                    case 0: mem[get_rp(0)] = A; return 7;   // STAX B
+                    case 1: A = mem[get_rp(0)]; return 7;   // LDAX B
+                    case 2: mem[get_rp(1)] = A; return 7;   // STAX D
+                    case 3: A = mem[get_rp(1)]; return 7;   // LDAX D
+                    case 4:
+                    {
+                        // SHLD
+                        uint16_t addr = fetch16();
+                        mem[addr] = L;
+                        mem[(uint16_t)(addr + 1)] = H;
+                        return 16;
+                    }
+                    case 5:
+                    {
+                        // LHLD
+                        uint16_t addr = fetch16();
+                        L = mem[addr];
+                        H = mem[(uint16_t)(addr + 1)];
+                        return 16;
+                    }
+                    case 6: mem[fetch16()] = A; return 13;  // STA
+                    default: A = mem[fetch16()]; return 13; // LDA
+                }
+
+            case 3:
+                // INX / DCX
+                set_rp(rp, get_rp(rp) + ((op & 0x08) ? -1 : 1));
+                return 5;
+
+            case 4:
+                set_reg(dst, inr(get_reg(dst), F));
+                return (dst==6) ? 10 : 5;
+
+            case 5:
+                set_reg(dst, dcr(get_reg(dst), F));
+                return (dst==6) ? 10 : 5;
+
+            case 6:
+                set_reg(dst, fetch8()); // MVI
+                return (dst==6) ? 10 : 7;
+
+            default:
+                switch(dst)
+                {
+                    case 0: A = rlc(A, F); break;
+                    case 1: A = rrc(A, F); break;
+                    case 2: A = ral(A, F); break;
+                    case 3: A = rar(A, F); break;
+                    case 4: A = daa(A, F); break;
+                    case 5: A = ~A; break;      // CMA
+                    case 6: F |= CY; break;     // STC
+                    case 7: F ^= CY; break;     // CMC
+                }
+                return 4;
+        }
+    }
+
+    // 0xC0-0xFF
+    switch(src)
+    {
+        case 0:
+            // Rcc
+            if(condition(dst))
+            {
+                PC = pop();
+                return 11;
+            }
+            return 5;
+
+        case 1:
+            if(!(op & 0x08))
+            {
+                // POP
+                uint16_t v = pop();
+                if(rp == 3)
+                {
+                    A = v >> 8;
+                    F = (v & FLAG_MASK) | 0x02;
+                }
+                else
+                {
+                    set_rp(rp, v);
+                }
+                return 10;
+            }
+            switch(rp)
+            {
+                case 0:
+                case 1: PC = pop(); return 10;          // RET
+                case 2: PC = get_rp(2); return 5;       // PCHL
+                default: SP = get_rp(2); return 5;      // SPHL
+            }
+
+        case 2:
+        {
+            // Jcc
+            uint16_t addr = fetch16();
+            if(condition(dst)) PC = addr;
+            return 10;
+        }
+
+        case 3:
+            switch(dst)
+            {
+                case 0:
+                case 1: PC = fetch16(); return 10;  // JMP
+                case 2: fetch8(); return 10;        // OUT, no devices
+                case 3: fetch8(); A = 0x00; return 10; // IN, no devices
+                case 4:
+                {
+                    // XTHL
+                    uint16_t v = pop();
+                    push(get_rp(2));
+                    set_rp(2, v);
+                    return 18;
+                }
+                case 5:
+                {
+                    // XCHG
+                    uint16_t de = get_rp(1);
+                    set_rp(1, get_rp(2));
+                    set_rp(2, de);
+                    return 4;
+                }
+                case 6: inte = 0; return 4;     // DI
+                default: inte = 1; return 4;    // EI
+            }
+
+        case 4:
+        {
+            // Ccc
+            uint16_t addr = fetch16();
+            if(condition(dst))
+            {
+                push(PC);
+                PC = addr;
+                return 17;
+            }
+            return 11;
+        }
+
+        case 5:
+            if(!(op & 0x08))
+            {
+                // PUSH
+                if(rp == 3) push((A << 8) | (F & FLAG_MASK) | 0x02);
+                else        push(get_rp(rp));
+                return 11;
+            }
+            else
+            {
+                // CALL and its undocumented aliases
+                uint16_t addr = fetch16();
+                push(PC);
+                PC = addr;
+                return 17;
+            }
+
+        case 6:
+            A = alu(dst, A, fetch8(), F);
+            return 7;
+
+        default:
+            // RST
+            push(PC);
+            PC = dst << 3;
+            return 11;
+    }
+}
@@ -0,0 +1,76 @@
+/*
+A small reference model of the 8080, written to be obviously correct
+rather than fast. Opcodes are decoded from their bit fields the way the
+Intel 8080 Microcomputer Systems User's Manual lays them out, and every
+flag is computed by the ALU specification functions below.
+
+It is used as the oracle for differential and exhaustive testing of the
+i8080 core, so it deliberately shares no code with it.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+class Ref8080
+{
+    public:
+        // Registers
+        uint8_t A = 0x00;
+        uint8_t B = 0x00;
+        uint8_t C = 0x00;
+        uint8_t D = 0x00;
+        uint8_t E = 0x00;
+        uint8_t H = 0x00;
+        uint8_t L = 0x00;
+        uint8_t F = 0x02;   // Bit 1 always reads as 1
+        uint16_t PC = 0x0000;
+        uint16_t SP = 0x0000;
+        bool halted = 0;
+        bool inte = 0;
+
+        // 64K of memory, owned by the caller
+        uint8_t * mem = nullptr;
+
+        // Executes one instruction and returns the cycles it took
+        uint8_t step();
+
+    public:
+        // Flag bits, same layout as i8080::FLAGS8080
+        static const uint8_t CY = (1 << 0);
+        static const uint8_t P  = (1 << 2);
+        static const uint8_t AC = (1 << 4);
+        static const uint8_t Z  = (1 << 6);
+        static const uint8_t S  = (1 << 7);
+
+        // Mask of the bits that hold real flags
+        static const uint8_t FLAG_MASK = S | Z | AC | P | CY;
+
+        // ALU specification. Each takes the current flags in f and
+        // leaves the flags the 8080 would produce in f.
+        static uint8_t szp(uint8_t v);
+        static uint8_t add(uint8_t a, uint8_t b, bool carry, uint8_t & f);
+        static uint8_t sub(uint8_t a, uint8_t b, bool borrow, uint8_t & f);
+        static uint8_t ana(uint8_t a, uint8_t b, uint8_t & f);
+        static uint8_t xra(uint8_t a, uint8_t b, uint8_t & f);
+        static uint8_t ora(uint8_t a, uint8_t b, uint8_t & f);
+        static uint8_t alu(uint8_t op, uint8_t a, uint8_t b, uint8_t & f); // op is bits 5-3 of the opcode
+        static uint8_t inr(uint8_t v, uint8_t & f);
+        static uint8_t dcr(uint8_t v, uint8_t & f);
+        static uint8_t daa(uint8_t a, uint8_t & f);
+        static uint8_t rlc(uint8_t a, uint8_t & f);
+        static uint8_t rrc(uint8_t a, uint8_t & f);
+        static uint8_t ral(uint8_t a, uint8_t & f);
+        static uint8_t rar(uint8_t a, uint8_t & f);
+
+    private:
+        uint8_t fetch8();
+        uint16_t fetch16();
+        uint8_t get_reg(uint8_t r);         // r: B C D E H L M A
+        void set_reg(uint8_t r, uint8_t v);
+        uint16_t get_rp(uint8_t rp);        // rp: BC DE HL SP
+        void set_rp(uint8_t rp, uint16_t v);
+        void push(uint16_t v);
+        uint16_t pop();
+        bool condition(uint8_t ccc);        // NZ Z NC C PO PE P M
+};
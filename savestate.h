@@ -0,0 +1,163 @@
+/*
+Save states, a whole machine in one file so a run can resume where
+another stopped, e.g. after CP/M has booted.
+
+    StateHeader
+    StateSection, then its data         one per part of the machine
+
+Sections are tagged so a reader skips ones it doesn't know, and each part
+of the machine reads only its own. A state holds:
+    CPU     registers, flags, interrupt enable and cycle counters
+    RAM     all 64K
+    BDOS    disk state, open files with their unwritten data, searches
+    BIOS    jump table base and the system reloaded on warm boot
+    DISK    attached images by path and the current BIOS selection
+    LINK    ids of this state and, for a delta, the state it follows
+A delta state has PAGE in place of RAM, the count of pages then each
+page written since the last checkpoint as its number and 256 bytes, so
+it is as large as what the machine wrote. The Bus marks pages dirty as
+they are written, and loads a delta only over the checkpoint named as
+its parent with nothing written since: a base state then each delta
+after it. Readers that predate deltas find no RAM and refuse them.
+Host side state is not saved: traps are reinstalled from the BIOS and
+BDOS state, and breakpoints, watchpoints, profilers and console input
+belong to the host that loads the state. Fields are little endian, as
+written by the host.
+
+Bus::save_state() builds the file in memory and writes it with one
+write() and a rename, Bus::load_state() maps it and copies the parts
+into place.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const uint32_t STATE_VERSION = 1;
+
+struct StateHeader
+{
+    char magic[8];              // "I8080SS" and a terminator
+    uint32_t version;
+    uint32_t section_count;
+    uint64_t size;              // Of the whole file
+};
+
+struct StateSection
+{
+    uint32_t tag;               // Four characters, e.g. "CPU "
+    uint32_t size;              // Of the data that follows
+};
+
+static constexpr uint32_t state_tag(const char (&name)[5])
+{
+    return name[0] | name[1] << 8 | name[2] << 16 | (uint32_t)name[3] << 24;
+}
+
+// Appends sections to a buffer written in one go
+class StateWriter
+{
+    public:
+        std::vector<uint8_t> data;
+
+        void begin_section(uint32_t tag)
+        {
+            section_start = data.size();
+            put(StateSection{tag, 0});
+        }
+
+        void end_section()
+        {
+            uint32_t size = data.size() - section_start - sizeof(StateSection);
+            std::memcpy(&data[section_start] + offsetof(StateSection, size), &size, sizeof(size));
+            section_count++;
+        }
+
+        void put(const void * bytes, size_t size)
+        {
+            const uint8_t * p = (const uint8_t *)bytes;
+            data.insert(data.end(), p, p + size);
+        }
+
+        template<class T> void put(const T & value)
+        {
+            put(&value, sizeof(value));
+        }
+
+        void put_string(const std::string & s)
+        {
+            put((uint32_t)s.size());
+            put(s.data(), s.size());
+        }
+
+        uint32_t get_section_count() { return section_count; }
+
+    private:
+        size_t section_start = 0;
+        uint32_t section_count = 0;
+};
+
+// Reads one section in place. Reading past its end clears ok and yields
+// zeros, so a part checks ok once when it is done.
+class StateReader
+{
+    public:
+        StateReader(const uint8_t * data, size_t size) : p(data), end(data + size) {}
+
+        bool ok = 1;
+
+        void get(void * bytes, size_t size)
+        {
+            if((size_t)(end - p) < size)
+            {
+                std::memset(bytes, 0, size);
+                ok = 0;
+                p = end;
+                return;
+            }
+            std::memcpy(bytes, p, size);
+            p += size;
+        }
+
+        template<class T> void get(T & value)
+        {
+            get(&value, sizeof(value));
+        }
+
+        std::string get_string()
+        {
+            uint32_t size = 0;
+            get(size);
+            if((size_t)(end - p) < size)
+            {
+                ok = 0;
+                p = end;
+                return "";
+            }
+            std::string s((const char *)p, size);
+            p += size;
+            return s;
+        }
+
+        // The next size bytes, read in place. nullptr if there aren't as many.
+        const uint8_t * view(size_t size)
+        {
+            if((size_t)(end - p) < size)
+            {
+                ok = 0;
+                p = end;
+                return nullptr;
+            }
+            const uint8_t * at = p;
+            p += size;
+            return at;
+        }
+
+    private:
+        const uint8_t * p;
+        const uint8_t * end;
+};
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "disasm.h"
+#include "sweep.h"
+
+struct Chunk
+{
+    size_t source;
+    size_t start;
+    size_t end;
+    size_t exits[3];    // Where a sweep entering at start + phase leaves
+    size_t entry;       // First instruction boundary in the chunk
+};
+
+// Formatted text of a chunk. Grows without clearing, unlike a string.
+struct TextBuffer
+{
+    std::unique_ptr<char[]> data;
+    size_t capacity = 0;
+    size_t used = 0;
+
+    void reserve(size_t size)
+    {
+        if(size <= capacity) return;
+
+        std::unique_ptr<char[]> grown(new char[size]);
+        if(used) std::memcpy(grown.get(), data.get(), used);
+        data = std::move(grown);
+        capacity = size;
+    }
+
+    void append(const std::string & text)
+    {
+        reserve(used + text.size());
+        std::memcpy(data.get() + used, text.data(), text.size());
+        used += text.size();
+    }
+};
+
+// Instruction lengths, with a cut off instruction counted as one byte
+// as decode_op does
+static inline size_t next_boundary(const uint8_t * code, size_t size, size_t offset)
+{
+    size_t length = opcode_table[code[offset]].length;
+    return (offset + length > size) ? offset + 1 : offset + length;
+}
+
+// Runs fn(i) for every i in [0, count) over the threads
+template<typename Fn>
+static void parallel_for(size_t count, unsigned threads, Fn fn)
+{
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        for(size_t i = next++; i < count; i = next++) fn(i);
+    };
+
+    std::vector<std::thread> pool;
+    for(unsigned i=1; i<threads; ++i) pool.emplace_back(worker);
+    worker();
+    for(auto & t: pool) t.join();
+}
+
+size_t parallel_sweep(const std::vector<SweepSource> & sources, FILE * out,
+                      unsigned threads, size_t chunk_size)
+{
+    if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<Chunk> chunks;
+    for(size_t s=0; s!=sources.size(); ++s)
+    {
+        for(size_t start=0; start < sources[s].size; start += chunk_size)
+        {
+            chunks.push_back({s, start, std::min(start + chunk_size, sources[s].size), {}, 0});
+        }
+    }
+
+    // Boundary pass, every phase of every chunk
+    parallel_for(chunks.size(), threads, [&](size_t i)
+    {
+        Chunk & c = chunks[i];
+        const SweepSource & src = sources[c.source];
+        size_t offset = c.start;
+        while(offset < c.end) offset = next_boundary(src.code, src.size, offset);
+        c.exits[0] = offset;
+
+        // The other phases nearly always fall in step with phase 0 within
+        // a few instructions, after which they share its exit
+        for(int phase=1; phase!=3; ++phase)
+        {
+            size_t a = c.start;
+            size_t b = c.start + phase;
+            while(b < c.end && a != b)
+            {
+                if(a < b) a = next_boundary(src.code, src.size, a);
+                else      b = next_boundary(src.code, src.size, b);
+            }
+            c.exits[phase] = (a == b) ? c.exits[0] : b;
+        }
+    });
+
+    // Chain the exits from the start of each source
+    for(size_t i=0; i!=chunks.size(); ++i)
+    {
+        Chunk & c = chunks[i];
+        if(i == 0 || chunks[i-1].source != c.source)
+        {
+            c.entry = c.start;
+        }
+        else
+        {
+            const Chunk & prev = chunks[i-1];
+            size_t phase = prev.entry - prev.start;
+            c.entry = (prev.entry >= prev.end) ? prev.entry : prev.exits[phase];
+        }
+    }
+
+    // Format on the pool, keeping a bounded window of chunks in flight
+    // so the writer can emit them in order
+    const size_t window = 2 * threads;
+    std::vector<TextBuffer> slots(window);
+    std::vector<char> ready(chunks.size(), 0);
+    size_t written_chunks = 0;
+    std::mutex lock;
+    std::condition_variable changed;
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]()
+    {
+        for(size_t i = next++; i < chunks.size(); i = next++)
+        {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                changed.wait(guard, [&] { return i < written_chunks + window; });
+            }
+
+            const Chunk & c = chunks[i];
+            const SweepSource & src = sources[c.source];
+            TextBuffer & text = slots[i % window];
+            text.used = 0;
+            if(c.start == 0) text.append(src.header);
+
+            text.reserve(text.used + (c.end - c.start + 1) * 24 + DISASM_LINE_MAX);
+            for(size_t offset = c.entry; offset < c.end; )
+            {
+                if(text.capacity - text.used < DISASM_LINE_MAX) text.reserve(text.capacity * 2);
+
+                DecodedOp op = decode_op(src.code, src.size, offset, src.base);
+                text.used += format_op(op, src.code + offset, text.data.get() + text.used);
+                offset += op.length;
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                ready[i] = 1;
+            }
+            changed.notify_all();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for(unsigned i=0; i!=threads; ++i) pool.emplace_back(worker);
+
+    // Sources without any bytes still get their header
+    size_t total = 0;
+    size_t source = 0;
+    auto headers_before = [&](size_t upto)
+    {
+        for(; source < upto; ++source)
+        {
+            if(sources[source].size == 0)
+            {
+                fwrite(sources[source].header.data(), 1, sources[source].header.size(), out);
+                total += sources[source].header.size();
+            }
+        }
+    };
+
+    for(size_t i=0; i!=chunks.size(); ++i)
+    {
+        headers_before(chunks[i].source);
+        source = chunks[i].source + 1;
+
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [&] { return ready[i] != 0; });
+        guard.unlock();
+
+        const TextBuffer & text = slots[i % window];
+        fwrite(text.data.get(), 1, text.used, out);
+        total += text.used;
+
+        guard.lock();
+        written_chunks++;
+        guard.unlock();
+        changed.notify_all();
+    }
+    headers_before(sources.size());
+
+    for(auto & t: pool) t.join();
+    return total;
+}
@@ -0,0 +1,33 @@
+/*
+Parallel linear sweep disassembly over many inputs.
+
+Inputs are cut into fixed size chunks. A first pass using only the
+instruction length table follows each chunk from all three possible
+starting phases, recording where each phase leaves the chunk. Chaining
+those exits from the start of each input gives every chunk the exact
+instruction boundary a serial sweep would enter it at, so the chunks
+then format independently on a thread pool. Formatted chunks are written
+out in input order, so the output matches a serial sweep byte for byte.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// An input to sweep, read in place
+struct SweepSource
+{
+    const uint8_t * code;
+    size_t size;
+    uint32_t base;          // Address of code[0]
+    std::string header;     // Written before the input's listing
+};
+
+// Disassembles every source in order, returns the characters written.
+// threads==0 uses every hardware thread.
+size_t parallel_sweep(const std::vector<SweepSource> & sources, FILE * out,
+                      unsigned threads = 0, size_t chunk_size = 1 << 16);
@@ -0,0 +1,532 @@
+#include <cstring>
+
+#include <sstream>
+
+#include "i8080.h"
+#include "opcodes.h"
+#include "trace.h"
+
+static const char TRACE_MAGIC[8] = "I8080TR";
+
+const char * const trace_field_names[TF_COUNT] =
+{
+    "op", "cycles", "a", "f", "b", "c", "d", "e", "h", "l", "sp", "next"
+};
+
+// FILTERING ==================================
+
+TraceFilter::TraceFilter()
+{
+    opcode_mask.set();
+    pc_map.set();
+}
+
+void TraceFilter::add_pc_range(uint16_t first, uint16_t last)
+{
+    if(!pcs_given) pc_map.reset();
+    pcs_given = 1;
+    for(uint32_t pc = first; pc <= last; ++pc) pc_map[pc] = 1;
+}
+
+void TraceFilter::add_classes(uint32_t classes)
+{
+    if(!opcodes_given) opcode_mask.reset();
+    opcodes_given = 1;
+    if(classes & CLASS_TRAP) traps = 1;
+
+    for(int op=0; op!=256; ++op)
+    {
+        FlowKind flow = opcode_table[op].flow;
+        Mnemonic m = opcode_table[op].mnemonic;
+
+        bool branch = flow != FLOW_NONE && flow != FLOW_HALT;
+
+        // Calls and RST push the return address. M first in the operands
+        // is the destination of MOV, MVI, INR and DCR.
+        bool write = flow == FLOW_CALL || flow == FLOW_CALL_COND || flow == FLOW_RESTART
+                  || m == MN_STA || m == MN_STAX || m == MN_SHLD || m == MN_PUSH || m == MN_XTHL
+                  || ((m == MN_MOV || m == MN_MVI || m == MN_INR || m == MN_DCR)
+                      && opcode_table[op].registers[0] == 'M');
+
+        bool io = m == MN_IN || m == MN_OUT;
+
+        if(((classes & CLASS_BRANCH) && branch) || ((classes & CLASS_WRITE) && write)
+           || ((classes & CLASS_IO) && io))
+        {
+            opcode_mask[op] = 1;
+        }
+    }
+}
+
+void TraceFilter::add_opcode(uint8_t opcode)
+{
+    if(!opcodes_given) opcode_mask.reset();
+    opcodes_given = 1;
+    opcode_mask[opcode] = 1;
+}
+
+void TraceFilter::set_every(uint32_t every)
+{
+    this->every = every ? every : 1;
+    countdown = this->every;
+}
+
+bool TraceFilter::parse(const std::string & spec, std::string & error)
+{
+    static const struct { const char * name; uint32_t classes; } class_names[] =
+    {
+        {"branch", CLASS_BRANCH}, {"write", CLASS_WRITE}, {"io", CLASS_IO}, {"bdos", CLASS_TRAP},
+    };
+
+    std::stringstream terms(spec);
+    std::string term;
+    while(terms >> term)
+    {
+        size_t eq = term.find('=');
+        std::string key = term.substr(0, eq);
+        std::string values = eq == std::string::npos ? "" : term.substr(eq + 1);
+        if(values.empty())
+        {
+            error = "expected key=value, got '" + term + "'";
+            return 0;
+        }
+
+        std::stringstream list(values);
+        std::string value;
+        while(getline(list, value, ','))
+        {
+            try
+            {
+                if(key == "pc")
+                {
+                    size_t dash = value.find('-');
+                    uint16_t first = std::stoul(value.substr(0, dash), nullptr, 16);
+                    uint16_t last = dash == std::string::npos ? first : std::stoul(value.substr(dash + 1), nullptr, 16);
+                    if(last < first)
+                    {
+                        error = "empty PC range " + value;
+                        return 0;
+                    }
+                    add_pc_range(first, last);
+                }
+                else if(key == "op")
+                {
+                    add_opcode(std::stoul(value, nullptr, 16));
+                }
+                else if(key == "every")
+                {
+                    set_every(std::stoul(value));
+                }
+                else if(key == "class")
+                {
+                    size_t c = 0;
+                    while(c != sizeof(class_names)/sizeof(class_names[0]) && value != class_names[c].name) c++;
+                    if(c == sizeof(class_names)/sizeof(class_names[0]))
+                    {
+                        error = "unknown class " + value;
+                        return 0;
+                    }
+                    add_classes(class_names[c].classes);
+                }
+                else
+                {
+                    error = "unknown key " + key;
+                    return 0;
+                }
+            }
+            catch(...)
+            {
+                error = "bad number in " + term;
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+// WRITING ====================================
+
+TraceWriter::~TraceWriter()
+{
+    close();
+}
+
+bool TraceWriter::open(const std::string & path)
+{
+    close();
+    out = fopen(path.c_str(), "wb");
+    if(!out) return 0;
+
+    TraceHeader header = {};
+    std::memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.record_size = sizeof(TraceRecord);
+
+    ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    buffer.resize(BUFFER_RECORDS);
+    used = 0;
+    return 1;
+}
+
+bool TraceWriter::close()
+{
+    if(!out) return ok;
+    flush();
+    if(fclose(out) != 0) ok = 0;
+    out = nullptr;
+    return ok;
+}
+
+void TraceWriter::record(const i8080 & cpu, uint16_t pc, uint8_t opcode, uint8_t cycles)
+{
+    TraceRecord & r = buffer[used];
+    r.pc = pc;
+    r.next_pc = cpu.PC;
+    r.sp = cpu.SP;
+    r.opcode = opcode;
+    r.cycles = cycles;
+    r.a = cpu.A;
+    r.f = cpu.status;
+    r.b = cpu.B;
+    r.c = cpu.C;
+    r.d = cpu.D;
+    r.e = cpu.E;
+    r.h = cpu.H;
+    r.l = cpu.L;
+
+    if(++used == BUFFER_RECORDS) flush();
+}
+
+void TraceWriter::flush()
+{
+    if(used && fwrite(buffer.data(), sizeof(TraceRecord), used, out) != used) ok = 0;
+    used = 0;
+}
+
+// READING ====================================
+
+// Text is scanned byte by byte, so these avoid the locale aware ctype calls
+static inline bool is_letter(char c)
+{
+    return (unsigned)((c | 0x20) - 'a') < 26;
+}
+
+static inline bool is_digit(char c)
+{
+    return (unsigned)(c - '0') < 10;
+}
+
+static inline int hex_digit(char c)
+{
+    if(is_digit(c)) return c - '0';
+    unsigned x = (c | 0x20) - 'a';
+    return x < 6 ? x + 10 : -1;
+}
+
+// Token names packed into an integer, upper case, at most 8 characters
+static constexpr uint64_t name_key(const char * name)
+{
+    return *name ? (uint64_t)(uint8_t)*name << (8 * (__builtin_strlen(name) - 1)) | name_key(name + 1) : 0;
+}
+
+enum TokenKind { TOKEN_BYTE, TOKEN_PAIR, TOKEN_SP, TOKEN_PC, TOKEN_OP, TOKEN_PCMEM, TOKEN_CYCLES };
+
+static const struct { uint64_t key; TokenKind kind; TraceField field; } token_names[] =
+{
+    {name_key("A"),  TOKEN_BYTE, TF_A}, {name_key("F"),  TOKEN_BYTE, TF_F},
+    {name_key("B"),  TOKEN_BYTE, TF_B}, {name_key("C"),  TOKEN_BYTE, TF_C},
+    {name_key("D"),  TOKEN_BYTE, TF_D}, {name_key("E"),  TOKEN_BYTE, TF_E},
+    {name_key("H"),  TOKEN_BYTE, TF_H}, {name_key("L"),  TOKEN_BYTE, TF_L},
+    {name_key("AF"), TOKEN_PAIR, TF_A}, {name_key("BC"), TOKEN_PAIR, TF_B},
+    {name_key("DE"), TOKEN_PAIR, TF_D}, {name_key("HL"), TOKEN_PAIR, TF_H},
+    {name_key("SP"), TOKEN_SP,   TF_SP},
+    {name_key("PC"), TOKEN_PC,   TF_NEXT_PC},
+    {name_key("OP"), TOKEN_OP,   TF_OPCODE},
+    {name_key("PCMEM"),  TOKEN_PCMEM,  TF_OPCODE},
+    {name_key("CYC"),    TOKEN_CYCLES, TF_CYCLES},
+    {name_key("CYCLES"), TOKEN_CYCLES, TF_CYCLES},
+    {name_key("CLK"),    TOKEN_CYCLES, TF_CYCLES},
+};
+
+bool TraceReader::open(const std::string & path, Format format, std::string & error)
+{
+    pos = 0;
+    released = 0;
+    line = 0;
+    number = 0;
+    have_pending = 0;
+
+    if(!file.open(path))
+    {
+        error = "Couldn't read " + path;
+        return 0;
+    }
+    data = file.data();
+    size = file.size();
+    const char * text = (const char *)data;
+
+    if(format == TRACE_AUTO)
+    {
+        const char * eol = size ? (const char *)memchr(text, '\n', size) : nullptr;
+        const char * end = eol ? eol : text + size;
+        const char * p = text;
+        RawLine probe;
+
+        if(size >= sizeof(TRACE_MAGIC) && std::memcmp(text, TRACE_MAGIC, sizeof(TRACE_MAGIC)) == 0)
+            format = TRACE_BINARY;
+        else if(size && parse_core_columns(p, end, probe))
+            format = TRACE_CORE_TEXT;
+        else
+            format = TRACE_TEXT_BEFORE;
+    }
+    this->format = format;
+
+    if(format == TRACE_BINARY)
+    {
+        const TraceHeader * h = (const TraceHeader *)data;
+        bool valid = size >= sizeof(TraceHeader)
+                  && std::memcmp(h->magic, TRACE_MAGIC, sizeof(h->magic)) == 0
+                  && h->version == TRACE_VERSION
+                  && h->record_size == sizeof(TraceRecord);
+        if(!valid)
+        {
+            error = path + " isn't a version " + std::to_string(TRACE_VERSION) + " binary trace";
+            return 0;
+        }
+        pos = sizeof(TraceHeader);
+    }
+    return 1;
+}
+
+TraceReader::Format TraceReader::get_format()
+{
+    return format;
+}
+
+uint64_t TraceReader::get_bytes_read()
+{
+    return pos;
+}
+
+bool TraceReader::next(TraceEntry & entry)
+{
+    if(pos - released >= RELEASE_BYTES)
+    {
+        file.release(pos);
+        released = pos;
+    }
+
+    if(format == TRACE_BINARY) return read_record(entry);
+
+    if(!have_pending)
+    {
+        if(!read_line(pending)) return 0;
+        have_pending = 1;
+    }
+
+    // Each line needs the one after it to be complete
+    RawLine raw;
+    if(!read_line(raw))
+    {
+        have_pending = 0;
+        if(format == TRACE_TEXT_BEFORE) return 0;
+
+        entry = pending.entry;
+        entry.number = number++;
+        return 1;
+    }
+
+    entry = pending.entry;
+    if(format == TRACE_TEXT_BEFORE)
+    {
+        // The state the next line starts from is the one this instruction
+        // left, only the opcode belongs to this line
+        uint32_t opcode = entry.known & (1u << TF_OPCODE);
+        uint16_t value = entry.values[TF_OPCODE];
+        std::memcpy(entry.values, raw.entry.values, sizeof(entry.values));
+        entry.known = (raw.entry.known & ~(1u << TF_OPCODE)) | opcode;
+        entry.values[TF_OPCODE] = value;
+    }
+    if(format != TRACE_CORE_TEXT) entry.set(TF_NEXT_PC, raw.entry.pc);
+
+    // Cycle totals are taken before each instruction, a total that doesn't
+    // move means the trace doesn't count them
+    entry.known &= ~(1u << TF_CYCLES);
+    if(pending.has_total && raw.has_total && raw.total_cycles > pending.total_cycles
+       && raw.total_cycles - pending.total_cycles <= 0xFF)
+    {
+        entry.set(TF_CYCLES, raw.total_cycles - pending.total_cycles);
+    }
+
+    entry.number = number++;
+    pending = raw;
+    return 1;
+}
+
+bool TraceReader::read_record(TraceEntry & entry)
+{
+    if(size - pos < sizeof(TraceRecord)) return 0;
+
+    TraceRecord r;
+    std::memcpy(&r, data + pos, sizeof(r));
+    pos += sizeof(r);
+
+    entry.number = number++;
+    entry.line = number;
+    entry.pc = r.pc;
+    entry.known = (1u << TF_COUNT) - 1;
+
+    uint16_t * v = entry.values;
+    v[TF_OPCODE] = r.opcode;
+    v[TF_CYCLES] = r.cycles;
+    v[TF_A] = r.a;
+    v[TF_F] = r.f;
+    v[TF_B] = r.b;
+    v[TF_C] = r.c;
+    v[TF_D] = r.d;
+    v[TF_E] = r.e;
+    v[TF_H] = r.h;
+    v[TF_L] = r.l;
+    v[TF_SP] = r.sp;
+    v[TF_NEXT_PC] = r.next_pc;
+    return 1;
+}
+
+// Reads lines until one with a PC, false at the end of the file
+bool TraceReader::read_line(RawLine & raw)
+{
+    const char * text = (const char *)data;
+
+    while(pos < size)
+    {
+        const char * p = text + pos;
+        const char * eol = (const char *)memchr(p, '\n', size - pos);
+        const char * end = eol ? eol : text + size;
+        pos = end - text + (eol ? 1 : 0);
+        line++;
+
+        raw = RawLine();
+        raw.entry.line = line;
+
+        if(format == TRACE_CORE_TEXT)
+        {
+            // Console output and other chatter can come between lines
+            if(!parse_core_columns(p, end, raw)) continue;
+            parse_tokens(p, end, raw);
+            return 1;
+        }
+        if(parse_tokens(p, end, raw)) return 1;
+    }
+    return 0;
+}
+
+// The clock, instruction count, PC and opcode columns print_CPU_detail
+// starts its lines with. Leaves p after them.
+bool TraceReader::parse_core_columns(const char * & p, const char * end, RawLine & raw)
+{
+    const char * q = p;
+    uint64_t column[4] = {};
+
+    for(int c=0; c!=4; ++c)
+    {
+        int base = c < 2 ? 10 : 16;
+        if(c == 3)
+        {
+            if(end - q < 2 || q[0] != '0' || q[1] != 'x') return 0;
+            q += 2;
+        }
+
+        const char * start = q;
+        int d;
+        for(; q < end && (d = hex_digit(*q)) >= 0 && d < base; ++q) column[c] = column[c] * base + d;
+        if(q == start || q == end || *q != '\t') return 0;
+        q++;
+    }
+
+    raw.total_cycles = column[0];
+    raw.has_total = 1;
+    raw.entry.pc = column[2];
+    raw.entry.set(TF_OPCODE, column[3]);
+    p = q;
+    return 1;
+}
+
+// Picks the NAME:value tokens out of a line. Returns whether it had a PC.
+bool TraceReader::parse_tokens(const char * p, const char * end, RawLine & raw)
+{
+    TraceEntry & e = raw.entry;
+    bool has_pc = 0;
+
+    while(p < end)
+    {
+        // A name starts with a letter after anything but a letter or digit
+        if(!is_letter(*p))
+        {
+            if(is_digit(*p)) while(p < end && (is_letter(*p) || is_digit(*p))) p++;
+            else p++;
+            continue;
+        }
+
+        uint64_t key = 0;
+        size_t n = 0;
+        for(; p < end && (is_letter(*p) || is_digit(*p)); ++n, ++p) key = key << 8 | (uint8_t)(*p & ~0x20);
+        if(n > 8) continue;
+
+        size_t t = 0;
+        while(t != sizeof(token_names)/sizeof(token_names[0]) && token_names[t].key != key) t++;
+        if(t == sizeof(token_names)/sizeof(token_names[0])) continue;
+        TokenKind kind = token_names[t].kind;
+        TraceField field = token_names[t].field;
+
+        while(p < end && *p == ' ') p++;
+        if(p == end || (*p != ':' && *p != '=')) continue;
+        p++;
+        while(p < end && *p == ' ') p++;
+
+        const char * digits;
+        uint64_t v = 0;
+        if(kind == TOKEN_CYCLES)
+        {
+            for(digits = p; p < end && is_digit(*p); ++p) v = v * 10 + (*p - '0');
+        }
+        else
+        {
+            if(p < end && *p == '$') p++;
+            else if(end - p > 2 && p[0] == '0' && (p[1] | 0x20) == 'x') p += 2;
+
+            int d;
+            for(digits = p; p < end && (d = hex_digit(*p)) >= 0; ++p) v = v * 16 + d;
+        }
+        if(p == digits) continue;
+
+        switch(kind)
+        {
+            case TOKEN_BYTE:   e.set(field, v & 0xFF); break;
+            case TOKEN_SP:     e.set(field, v & 0xFFFF); break;
+            case TOKEN_OP:     e.set(field, v & 0xFF); break;
+
+            case TOKEN_PAIR:
+                e.set(field, (v >> 8) & 0xFF);
+                e.set((TraceField)(field + 1), v & 0xFF);
+                break;
+
+            case TOKEN_PCMEM:
+                // Only the first byte of the list
+                e.set(field, (p - digits > 2 ? v >> (4 * (p - digits - 2)) : v) & 0xFF);
+                break;
+
+            case TOKEN_PC:
+                // print_CPU_detail prints the PC the instruction left
+                if(format == TRACE_CORE_TEXT) e.set(field, v);
+                else e.pc = v;
+                has_pc = 1;
+                break;
+
+            case TOKEN_CYCLES:
+                raw.total_cycles = v;
+                raw.has_total = 1;
+                break;
+        }
+    }
+    return has_pc;
+}
@@ -0,0 +1,235 @@
+/*
+Instruction traces, for comparing the core with other emulators.
+
+The core writes a binary trace through TraceWriter, attached with
+i8080::tracer:
+
+    TraceHeader
+    TraceRecord records[]       one per instruction, to the end of the file
+
+Each record holds the instruction's address, opcode and cycles and the
+registers it left. Fields are little endian, as written by the host.
+
+The writer's TraceFilter picks which instructions are recorded, so long
+runs can keep just the part of interest. It is boiled down to a mask of
+256 opcodes and a bitmap of 65536 PCs before the run, and an instruction
+costs a lookup in each, plus a countdown when sampling every Nth one.
+Trapped BDOS and BIOS entries can be recorded too, as a RET at the trap
+address with the state the handler left.
+
+TraceReader streams a binary trace, print_CPU_detail text or the text
+logs of other emulators and gives back TraceEntry, one per instruction
+with the state after it ran. Text lines are searched for NAME:value or
+NAME=value tokens:
+    A F B C D E H L     hex
+    AF BC DE HL SP PC   hex
+    CYC CYCLES CLK      cycles before the instruction, decimal
+    OP PCMEM            opcode, the first byte of PCMEM
+and anything else on the line is ignored, so logs such as
+
+    PC: 0100, AF: 0002, BC: 0000, DE: 0000, HL: 0000, SP: 0000, CYC: 0
+    A:00 F:02 B:00 C:00 D:00 E:00 H:00 L:00 SP:0000 PC:0100 PCMEM:3E,05,32,00
+
+read as they are. Such logs print the state before each instruction, so
+each line is paired with the registers of the next. print_CPU_detail
+lines are told apart by their leading columns and already print the state
+after the instruction.
+
+Only the fields a trace gives are marked known. Readers map the file and
+drop what they have read from memory as they go, so a trace of any size
+streams in constant memory.
+*/
+
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "mapfile.h"
+
+class i8080;
+
+static const uint32_t TRACE_VERSION = 1;
+
+struct TraceHeader
+{
+    char magic[8];              // "I8080TR" and a terminator
+    uint32_t version;
+    uint32_t record_size;       // sizeof(TraceRecord)
+};
+
+struct TraceRecord
+{
+    uint16_t pc;                // Address of the instruction
+    uint16_t next_pc;
+    uint16_t sp;
+    uint8_t opcode;
+    uint8_t cycles;
+    uint8_t a, f, b, c, d, e, h, l;
+};
+
+enum TraceField
+{
+    TF_OPCODE, TF_CYCLES,
+    TF_A, TF_F, TF_B, TF_C, TF_D, TF_E, TF_H, TF_L,
+    TF_SP, TF_NEXT_PC,
+    TF_COUNT
+};
+
+// Field names as printed and as taken by tracediff -i
+extern const char * const trace_field_names[TF_COUNT];
+
+struct TraceEntry
+{
+    uint64_t number = 0;        // Instruction number in its trace, from 0
+    uint64_t line = 0;          // Text line or binary record it came from, from 1
+    uint16_t pc = 0;
+    uint16_t values[TF_COUNT] = {};
+    uint32_t known = 0;         // Bit per TraceField
+
+    bool has(TraceField f) const { return known & (1u << f); }
+    void set(TraceField f, uint16_t v) { values[f] = v; known |= 1u << f; }
+};
+
+class TraceFilter
+{
+    public:
+        // Opcode classes, any combination
+        enum OpcodeClass : uint32_t
+        {
+            CLASS_BRANCH = 1,       // Jumps, calls, returns, RST and PCHL
+            CLASS_WRITE = 2,        // Instructions that write memory, stack included
+            CLASS_IO = 4,           // IN and OUT
+            CLASS_TRAP = 8          // Trapped BDOS and BIOS entries
+        };
+
+        // Records every instruction and no traps
+        TraceFilter();
+
+        // Parses a filter from space separated terms:
+        //     pc=0100-01ff,e400        PC ranges and addresses, hex
+        //     class=branch,write,io,bdos
+        //     op=cd,c9                 opcodes, hex
+        //     every=100                one in every N instructions that pass
+        // The opcode classes and opcodes add up, with neither given every
+        // opcode passes. Returns false and describes the problem in error
+        // if spec doesn't parse.
+        bool parse(const std::string & spec, std::string & error);
+
+        // Only PCs in the ranges added pass, once one is added
+        void add_pc_range(uint16_t first, uint16_t last);
+
+        // Only opcodes in the classes or added pass, once either is added
+        void add_classes(uint32_t classes);
+        void add_opcode(uint8_t opcode);
+
+        void set_every(uint32_t every);
+
+        // Whether to record an instruction. Sampling counts only the
+        // instructions the masks pass.
+        bool wants(uint16_t pc, uint8_t opcode)
+        {
+            if(!opcode_mask[opcode] || !pc_map[pc]) return 0;
+            if(--countdown) return 0;
+            countdown = every;
+            return 1;
+        }
+
+        bool wants_trap(uint16_t pc)
+        {
+            return traps && pc_map[pc];
+        }
+
+    private:
+        std::bitset<256> opcode_mask;
+        std::bitset<0x10000> pc_map;
+        bool opcodes_given = 0;
+        bool pcs_given = 0;
+        bool traps = 0;
+        uint32_t every = 1;
+        uint32_t countdown = 1;
+};
+
+class TraceWriter
+{
+    public:
+        ~TraceWriter();
+
+        // Chooses what is recorded, everything but traps unless changed
+        TraceFilter filter;
+
+        // Returns false if the file can't be created
+        bool open(const std::string & path);
+
+        // Writes what is buffered. False if any write failed.
+        bool close();
+
+        // Called by the core after each instruction the filter wants, and
+        // after traps
+        void record(const i8080 & cpu, uint16_t pc, uint8_t opcode, uint8_t cycles);
+
+    private:
+        static const size_t BUFFER_RECORDS = 1 << 16;
+
+        FILE * out = nullptr;
+        std::vector<TraceRecord> buffer;
+        size_t used = 0;
+        bool ok = 1;
+
+        void flush();
+};
+
+class TraceReader
+{
+    public:
+        enum Format
+        {
+            TRACE_AUTO,         // Told apart by the first bytes
+            TRACE_BINARY,
+            TRACE_CORE_TEXT,    // print_CPU_detail
+            TRACE_TEXT_BEFORE,  // Other text, state before each instruction
+            TRACE_TEXT_AFTER    // Other text, state after each instruction
+        };
+
+        // Returns false and describes the problem in error if the file
+        // can't be read as the format
+        bool open(const std::string & path, Format format, std::string & error);
+
+        // The next instruction, false at the end of the trace
+        bool next(TraceEntry & entry);
+
+        Format get_format();
+        uint64_t get_bytes_read();
+
+    private:
+        // Drop read pages every so often
+        static const size_t RELEASE_BYTES = 64 << 20;
+
+        MappedFile file;
+        const uint8_t * data = nullptr;
+        size_t size = 0;
+        Format format = TRACE_AUTO;
+        size_t pos = 0;
+        size_t released = 0;
+        uint64_t line = 0;
+        uint64_t number = 0;
+
+        // Text lines are paired with the line after them
+        struct RawLine
+        {
+            TraceEntry entry;
+            uint64_t total_cycles = 0;
+            bool has_total = 0;
+        };
+        RawLine pending;
+        bool have_pending = 0;
+
+        bool read_record(TraceEntry & entry);
+        bool read_line(RawLine & raw);
+        bool parse_tokens(const char * p, const char * end, RawLine & raw);
+        bool parse_core_columns(const char * & p, const char * end, RawLine & raw);
+};
@@ -0,0 +1,286 @@
+/*
+Trace comparison, streams two instruction traces side by side and reports
+the first instruction where they differ, with the instructions around it.
+
+Build:
+    g++ -O2 tracediff.cpp trace.cpp mapfile.cpp opcodes.cpp -o tracediff
+
+Usage: tracediff [-1 format] [-2 format] [-c context] [-m flagmask]
+                 [-i field,...] [-s addr] [-n count] trace1 trace2
+    -1, -2  format of each trace (default auto):
+                binary  written by read-rom with I8080_TRACE
+                core    print_CPU_detail text
+                before  other text, registers before each instruction
+                after   other text, registers after each instruction
+    -c  instructions of context either side (default 8)
+    -m  flag bits to compare (default d5, all of S Z AC P CY)
+    -i  fields to ignore: op cycles a f b c d e h l sp next
+    -s  start each trace at its first instruction at addr (hex), for
+        traces that begin in different places
+    -n  compare at most count instructions
+
+A field is only compared where both traces give it, so a log without
+cycles or opcodes still compares on registers. Exits 0 if the traces
+match, 1 at a divergence and 2 on an error.
+
+Both traces are read once, front to back, in constant memory whatever
+their size: the context before a divergence is kept in a ring and pages
+already read are dropped.
+*/
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+
+using namespace std;
+
+// Bit set in a difference mask when the instruction addresses differ
+static const uint32_t DIFF_PC = 1u << TF_COUNT;
+
+struct DiffConfig
+{
+    TraceReader::Format formats[2] = {TraceReader::TRACE_AUTO, TraceReader::TRACE_AUTO};
+    size_t context = 8;
+    uint8_t flag_mask = 0xD5;
+    uint32_t compared = (1u << TF_COUNT) - 1;
+    bool sync = 0;
+    uint16_t sync_pc = 0;
+    uint64_t limit = UINT64_MAX;
+};
+
+static bool parse_format(const string & name, TraceReader::Format & format)
+{
+    if(name == "auto")        format = TraceReader::TRACE_AUTO;
+    else if(name == "binary") format = TraceReader::TRACE_BINARY;
+    else if(name == "core")   format = TraceReader::TRACE_CORE_TEXT;
+    else if(name == "before") format = TraceReader::TRACE_TEXT_BEFORE;
+    else if(name == "after")  format = TraceReader::TRACE_TEXT_AFTER;
+    else return 0;
+    return 1;
+}
+
+static const char * format_name(TraceReader::Format format)
+{
+    switch(format)
+    {
+        case TraceReader::TRACE_BINARY:      return "binary";
+        case TraceReader::TRACE_CORE_TEXT:   return "core text";
+        case TraceReader::TRACE_TEXT_BEFORE: return "text, state before";
+        case TraceReader::TRACE_TEXT_AFTER:  return "text, state after";
+        default:                             return "auto";
+    }
+}
+
+// The fields both entries give that differ
+static uint32_t compare(const TraceEntry & a, const TraceEntry & b, const DiffConfig & config)
+{
+    // Mostly they match outright
+    if(a.pc == b.pc && memcmp(a.values, b.values, sizeof(a.values)) == 0) return 0;
+
+    uint32_t diff = a.pc != b.pc ? DIFF_PC : 0;
+    uint32_t both = a.known & b.known & config.compared;
+
+    for(int f=0; f!=TF_COUNT; ++f)
+    {
+        if(!(both & (1u << f))) continue;
+
+        uint16_t x = a.values[f];
+        uint16_t y = b.values[f];
+        if(f == TF_F)
+        {
+            x &= config.flag_mask;
+            y &= config.flag_mask;
+        }
+        if(x != y) diff |= 1u << f;
+    }
+    return diff;
+}
+
+static void print_entry(int side, const TraceEntry & e, uint32_t diff)
+{
+    printf("%d %10llu %10llu  %04X%c", side, (unsigned long long)e.number,
+           (unsigned long long)e.line, e.pc, diff & DIFF_PC ? '*' : ' ');
+
+    for(int f=0; f!=TF_COUNT; ++f)
+    {
+        int width = (f == TF_SP || f == TF_NEXT_PC) ? 4 : f == TF_CYCLES ? 3 : 2;
+        char mark = diff & (1u << f) ? '*' : ' ';
+
+        if(!e.has((TraceField)f))             printf(" %s=%.*s%c", trace_field_names[f], width, "----", mark);
+        else if(f == TF_CYCLES)               printf(" %s=%3u%c", trace_field_names[f], e.values[f], mark);
+        else                                  printf(" %s=%0*X%c", trace_field_names[f], width, e.values[f], mark);
+    }
+    printf("\n");
+}
+
+static void print_pair(const TraceEntry & a, const TraceEntry & b, const DiffConfig & config)
+{
+    uint32_t diff = compare(a, b, config);
+    print_entry(1, a, diff);
+    print_entry(2, b, diff);
+}
+
+// Skips to the first instruction at the sync address, false if there is none
+static bool sync_to(TraceReader & reader, TraceEntry & entry, uint16_t pc)
+{
+    while(reader.next(entry))
+    {
+        if(entry.pc == pc) return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    DiffConfig config;
+    vector<string> paths;
+
+    for(int i=1; i<argc; ++i)
+    {
+        string arg = argv[i];
+        if((arg=="-1" || arg=="-2") && i+1<argc)
+        {
+            if(!parse_format(argv[++i], config.formats[arg[1] - '1']))
+            {
+                cerr << "Unknown format " << argv[i] << endl;
+                return 2;
+            }
+        }
+        else if(arg=="-c" && i+1<argc)  config.context = stoul(argv[++i]);
+        else if(arg=="-m" && i+1<argc)  config.flag_mask = stoi(argv[++i], nullptr, 16);
+        else if(arg=="-n" && i+1<argc)  config.limit = stoull(argv[++i]);
+        else if(arg=="-s" && i+1<argc)
+        {
+            config.sync = 1;
+            config.sync_pc = stoi(argv[++i], nullptr, 16);
+        }
+        else if(arg=="-i" && i+1<argc)
+        {
+            stringstream fields(argv[++i]);
+            string field;
+            while(getline(fields, field, ','))
+            {
+                int f = 0;
+                while(f != TF_COUNT && field != trace_field_names[f]) f++;
+                if(f == TF_COUNT)
+                {
+                    cerr << "Unknown field " << field << endl;
+                    return 2;
+                }
+                config.compared &= ~(1u << f);
+            }
+        }
+        else if(arg[0] != '-')           paths.push_back(arg);
+        else
+        {
+            cerr << "Unknown option " << arg << endl;
+            return 2;
+        }
+    }
+
+    if(paths.size() != 2)
+    {
+        cerr << "Usage: tracediff [options] trace1 trace2" << endl;
+        return 2;
+    }
+
+    TraceReader readers[2];
+    for(int t=0; t!=2; ++t)
+    {
+        string error;
+        if(!readers[t].open(paths[t], config.formats[t], error))
+        {
+            cerr << "error: " << error << endl;
+            return 2;
+        }
+        cout << "trace " << t+1 << ": " << paths[t] << " (" << format_name(readers[t].get_format()) << ")" << endl;
+    }
+
+    auto start = chrono::steady_clock::now();
+
+    // Entries are read straight into a ring holding the pair being compared
+    // and the context before it
+    size_t slots = config.context + 1;
+    vector<pair<TraceEntry, TraceEntry>> ring(slots);
+    size_t cur = 0;
+
+    bool more_a, more_b;
+    if(config.sync)
+    {
+        more_a = sync_to(readers[0], ring[cur].first, config.sync_pc);
+        more_b = sync_to(readers[1], ring[cur].second, config.sync_pc);
+    }
+    else
+    {
+        more_a = readers[0].next(ring[cur].first);
+        more_b = readers[1].next(ring[cur].second);
+    }
+
+    uint64_t compared = 0;
+    uint32_t diff = 0;
+    while(more_a && more_b && compared < config.limit)
+    {
+        diff = compare(ring[cur].first, ring[cur].second, config);
+        if(diff) break;
+        compared++;
+
+        if(++cur == slots) cur = 0;
+        more_a = readers[0].next(ring[cur].first);
+        more_b = readers[1].next(ring[cur].second);
+    }
+
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    uint64_t bytes = readers[0].get_bytes_read() + readers[1].get_bytes_read();
+    cerr << compared << " instructions, " << bytes / 1000000 << " MB compared in "
+         << elapsed.count() << "s (" << (uint64_t)(bytes / 1e6 / max(elapsed.count(), 1e-9)) << " MB/s)" << endl;
+
+    bool diverged = diff || (compared < config.limit && more_a != more_b);
+    if(!diverged)
+    {
+        cout << "Traces match over " << compared << " instructions" << endl;
+        return 0;
+    }
+
+    if(diff)
+    {
+        cout << "First divergence at instruction " << compared << ":";
+        if(diff & DIFF_PC) cout << " pc";
+        for(int f=0; f!=TF_COUNT; ++f) if(diff & (1u << f)) cout << " " << trace_field_names[f];
+        cout << endl;
+    }
+    else
+    {
+        cout << "Trace " << (more_a ? 2 : 1) << " ends after " << compared << " instructions" << endl;
+    }
+
+    // Columns: trace, instruction, line or record, PC, then the state the
+    // instruction left. '*' marks what differs.
+    cout << endl;
+    size_t before = min<uint64_t>(compared, config.context);
+    for(size_t i=0; i!=before; ++i)
+    {
+        const auto & p = ring[(cur + slots - before + i) % slots];
+        print_pair(p.first, p.second, config);
+    }
+    TraceEntry & a = ring[cur].first;
+    TraceEntry & b = ring[cur].second;
+
+    // The divergence itself, then what follows it in each trace
+    if(more_a && more_b) cout << ">" << endl;
+    for(size_t i=0; i<=config.context && (more_a || more_b); ++i)
+    {
+        if(more_a && more_b)   print_pair(a, b, config);
+        else if(more_a)        print_entry(1, a, 0);
+        else                   print_entry(2, b, 0);
+
+        if(i == 0 && more_a && more_b) cout << ">" << endl;
+        more_a = more_a && readers[0].next(a);
+        more_b = more_b && readers[1].next(b);
+    }
+    return 1;
+}